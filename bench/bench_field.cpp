@@ -0,0 +1,59 @@
+/*
+    Benchmark for the ring field generator.
+
+    Generates one field per run with the scalar kernel, the best SIMD kernel on one thread and
+    the SIMD kernel split across a thread pool, and reports the best of several runs in Mpixels/s.
+
+    Usage: bench_field [size] [runs]     (defaults: 8192 5)
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "../field_generator.h"
+#include "../thread_pool.h"
+
+
+// Best wall time of `runs` generations, in seconds
+static double timeGenerator(std::vector<float>& field, int size, int runs, ThreadPool* pool, FieldKernel kernel) {
+    RingParams params = defaultRingParams();
+    double best = 1e30;
+    for (int i = 0; i < runs; ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        generateRingField(field.data(), size, size, params, pool, kernel);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+
+static void report(const char* name, int size, double seconds) {
+    double mpixels = (double)size * (double)size / seconds / 1e6;
+    std::cout << name << ": " << seconds * 1000.0 << " ms, " << mpixels << " Mpixels/s" << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+    int size = argc > 1 ? std::atoi(argv[1]) : 8192;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+    if (size <= 0 || runs <= 0) {
+        std::cerr << "Usage: bench_field [size] [runs]" << std::endl;
+        return -1;
+    }
+
+    std::vector<float> field((size_t)size * (size_t)size);
+    ThreadPool pool;
+    FieldKernel vector = resolveFieldKernel(FIELD_KERNEL_AUTO);
+
+    std::cout << size << "x" << size << " field, best of " << runs << " runs, "
+              << fieldKernelName(vector) << " kernel, " << pool.threadCount() << " threads" << std::endl;
+    report("scalar", size, timeGenerator(field, size, runs, NULL, FIELD_KERNEL_SCALAR));
+    report("vector", size, timeGenerator(field, size, runs, NULL, vector));
+    report("threaded", size, timeGenerator(field, size, runs, &pool, vector));
+    return 0;
+}
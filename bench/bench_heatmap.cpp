@@ -0,0 +1,308 @@
+/*
+    Benchmarks for the three stages of showing a heatmap: generating the field, uploading it
+    and drawing it.
+
+      generate/N          Ring field of N x N texels, SIMD kernel on the thread pool, for N from
+                          256 up to --max-size (default 16384)
+      upload/FORMAT/N     uploadTextureStream of an N x N field (--upload-size, default 4096)
+                          for every texel format, packing included, until the GPU is done
+      draw/WxH            The display shaders drawing a --draw-size (default 1920x1080)
+                          offscreen framebuffer, 100 draws per iteration
+
+    Every benchmark runs once to warm up and then --runs times (default 5). The results are
+    printed as a table, and with --json FILE also written in the JSON layout of Google
+    Benchmark (--benchmark_out), so the existing tools for comparing runs can read them.
+    The upload and draw benchmarks need an OpenGL 3.3 context (a hidden window) and are
+    skipped without one.
+
+    Run from the repository root so the shaders are found:
+        bench_heatmap [--runs N] [--max-size N] [--upload-size N] [--draw-size WxH] [--json FILE]
+*/
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../colormap.h"
+#include "../field_buffer_pool.h"
+#include "../field_generator.h"
+#include "../fullscreen_triangle.h"
+#include "../offscreen_target.h"
+#include "../shader.h"
+#include "../texture_format.h"
+#include "../texture_stream.h"
+#include "../thread_pool.h"
+#include "../value_range.h"
+
+
+struct BenchResult {
+    std::string name;
+    int iterations;
+    double realMs;          // Mean wall time per iteration
+    double cpuMs;           // Mean process CPU time per iteration (all threads)
+    double itemsPerSecond;  // 0 if not reported
+    double bytesPerSecond;  // 0 if not reported
+};
+
+
+// Run fn once to warm up, then `runs` times. items and bytes are per iteration.
+static BenchResult runBenchmark(const std::string& name, int runs, double items, double bytes,
+                                const std::function<void()>& fn) {
+    fn();
+    std::clock_t cpuStart = std::clock();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        fn();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double cpuSeconds = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = runs;
+    result.realMs = elapsed.count() * 1000.0 / runs;
+    result.cpuMs = cpuSeconds * 1000.0 / runs;
+    result.itemsPerSecond = items > 0.0 ? items * runs / elapsed.count() : 0.0;
+    result.bytesPerSecond = bytes > 0.0 ? bytes * runs / elapsed.count() : 0.0;
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-28s %10.3f ms %10.3f ms cpu", name.c_str(), result.realMs, result.cpuMs);
+    std::cout << line;
+    if (result.itemsPerSecond > 0.0) {
+        std::cout << "  " << result.itemsPerSecond / 1e6 << " M items/s";
+    }
+    if (result.bytesPerSecond > 0.0) {
+        std::cout << "  " << result.bytesPerSecond / 1e9 << " GB/s";
+    }
+    std::cout << std::endl;
+    return result;
+}
+
+
+static std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+
+static bool writeJson(const char* path, const std::vector<BenchResult>& results, const std::string& renderer) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+    char date[64];
+    std::time_t now = std::time(NULL);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    fprintf(file, "{\n  \"context\": {\n");
+    fprintf(file, "    \"date\": %s,\n", jsonString(date).c_str());
+    fprintf(file, "    \"executable\": \"bench_heatmap\",\n");
+    fprintf(file, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(file, "    \"field_kernel\": %s,\n", jsonString(fieldKernelName(resolveFieldKernel(FIELD_KERNEL_AUTO))).c_str());
+    fprintf(file, "    \"gl_renderer\": %s\n", jsonString(renderer).c_str());
+    fprintf(file, "  },\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        fprintf(file, "    {\n      \"name\": %s,\n      \"run_type\": \"iteration\",\n", jsonString(r.name).c_str());
+        fprintf(file, "      \"iterations\": %d,\n      \"real_time\": %.6f,\n      \"cpu_time\": %.6f,\n",
+                r.iterations, r.realMs, r.cpuMs);
+        if (r.itemsPerSecond > 0.0) {
+            fprintf(file, "      \"items_per_second\": %.1f,\n", r.itemsPerSecond);
+        }
+        if (r.bytesPerSecond > 0.0) {
+            fprintf(file, "      \"bytes_per_second\": %.1f,\n", r.bytesPerSecond);
+        }
+        fprintf(file, "      \"time_unit\": \"ms\"\n    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+
+int main(int argc, char** argv) {
+    int runs = 5;
+    int maxSize = 16384;
+    int uploadSize = 4096;
+    int drawWidth = 1920, drawHeight = 1080;
+    const char* jsonPath = NULL;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) {
+            runs = std::atoi(argv[++i]);
+        } else if (arg == "--max-size" && i + 1 < argc) {
+            maxSize = std::atoi(argv[++i]);
+        } else if (arg == "--upload-size" && i + 1 < argc) {
+            uploadSize = std::atoi(argv[++i]);
+        } else if (arg == "--draw-size" && i + 1 < argc) {
+            char separator;
+            if (sscanf(argv[++i], "%d%c%d", &drawWidth, &separator, &drawHeight) != 3 || separator != 'x') {
+                drawWidth = drawHeight = 0;
+            }
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            runs = 0;
+            break;
+        }
+    }
+    if (runs <= 0 || maxSize < 256 || uploadSize <= 0 || drawWidth <= 0 || drawHeight <= 0) {
+        std::cerr << "Usage: bench_heatmap [--runs N] [--max-size N] [--upload-size N] [--draw-size WxH] [--json FILE]"
+                  << std::endl;
+        return -1;
+    }
+
+    std::vector<BenchResult> results;
+    ThreadPool pool;
+    RingParams params = defaultRingParams();
+    std::cout << "Field kernel " << fieldKernelName(resolveFieldKernel(FIELD_KERNEL_AUTO)) << ", "
+              << pool.threadCount() << " threads, " << runs << " runs per benchmark" << std::endl;
+
+    // Generation at every power of two up to the largest size
+    for (int size = 256; size <= maxSize; size *= 2) {
+        FieldBuffer field;
+        try {
+            field.resize((size_t)size * (size_t)size);
+        } catch (const std::bad_alloc&) {
+            std::cerr << "Not enough memory for a " << size << "x" << size << " field, stopping here" << std::endl;
+            break;
+        }
+        results.push_back(runBenchmark("generate/" + std::to_string(size), runs, (double)size * size, 0.0, [&]() {
+            generateRingField(field.data(), size, size, params, &pool);
+        }));
+    }
+
+    // Everything else needs a context; a hidden window provides one
+    std::string renderer = "none";
+    GLFWwindow* window = NULL;
+    if (glfwInit()) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(64, 64, "bench_heatmap", NULL, NULL);
+    }
+    if (window) {
+        glfwMakeContextCurrent(window);
+        glewExperimental = GL_TRUE;
+        if (glewInit() != GLEW_OK) {
+            glfwDestroyWindow(window);
+            window = NULL;
+        }
+        glGetError();
+    }
+    if (!window) {
+        std::cerr << "No OpenGL 3.3 context, skipping the upload and draw benchmarks" << std::endl;
+    } else {
+        renderer = (const char*)glGetString(GL_RENDERER);
+        std::cout << "Renderer " << renderer << std::endl;
+
+        std::vector<float> field((size_t)uploadSize * (size_t)uploadSize);
+        generateRingField(field.data(), uploadSize, uploadSize, params, &pool);
+        const HeatmapFormat formats[] = { HEATMAP_FORMAT_R32F, HEATMAP_FORMAT_R16F, HEATMAP_FORMAT_R16, HEATMAP_FORMAT_R8,
+                                          HEATMAP_FORMAT_BC4 };
+        TextureStream drawStream;
+        bool haveDrawStream = false;
+        for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+            TextureStream stream;
+            if (!createTextureStream(&stream, uploadSize, uploadSize, formats[f])) {
+                continue;
+            }
+            // glFinish makes the copy out of the pixel buffer part of the measured time
+            std::string name = std::string("upload/") + heatmapFormatName(formats[f]) + "/" + std::to_string(uploadSize);
+            results.push_back(runBenchmark(name, runs, 0.0, (double)stream.frameBytes, [&]() {
+                uploadTextureStream(&stream, field.data(), &pool);
+                glFinish();
+            }));
+            if (formats[f] == HEATMAP_FORMAT_R32F) {
+                drawStream = stream; // Keep the float texture for the draw benchmark
+                haveDrawStream = true;
+            } else {
+                destroyTextureStream(&stream);
+            }
+        }
+
+        // The display shaders, set up as main does for a single texture
+        GLuint program = createShaderProgram("fullscreen_triangle.glsl", "fragment_shader.glsl");
+        std::vector<float> rgb;
+        Colormap colormap;
+        OffscreenTarget target;
+        ValueRange range;
+        bool haveColormap = builtinColormap("blue-red", &rgb) && createColormap(&colormap, "blue-red", rgb);
+        bool haveRange = haveDrawStream && createValueRange(&range, uploadSize, uploadSize);
+        if (program && haveDrawStream && haveColormap && haveRange &&
+            createOffscreenTarget(&target, drawWidth, drawHeight)) {
+            reduceValueRange(&range, drawStream.texture, uploadSize, uploadSize);
+            FullscreenTriangle triangle;
+            createFullscreenTriangle(&triangle);
+            glUseProgram(program);
+            glUniform1i(glGetUniformLocation(program, "heatmapTexture"), 0);
+            glUniform1i(glGetUniformLocation(program, "colormapTexture"), 1);
+            glUniform1f(glGetUniformLocation(program, "colormapSize"), (float)COLORMAP_SIZE);
+            glUniform1i(glGetUniformLocation(program, "valueRange"), 2);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_1D, colormap.texture);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, range.result);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, drawStream.texture);
+            bindOffscreenTarget(&target);
+
+            const int drawsPerIteration = 100;
+            std::string name = "draw/" + std::to_string(drawWidth) + "x" + std::to_string(drawHeight);
+            results.push_back(runBenchmark(name, runs, drawsPerIteration, 0.0, [&]() {
+                for (int i = 0; i < drawsPerIteration; ++i) {
+                    drawFullscreenTriangle(&triangle);
+                }
+                glFinish();
+            }));
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            destroyFullscreenTriangle(&triangle);
+            destroyOffscreenTarget(&target);
+        } else {
+            std::cerr << "Could not set up the display shaders, skipping the draw benchmark" << std::endl;
+        }
+        if (haveRange) {
+            destroyValueRange(&range);
+        }
+        if (haveColormap) {
+            destroyColormap(&colormap);
+        }
+        if (haveDrawStream) {
+            destroyTextureStream(&drawStream);
+        }
+        glDeleteProgram(program);
+        glfwDestroyWindow(window);
+    }
+    glfwTerminate();
+
+    if (jsonPath && !writeJson(jsonPath, results, renderer)) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+    A blocking queue with a fixed capacity, for handing work from one pipeline stage to the next.
+
+    push waits while the queue is full, so a fast producer is slowed down to the pace of its
+    consumers (backpressure) instead of piling up work in memory. pop waits while the queue is
+    empty. After close, pushes are refused and pop drains what is left, then returns false.
+*/
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+    // Wait for room, then add item. Returns false (and drops item) if the queue is closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Wait for an item. Returns false once the queue is closed and empty.
+    bool pop(T* item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        *item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    BoundedQueue(const BoundedQueue&);
+    BoundedQueue& operator=(const BoundedQueue&);
+
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "colormap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+const std::vector<std::string>& builtinColormapNames() {
+    static const char* names[] = { "blue-red", "viridis", "inferno", "turbo" };
+    static const std::vector<std::string> list(names, names + sizeof(names) / sizeof(names[0]));
+    return list;
+}
+
+
+// Evaluate a polynomial fit: coefficients[k] holds the r, g, b coefficients of t^k
+static void evaluatePolynomial(const double (*coefficients)[3], int degree, double t, float* rgb) {
+    for (int channel = 0; channel < 3; ++channel) {
+        double value = 0.0;
+        for (int k = degree; k >= 0; --k) {
+            value = value * t + coefficients[k][channel];
+        }
+        rgb[channel] = (float)std::min(1.0, std::max(0.0, value));
+    }
+}
+
+
+bool builtinColormap(const std::string& name, std::vector<float>* rgb) {
+    // Degree 6 fits of matplotlib's viridis and inferno
+    static const double viridis[7][3] = {
+        { 0.2777273272234177, 0.005407344544966578, 0.3340998053353061 },
+        { 0.1050930431085774, 1.404613529898575, 1.384590162594685 },
+        { -0.3308618287255563, 0.214847559468213, 0.09509516302823659 },
+        { -4.634230498983486, -5.799100973351585, -19.33244095627987 },
+        { 6.228269936347081, 14.17993336680509, 56.69055260068105 },
+        { 4.776384997670288, -13.74514537774601, -65.35303263337234 },
+        { -5.435455855934631, 4.645852612178535, 26.3124352495832 }
+    };
+    static const double inferno[7][3] = {
+        { 0.0002189403691192265, 0.001651004631001012, -0.01948089843709184 },
+        { 0.1065134194856116, 0.5639564367884091, 3.932712388889277 },
+        { 11.60249308247187, -3.972853965665698, -15.9423941062914 },
+        { -41.70399613139459, 17.43639888205313, 44.35414519872813 },
+        { 77.162935699427, -33.40235894210092, -81.80730925738993 },
+        { -71.31942824499214, 32.62606426397723, 73.20951985803202 },
+        { 25.13112622477341, -12.24266895238567, -23.07032500287172 }
+    };
+    // Degree 5 fit of Google's turbo
+    static const double turbo[6][3] = {
+        { 0.13572138, 0.09140261, 0.10667330 },
+        { 4.61539260, 2.19418839, 12.64194608 },
+        { -42.66032258, 4.84296658, -60.58204836 },
+        { 132.13108234, -14.18503333, 110.36276771 },
+        { -152.94239396, 4.27729857, -89.90310912 },
+        { 59.28637943, 2.82956604, 27.34824973 }
+    };
+
+    rgb->resize(COLORMAP_SIZE * 3);
+    for (int i = 0; i < COLORMAP_SIZE; ++i) {
+        double t = (double)i / (COLORMAP_SIZE - 1);
+        float* entry = &(*rgb)[i * 3];
+        if (name == "blue-red") {
+            // The ramp the fragment shader used to compute itself
+            entry[0] = (float)t;
+            entry[1] = 0.0f;
+            entry[2] = (float)(1.0 - t);
+        } else if (name == "viridis") {
+            evaluatePolynomial(viridis, 6, t, entry);
+        } else if (name == "inferno") {
+            evaluatePolynomial(inferno, 6, t, entry);
+        } else if (name == "turbo") {
+            evaluatePolynomial(turbo, 5, t, entry);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool loadColormapFile(const char* path, std::vector<float>* rgb) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open colormap file: " << path << std::endl;
+        return false;
+    }
+    std::vector<float> entries;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::istringstream values(line);
+        float r, g, b;
+        if (!(values >> r >> g >> b)) {
+            std::cerr << "Expected \"r g b\" on line " << lineNumber << " of " << path << std::endl;
+            return false;
+        }
+        entries.push_back(r);
+        entries.push_back(g);
+        entries.push_back(b);
+    }
+    int count = (int)entries.size() / 3;
+    if (count < 2) {
+        std::cerr << "A colormap needs at least two entries: " << path << std::endl;
+        return false;
+    }
+
+    // Resample linearly to the texture size
+    rgb->resize(COLORMAP_SIZE * 3);
+    for (int i = 0; i < COLORMAP_SIZE; ++i) {
+        float position = (float)i / (COLORMAP_SIZE - 1) * (count - 1);
+        int index = std::min((int)position, count - 2);
+        float fraction = position - index;
+        for (int channel = 0; channel < 3; ++channel) {
+            float a = entries[index * 3 + channel];
+            float b = entries[(index + 1) * 3 + channel];
+            (*rgb)[i * 3 + channel] = std::min(1.0f, std::max(0.0f, a + (b - a) * fraction));
+        }
+    }
+    return true;
+}
+
+
+void clearColormap(Colormap* colormap) {
+    colormap->name.clear();
+    colormap->texture = 0;
+}
+
+
+bool createColormap(Colormap* colormap, const std::string& name, const std::vector<float>& rgb) {
+    if (rgb.size() != COLORMAP_SIZE * 3) {
+        std::cerr << "Colormap " << name << " has the wrong number of entries" << std::endl;
+        return false;
+    }
+    unsigned char texels[COLORMAP_SIZE * 4];
+    for (int i = 0; i < COLORMAP_SIZE; ++i) {
+        for (int channel = 0; channel < 3; ++channel) {
+            texels[i * 4 + channel] = (unsigned char)std::lround(rgb[i * 3 + channel] * 255.0f);
+        }
+        texels[i * 4 + 3] = 255;
+    }
+
+    colormap->name = name;
+    glGenTextures(1, &colormap->texture);
+    glBindTexture(GL_TEXTURE_1D, colormap->texture);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, COLORMAP_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+    // Linear filtering blends neighboring entries, clamping keeps values outside [0, 1] at the ends
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    return true;
+}
+
+
+void destroyColormap(Colormap* colormap) {
+    glDeleteTextures(1, &colormap->texture);
+    colormap->texture = 0;
+}
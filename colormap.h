@@ -0,0 +1,46 @@
+/*
+    Colormaps for the fragment shader.
+
+    The fragment shader looks the color of a scalar up in a 1D texture instead of computing
+    it. Every colormap is its own small texture, created once at startup, so switching maps
+    only binds a different texture: no shader is recompiled and no per-colormap program
+    variants exist.
+
+    Built in: the original blue-to-red ramp, viridis, inferno and turbo (the last three from
+    their published polynomial fits). Custom maps are read from text files with one
+    "r g b" line (values 0..1) per entry; '#' starts a comment.
+*/
+
+#ifndef COLORMAP_H
+#define COLORMAP_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+// Number of entries in every colormap texture
+const int COLORMAP_SIZE = 256;
+
+struct Colormap {
+    std::string name;
+    GLuint texture;     // GL_TEXTURE_1D, COLORMAP_SIZE RGBA8 texels
+};
+
+// Names of the built-in colormaps, in the order the C key cycles through them
+const std::vector<std::string>& builtinColormapNames();
+
+// Fill rgb with COLORMAP_SIZE * 3 values in [0, 1]. Returns false for an unknown name.
+bool builtinColormap(const std::string& name, std::vector<float>* rgb);
+
+// Read a colormap file and resample it to COLORMAP_SIZE entries
+bool loadColormapFile(const char* path, std::vector<float>* rgb);
+
+// The state of a colormap that was never created: no name or texture, which destroyColormap accepts
+void clearColormap(Colormap* colormap);
+
+// Upload COLORMAP_SIZE rgb entries into a new 1D texture
+bool createColormap(Colormap* colormap, const std::string& name, const std::vector<float>& rgb);
+
+void destroyColormap(Colormap* colormap);
+
+#endif
@@ -0,0 +1,26 @@
+/*
+    Function multiversioning for the hot CPU loops.
+
+    HEATMAP_TARGET_CLONES in front of a function makes the compiler build it once per
+    instruction set in the list and pick the best one when the program is loaded, using the
+    CPU it actually runs on. One binary then uses AVX2 on the nodes that have it and stays
+    runnable on the ones that don't, without -march flags that tie it to one machine.
+
+    It is meant for plain loops that the compiler vectorizes by itself. Kernels written with
+    intrinsics (field_generator.cpp, texture_format.cpp) keep their own runtime checks.
+
+    Target clones need GCC or Clang on an ELF platform with ifunc support. The CMake build
+    checks for that and defines HEATMAP_ENABLE_TARGET_CLONES; elsewhere the macro expands to
+    nothing and the functions are compiled once, as usual.
+*/
+
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#if defined(HEATMAP_ENABLE_TARGET_CLONES) && (defined(__x86_64__) || defined(__i386__))
+#define HEATMAP_TARGET_CLONES __attribute__((target_clones("avx2", "sse4.2", "default")))
+#else
+#define HEATMAP_TARGET_CLONES
+#endif
+
+#endif
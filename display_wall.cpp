@@ -0,0 +1,297 @@
+#include "display_wall.h"
+#include "fullscreen_triangle.h"
+#include "heatmap_renderer.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <iostream>
+
+// Size of a wall window when there aren't enough monitors to give each one its own
+static const int WALL_WINDOW_SIZE = 400;
+
+
+DisplayWall::DisplayWall()
+    : columns(0), rows(0), fence(0), generation(0), drawnGeneration(0), drawn(0), running(false) {
+}
+
+
+DisplayWall::~DisplayWall() {
+    stop();
+}
+
+
+// Monitors in reading order, top row first, so the wall matches how they are arranged
+static bool monitorAbove(GLFWmonitor* a, GLFWmonitor* b) {
+    int ax, ay, bx, by;
+    glfwGetMonitorPos(a, &ax, &ay);
+    glfwGetMonitorPos(b, &bx, &by);
+    return ay != by ? ay < by : ax < bx;
+}
+
+
+bool DisplayWall::start(GLFWwindow* share, int wallColumns, int wallRows, const char* vertexShader,
+                        const char* fragmentShader) {
+    stop();
+    columns = wallColumns;
+    rows = wallRows;
+    int cells = columns * rows;
+
+    int monitorCount = 0;
+    GLFWmonitor** monitorList = glfwGetMonitors(&monitorCount);
+    std::vector<GLFWmonitor*> monitors(monitorList, monitorList + monitorCount);
+    bool perMonitor = monitorCount >= cells && cells > 1;
+    if (perMonitor) {
+        std::sort(monitors.begin(), monitors.end(), monitorAbove);
+        glfwWindowHint(GLFW_DECORATED, GLFW_FALSE);
+    }
+
+    for (int i = 0; i < cells; ++i) {
+        WallWindow* wall = new WallWindow();
+        wall->nextProgram = 0;
+        wall->column = i % columns;
+        wall->row = i / columns;
+        int x = 64 + wall->column * (WALL_WINDOW_SIZE + 16);
+        int y = 64 + wall->row * (WALL_WINDOW_SIZE + 40);
+        int width = WALL_WINDOW_SIZE, height = WALL_WINDOW_SIZE;
+        if (perMonitor) {
+            const GLFWvidmode* mode = glfwGetVideoMode(monitors[i]);
+            glfwGetMonitorPos(monitors[i], &x, &y);
+            width = mode->width;
+            height = mode->height;
+        }
+        // Sharing with the main context is what lets every window sample the one uploaded field
+        wall->window = glfwCreateWindow(width, height, "OpenGL Heatmap wall", NULL, share);
+        if (!wall->window) {
+            std::cerr << "Failed to create wall window " << i << std::endl;
+            delete wall;
+            break;
+        }
+        glfwSetWindowPos(wall->window, x, y);
+        glfwGetFramebufferSize(wall->window, &wall->framebufferWidth, &wall->framebufferHeight);
+        // Program objects are shared too, so the main thread can link them all
+        wall->program = createShaderProgram(vertexShader, fragmentShader);
+        windows.push_back(wall);
+        if (!wall->program) {
+            break;
+        }
+    }
+    glfwWindowHint(GLFW_DECORATED, GLFW_TRUE);
+    // Creating windows doesn't change the current context, but be sure of it
+    glfwMakeContextCurrent(share);
+    if ((int)windows.size() < cells || !windows.back()->program) {
+        stop();
+        return false;
+    }
+
+    running = true;
+    for (size_t i = 0; i < windows.size(); ++i) {
+        windows[i]->thread = std::thread(&DisplayWall::run, this, windows[i]);
+    }
+    std::cout << "Display wall: " << columns << "x" << rows << (perMonitor ? " monitors" : " windows") << std::endl;
+    return true;
+}
+
+
+void DisplayWall::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    frameReady.notify_all();
+    frameDrawn.notify_all();
+    for (size_t i = 0; i < windows.size(); ++i) {
+        if (windows[i]->thread.joinable()) {
+            windows[i]->thread.join();
+        }
+    }
+    for (size_t i = 0; i < windows.size(); ++i) {
+        glDeleteProgram(windows[i]->program);
+        glDeleteProgram(windows[i]->nextProgram);
+        glfwDestroyWindow(windows[i]->window);
+        delete windows[i];
+    }
+    windows.clear();
+    if (fence) {
+        glDeleteSync(fence);
+        fence = 0;
+    }
+    generation = drawnGeneration = 0;
+    drawn = 0;
+}
+
+
+bool DisplayWall::reloadProgram(const char* vertexShader, const char* fragmentShader) {
+    std::vector<GLuint> programs;
+    bool linked = true;
+    for (size_t i = 0; i < windows.size() && linked; ++i) {
+        GLuint program = createShaderProgram(vertexShader, fragmentShader);
+        int success = 0;
+        if (program) {
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+        }
+        programs.push_back(program);
+        linked = success != 0;
+    }
+    if (!linked) {
+        for (size_t i = 0; i < programs.size(); ++i) {
+            glDeleteProgram(programs[i]);
+        }
+        return false;
+    }
+    // The threads pick the programs up with their next frame
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < windows.size(); ++i) {
+        glDeleteProgram(windows[i]->nextProgram); // Never picked up, replaced again
+        windows[i]->nextProgram = programs[i];
+    }
+    return true;
+}
+
+
+void DisplayWall::present(const WallFrame& next) {
+    if (windows.empty()) {
+        return;
+    }
+    for (size_t i = 0; i < windows.size(); ++i) {
+        glfwGetFramebufferSize(windows[i]->window, &windows[i]->framebufferWidth, &windows[i]->framebufferHeight);
+    }
+    // The wall contexts wait for this on the GPU, not the CPU; the flush makes sure it gets there
+    GLsync uploaded = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    frame = next;
+    if (fence) {
+        glDeleteSync(fence);
+    }
+    fence = uploaded;
+    drawn = 0;
+    uint64_t presented = ++generation;
+    frameReady.notify_all();
+    // Until every window has drawn, the textures may still be read
+    frameDrawn.wait(lock, [&] { return drawnGeneration >= presented || !running; });
+}
+
+
+void DisplayWall::framebufferSize(int* width, int* height) const {
+    *width = 0;
+    *height = 0;
+    // The top row spans the width, the first column the height
+    for (size_t i = 0; i < windows.size(); ++i) {
+        if (windows[i]->row == 0) {
+            *width += windows[i]->framebufferWidth;
+        }
+        if (windows[i]->column == 0) {
+            *height += windows[i]->framebufferHeight;
+        }
+    }
+}
+
+
+bool DisplayWall::shouldClose() const {
+    for (size_t i = 0; i < windows.size(); ++i) {
+        if (glfwWindowShouldClose(windows[i]->window)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// The uniforms a wall thread sets every frame
+struct WallLocations {
+    GLint colormapSize;
+    GLint view;
+    GLint isolineCount;
+    GLint isolineWidth;
+};
+
+
+// Make program current in the calling thread's context, point its samplers at their units
+// and look up the rest
+static void useWallProgram(GLuint program, WallLocations* locations) {
+    glUseProgram(program);
+    setDisplaySamplerUnits(program);
+    locations->colormapSize = glGetUniformLocation(program, "colormapSize");
+    locations->view = glGetUniformLocation(program, "uView");
+    locations->isolineCount = glGetUniformLocation(program, "isolineCount");
+    locations->isolineWidth = glGetUniformLocation(program, "isolineWidth");
+}
+
+
+void DisplayWall::run(WallWindow* wall) {
+    glfwMakeContextCurrent(wall->window);
+    // Swaps wait for the vertical blank, so the windows released together flip together
+    glfwSwapInterval(1);
+    // A vertex array object is a container, one of the few things contexts don't share
+    FullscreenTriangle triangle;
+    createFullscreenTriangle(&triangle);
+    WallLocations locations;
+    useWallProgram(wall->program, &locations);
+
+    uint64_t shown = 0;
+    for (;;) {
+        WallFrame current;
+        int width, height;
+        GLuint nextProgram;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameReady.wait(lock, [&] { return generation != shown || !running; });
+            if (!running) {
+                break;
+            }
+            shown = generation;
+            current = frame;
+            width = wall->framebufferWidth;
+            height = wall->framebufferHeight;
+            nextProgram = wall->nextProgram;
+            wall->nextProgram = 0;
+            glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+        }
+
+        // A reload: nothing else uses this window's old program, so it can go right away
+        if (nextProgram) {
+            glDeleteProgram(wall->program);
+            wall->program = nextProgram;
+            useWallProgram(wall->program, &locations);
+        }
+
+        // This window's cell of the view; rows count from the top, texture coordinates from the bottom
+        float cellU = (current.view.u1 - current.view.u0) / columns;
+        float cellV = (current.view.v1 - current.view.v0) / rows;
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_1D, current.colormapTexture);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, current.valueRangeTexture);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, current.heatmapTexture);
+        glUniform1f(locations.colormapSize, (float)current.colormapSize);
+        glUniform1f(locations.isolineCount, current.isolineCount);
+        glUniform1f(locations.isolineWidth, current.isolineWidth);
+        glUniform4f(locations.view, current.view.u0 + wall->column * cellU, current.view.v1 - (wall->row + 1) * cellV,
+                    cellU, cellV);
+        drawFullscreenTriangle(&triangle);
+        // Done on the GPU before anyone swaps, so the barrier doesn't release a window still drawing
+        glFinish();
+
+        // Barrier: the last window to arrive releases the swaps (and the main thread)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (++drawn == (int)windows.size()) {
+                drawnGeneration = shown;
+                frameDrawn.notify_all();
+            } else {
+                frameDrawn.wait(lock, [&] { return drawnGeneration >= shown || !running; });
+            }
+            if (!running) {
+                break;
+            }
+        }
+        glfwSwapBuffers(wall->window);
+    }
+
+    destroyFullscreenTriangle(&triangle);
+    glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,107 @@
+/*
+    Driving a display wall: one logical heatmap spread over a grid of windows.
+
+    Every window of the wall has its own context and its own render thread, so the
+    drivers of several GPUs (or several outputs of one) work in parallel. With as many
+    monitors as wall cells, each window covers one monitor without decorations; otherwise
+    the windows are laid out side by side on the desktop.
+
+    The contexts share objects with the main window's context. The field is therefore
+    generated and uploaded once, by the main thread; the driver copies it to whichever GPU
+    scans out a window. present() puts a fence behind the upload and hands the frame to the
+    wall threads, which wait for the fence on the GPU, draw their part of the view and
+    finish. All of them then swap together: a barrier releases the swaps only once every
+    window has drawn the same frame, and with vsync on in every context the panels flip
+    on the same refresh instead of tearing against each other. (NV_swap_group would tie
+    the flips down in hardware, but it needs the GLX/WGL entry points our GLEW build
+    doesn't load; the barrier works with every driver.)
+
+    Each window has its own display program, as uniforms belong to the program and every
+    window sets a different view. The main thread links them; a reloaded program is handed
+    to its thread, which switches over before its next draw.
+*/
+
+#ifndef DISPLAY_WALL_H
+#define DISPLAY_WALL_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "view_transform.h"
+
+// What every window of the wall needs to draw one frame
+struct WallFrame {
+    GLuint heatmapTexture;
+    GLuint colormapTexture;
+    int colormapSize;
+    GLuint valueRangeTexture;   // Texel (0, 0) holds (min, max), see value_range.h
+    TextureRect view;           // The whole wall's part of the field
+    float isolineCount;         // Isolines as in fragment_shader.glsl, 0 = none
+    float isolineWidth;
+};
+
+class DisplayWall {
+public:
+    DisplayWall();
+    ~DisplayWall();
+
+    // Open columns x rows windows sharing objects with share, whose context must be current,
+    // and start their threads. The display program is built from the two shader files.
+    bool start(GLFWwindow* share, int columns, int rows, const char* vertexShader, const char* fragmentShader);
+    void stop();
+
+    // Rebuild every window's display program from the two shader files, e.g. after they were
+    // edited. Links on the calling thread, with share's context current; if any program fails
+    // to link, the windows keep their current programs and false is returned.
+    bool reloadProgram(const char* vertexShader, const char* fragmentShader);
+
+    // Draw frame on every window and return once all of them have drawn it; the swaps
+    // follow on the wall threads. Call from the main thread, with share's context current.
+    void present(const WallFrame& frame);
+
+    int windowCount() const { return (int)windows.size(); }
+    GLFWwindow* window(int i) const { return windows[i]->window; }
+
+    // Framebuffer size of the whole wall, in pixels
+    void framebufferSize(int* width, int* height) const;
+
+    // true when any of the windows was asked to close
+    bool shouldClose() const;
+
+private:
+    DisplayWall(const DisplayWall&);
+    DisplayWall& operator=(const DisplayWall&);
+
+    struct WallWindow {
+        GLFWwindow* window;
+        GLuint program;             // Only touched by the window's thread while it runs
+        GLuint nextProgram;         // A reloaded program waiting for the thread, 0 if none
+        int column, row;            // Row 0 is the top of the wall
+        int framebufferWidth;       // Updated by present, GLFW only answers on the main thread
+        int framebufferHeight;
+        std::thread thread;
+    };
+
+    void run(WallWindow* window);
+
+    std::vector<WallWindow*> windows;
+    int columns, rows;
+
+    std::mutex mutex;
+    std::condition_variable frameReady;     // Main thread -> wall threads
+    std::condition_variable frameDrawn;     // Last wall thread to draw -> everyone
+    WallFrame frame;
+    GLsync fence;                           // Behind the main thread's uploads for frame
+    uint64_t generation;                    // Frames handed out
+    uint64_t drawnGeneration;               // Frames every window has drawn
+    int drawn;                              // Windows that drew the current frame
+    bool running;
+};
+
+#endif
@@ -0,0 +1,143 @@
+/*
+    Converts a recorded sequence into compressed .hmc frames (see field_codec.h) for --play.
+
+    Every keyframe-th frame is stored on its own, the ones in between as deltas against the
+    frame before them, exactly as the viewer will have decoded it. Seeking to a frame decodes
+    at most keyframe - 1 deltas, so smaller intervals seek faster and compress a little less.
+    The output files keep the names of the input files, with the extension .hmc.
+
+    Usage: compress_fields [--quantize none|16|8] [--codec lz4|zstd|none] [--keyframe N]
+                           [--range MIN,MAX] [--size WxH] INPUT_DIR|LIST OUTPUT_DIR
+    (defaults: exact floats, lz4, a key frame every 30 frames, each frame's own range for
+    quantizing, and --size is only needed for headerless raw files)
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "../field_codec.h"
+#include "../frame_cache.h"
+#include "../thread_pool.h"
+
+static void printUsage() {
+    std::cerr << "Usage: compress_fields [--quantize none|16|8] [--codec lz4|zstd|none] [--keyframe N]" << std::endl
+              << "                       [--range MIN,MAX] [--size WxH] INPUT_DIR|LIST OUTPUT_DIR" << std::endl;
+}
+
+
+// OUTPUT_DIR/<name of input without directory and extension>.hmc
+static std::string outputPath(const std::string& directory, const std::string& input) {
+    size_t slash = input.find_last_of('/');
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        name = name.substr(0, dot);
+    }
+    return directory + "/" + name + ".hmc";
+}
+
+
+int main(int argc, char** argv) {
+    FieldEncoding encoding = defaultFieldEncoding();
+    int keyframeInterval = 30;
+    int rawWidth = 0, rawHeight = 0;
+    std::vector<const char*> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--quantize" && i + 1 < argc) {
+            if (!parseFieldQuantization(argv[++i], &encoding.quantization)) {
+                return -1;
+            }
+        } else if (arg == "--codec" && i + 1 < argc) {
+            if (!parseFieldCodec(argv[++i], &encoding.codec)) {
+                return -1;
+            }
+        } else if (arg == "--keyframe" && i + 1 < argc) {
+            keyframeInterval = std::atoi(argv[++i]);
+        } else if (arg == "--range" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%f,%f", &encoding.rangeMin, &encoding.rangeMax) != 2 ||
+                !(encoding.rangeMax > encoding.rangeMin)) {
+                std::cerr << "--range expects MIN,MAX with MIN < MAX" << std::endl;
+                return -1;
+            }
+            encoding.fixedRange = true;
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &rawWidth, &rawHeight) != 2 || rawWidth <= 0 || rawHeight <= 0) {
+                std::cerr << "--size expects WIDTHxHEIGHT" << std::endl;
+                return -1;
+            }
+        } else if (arg.compare(0, 2, "--") == 0) {
+            printUsage();
+            return -1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    if (positional.size() != 2 || keyframeInterval <= 0) {
+        printUsage();
+        return -1;
+    }
+    std::vector<std::string> inputs;
+    if (!listFrameSequence(positional[0], &inputs)) {
+        return -1;
+    }
+    std::string outputDirectory = positional[1];
+    if (mkdir(outputDirectory.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Failed to create " << outputDirectory << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    // The encoder predicts each delta frame from reconstructed, the previous frame as the
+    // decoder will see it, and overwrites it with this frame's reconstruction
+    ThreadPool pool;
+    CachedFrame frame;
+    CachedFrame previous;
+    FieldBuffer reconstructed;
+    std::vector<unsigned char> compressed;
+    unsigned long long rawBytes = 0, compressedBytes = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (!loadFieldFrame(inputs[i], rawWidth, rawHeight, &frame, i > 0 ? &previous : NULL, &pool)) {
+            return -1;
+        }
+        size_t texels = (size_t)frame.width * frame.height;
+        bool keyframe = i % keyframeInterval == 0 || reconstructed.size() != texels;
+        reconstructed.resize(texels);
+        if (!encodeCompressedField(frame.data.data(), frame.width, frame.height,
+                                   keyframe ? NULL : reconstructed.data(), encoding, &compressed,
+                                   reconstructed.data(), &pool)) {
+            return -1;
+        }
+
+        std::string path = outputPath(outputDirectory, inputs[i]);
+        FILE* file = fopen(path.c_str(), "wb");
+        bool ok = file && fwrite(compressed.data(), 1, compressed.size(), file) == compressed.size();
+        if (file && fclose(file) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "Failed to write " << path << std::endl;
+            return -1;
+        }
+        rawBytes += texels * sizeof(float);
+        compressedBytes += compressed.size();
+
+        // The input itself may be delta-coded: keep the decoded frame as its reference
+        std::swap(frame, previous);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << inputs.size() << " frames, " << rawBytes / (1024 * 1024) << " MB -> "
+              << compressedBytes / (1024 * 1024) << " MB (" << (double)rawBytes / (double)compressedBytes
+              << "x) in " << elapsed.count() << " s" << std::endl;
+    return 0;
+}
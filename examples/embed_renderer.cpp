@@ -0,0 +1,134 @@
+/*
+    Example of embedding the heatmap in another program's render loop with HeatmapRenderer.
+
+    The program owns the window, the context and an offscreen framebuffer, as an application
+    with its own scene would. Two heatmaps of different fields live in a std::vector (the
+    renderer is move-only); every frame both are streamed a new field, drawn side by side
+    into the offscreen framebuffer, and the framebuffer is blitted to the window. Run it
+    from the directory with the .glsl files.
+
+    Usage: embed_renderer [size]     (default 512)
+*/
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "../field_generator.h"
+#include "../heatmap_renderer.h"
+#include "../thread_pool.h"
+
+static const int WINDOW_WIDTH = 1024;
+static const int WINDOW_HEIGHT = 512;
+
+
+int main(int argc, char** argv) {
+    int size = argc > 1 ? std::atoi(argv[1]) : 512;
+    if (size <= 0) {
+        std::cerr << "Usage: embed_renderer [size]" << std::endl;
+        return -1;
+    }
+
+    // The application's own setup: the renderer only needs a current context
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Embedded heatmaps", NULL, NULL);
+    if (!window) {
+        std::cerr << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glGetError();
+
+    // The application's scene target, which the heatmaps are drawn into
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    GLuint sceneTexture, sceneFramebuffer;
+    glGenTextures(1, &sceneTexture);
+    glBindTexture(GL_TEXTURE_2D, sceneTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glGenFramebuffers(1, &sceneFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "The scene framebuffer is incomplete" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    std::vector<HeatmapRenderer> heatmaps;
+    {
+        const char* colormaps[2] = { "viridis", "inferno" };
+        for (int i = 0; i < 2; ++i) {
+            HeatmapRendererOptions options;
+            options.width = size;
+            options.height = size;
+            options.colormap = colormaps[i];
+            HeatmapRenderer heatmap;
+            if (!heatmap.create(options)) {
+                glfwTerminate();
+                return -1;
+            }
+            heatmaps.push_back(std::move(heatmap));
+        }
+        heatmaps[1].setIsolines(8);
+    }
+
+    ThreadPool pool;
+    std::vector<float> field((size_t)size * size);
+    RingParams params[2] = { defaultRingParams(), defaultRingParams() };
+    params[1].scale = 60.0f;
+    params[1].centerX = 0.3f;
+    double start = glfwGetTime();
+
+    while (!glfwWindowShouldClose(window)) {
+        // The application's data path: a new field for each heatmap
+        double time = glfwGetTime() - start;
+        for (int i = 0; i < 2; ++i) {
+            params[i].phase = (float)(time * (i + 1) * 2.0);
+            generateRingField(field.data(), size, size, params[i], &pool);
+            heatmaps[i].upload(field.data(), &pool);
+        }
+
+        // The application's frame: clear its scene, let each heatmap draw its half, present
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        const int margin = 16;
+        for (int i = 0; i < 2; ++i) {
+            heatmaps[i].render(sceneFramebuffer, i * width / 2 + margin, margin, width / 2 - 2 * margin,
+                               height - 2 * margin);
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    // The renderers free their objects while the context still exists
+    heatmaps.clear();
+    glDeleteFramebuffers(1, &sceneFramebuffer);
+    glDeleteTextures(1, &sceneTexture);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+    Example producer for the shared-memory ring: stands in for a simulation running on the
+    same machine as the viewer.
+
+    Creates the ring, then generates the ring pattern with a moving phase straight into the
+    next slot, as a solver would write its output, and publishes it. Start it first, then
+    the viewer with --shm NAME.
+
+    Usage: shm_producer [name] [size] [fps]     (defaults: /heatmap 4096 60; fps 0 = as fast as possible)
+*/
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "../field_generator.h"
+#include "../shared_field.h"
+#include "../thread_pool.h"
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+
+int main(int argc, char** argv) {
+    const char* name = argc > 1 ? argv[1] : "/heatmap";
+    int size = argc > 2 ? std::atoi(argv[2]) : 4096;
+    double fps = argc > 3 ? std::atof(argv[3]) : 60.0;
+    if (size <= 0 || fps < 0.0) {
+        std::cerr << "Usage: shm_producer [name] [size] [fps]" << std::endl;
+        return -1;
+    }
+
+    SharedFieldRing ring;
+    if (!createSharedFieldRing(&ring, name, size, size)) {
+        return -1;
+    }
+    // Ctrl-C still removes the shared object
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::cout << "Writing " << size << "x" << size << " fields to " << name << ", Ctrl-C to stop" << std::endl;
+
+    ThreadPool pool;
+    RingParams params = defaultRingParams();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point next = start;
+    long long frames = 0;
+    while (!stopRequested) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        params.phase = (float)elapsed.count() * 2.0f;
+        float* slot = beginSharedFieldWrite(&ring);
+        generateRingField(slot, size, size, params, &pool);
+        endSharedFieldWrite(&ring);
+        ++frames;
+        if (fps > 0.0) {
+            next += std::chrono::microseconds((long long)(1e6 / fps));
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << frames << " frames in " << elapsed.count() << " s" << std::endl;
+    closeSharedFieldRing(&ring);
+    return 0;
+}
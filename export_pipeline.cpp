@@ -0,0 +1,80 @@
+#include "export_pipeline.h"
+
+#include "image_writer.h"
+
+
+ExportPipeline::ExportPipeline(unsigned encoderThreads, size_t queueDepth)
+    : encodeQueue(queueDepth), writeQueue(queueDepth), recycleLimit(queueDepth * 2), failures(0), finished(false) {
+    if (encoderThreads == 0) {
+        unsigned hardware = std::thread::hardware_concurrency();
+        encoderThreads = hardware > 1 ? hardware - 1 : 1;
+    }
+    for (unsigned i = 0; i < encoderThreads; ++i) {
+        encoders.push_back(std::thread(&ExportPipeline::encodeLoop, this));
+    }
+    writer = std::thread(&ExportPipeline::writeLoop, this);
+}
+
+
+ExportPipeline::~ExportPipeline() {
+    finish();
+}
+
+
+std::unique_ptr<ExportImage> ExportPipeline::acquire() {
+    std::lock_guard<std::mutex> lock(recycledMutex);
+    if (recycled.empty()) {
+        return std::unique_ptr<ExportImage>(new ExportImage());
+    }
+    std::unique_ptr<ExportImage> image = std::move(recycled.back());
+    recycled.pop_back();
+    return image;
+}
+
+
+void ExportPipeline::submit(std::unique_ptr<ExportImage> image) {
+    encodeQueue.push(std::move(image));
+}
+
+
+int ExportPipeline::finish() {
+    if (!finished) {
+        finished = true;
+        // Let the encoders drain their queue, then the writer drain its own
+        encodeQueue.close();
+        for (size_t i = 0; i < encoders.size(); ++i) {
+            encoders[i].join();
+        }
+        writeQueue.close();
+        writer.join();
+    }
+    return failures;
+}
+
+
+void ExportPipeline::encodeLoop() {
+    std::unique_ptr<ExportImage> image;
+    while (encodeQueue.pop(&image)) {
+        encodeImage(imageFileTypeForPath(image->path), image->pixels.data(), image->width, image->height,
+                    image->width * 4, true, &image->encoded);
+        writeQueue.push(std::move(image));
+    }
+}
+
+
+// Files are written by a single thread: parallel writes rarely make a disk faster
+void ExportPipeline::writeLoop() {
+    std::unique_ptr<ExportImage> image;
+    while (writeQueue.pop(&image)) {
+        if (!writeImageFile(image->path.c_str(), image->encoded)) {
+            ++failures;
+        }
+        {
+            std::lock_guard<std::mutex> lock(recycledMutex);
+            if (recycled.size() < recycleLimit) {
+                recycled.push_back(std::move(image));
+            }
+        }
+        image.reset();
+    }
+}
@@ -0,0 +1,73 @@
+/*
+    Encoding and writing exported images off the render thread.
+
+    Batch export runs as a pipeline of stages connected by bounded queues:
+
+        render + readback (render thread) -> encode (worker threads) -> write (one thread)
+
+    The render thread hands every image it reads back to submit and moves on to the next
+    field while the encoders turn earlier images into PNG or EXR files. Each queue holds only
+    a few images: when encoding falls behind, submit blocks and the render thread waits,
+    instead of buffering every frame of a long batch in memory. Throughput then grows with
+    the number of encoder threads until the GPU or the disk becomes the limit.
+*/
+
+#ifndef EXPORT_PIPELINE_H
+#define EXPORT_PIPELINE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+
+struct ExportImage {
+    std::string path;                       // The extension picks the file type (see image_writer.h)
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;      // RGBA8, bottom row first, as glReadPixels returns them
+    std::vector<unsigned char> encoded;     // File contents, filled by an encoder
+};
+
+class ExportPipeline {
+public:
+    // encoderThreads == 0 uses one encoder per hardware thread, less one for the render thread.
+    // queueDepth is the number of images each queue holds before submit starts to wait.
+    explicit ExportPipeline(unsigned encoderThreads = 0, size_t queueDepth = 4);
+    ~ExportPipeline();
+
+    // An image to fill and submit. Buffers of written images are handed out again, so a long
+    // batch doesn't allocate a new frame for every image.
+    std::unique_ptr<ExportImage> acquire();
+
+    // Queue an image for encoding. Blocks while the encoders are queueDepth images behind.
+    void submit(std::unique_ptr<ExportImage> image);
+
+    // Wait until every submitted image is written and stop the threads.
+    // Returns the number of images that failed to write.
+    int finish();
+
+    unsigned encoderCount() const { return (unsigned)encoders.size(); }
+
+private:
+    ExportPipeline(const ExportPipeline&);
+    ExportPipeline& operator=(const ExportPipeline&);
+
+    void encodeLoop();
+    void writeLoop();
+
+    BoundedQueue<std::unique_ptr<ExportImage> > encodeQueue;
+    BoundedQueue<std::unique_ptr<ExportImage> > writeQueue;
+    std::vector<std::thread> encoders;
+    std::thread writer;
+    std::mutex recycledMutex;
+    std::vector<std::unique_ptr<ExportImage> > recycled;
+    size_t recycleLimit;
+    std::atomic<int> failures;
+    bool finished;
+};
+
+#endif
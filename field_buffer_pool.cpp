@@ -0,0 +1,162 @@
+#include "field_buffer_pool.h"
+
+#include <iostream>
+#include <new>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Blocks are multiples of the x86-64/ARM64 huge page size
+static const size_t BLOCK_ALIGNMENT = (size_t)2 << 20;
+
+
+// Map bytes (a multiple of BLOCK_ALIGNMENT) and fault every page in now rather than on the
+// first write of some frame later on
+static float* mapBlock(size_t bytes) {
+    void* block = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // Only succeeds if the administrator reserved huge pages (vm.nr_hugepages)
+    block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+                 -1, 0);
+#endif
+    if (block != MAP_FAILED) {
+        return (float*)block;
+    }
+    block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) {
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    // Transparent huge pages; has to be set before the pages are touched
+    madvise(block, bytes, MADV_HUGEPAGE);
+#endif
+    long pageSize = sysconf(_SC_PAGESIZE);
+    volatile char* bytesOut = (volatile char*)block;
+    for (size_t offset = 0; offset < bytes; offset += (size_t)pageSize) {
+        bytesOut[offset] = 0;
+    }
+    return (float*)block;
+}
+
+
+FieldBuffer::FieldBuffer(FieldBufferPool* bufferPool)
+    : pool(bufferPool ? bufferPool : sharedFieldBufferPool()), values(NULL), count(0), blockBytes(0) {
+}
+
+
+FieldBuffer::FieldBuffer(FieldBuffer&& other)
+    : pool(other.pool), values(other.values), count(other.count), blockBytes(other.blockBytes) {
+    other.values = NULL;
+    other.count = 0;
+    other.blockBytes = 0;
+}
+
+
+FieldBuffer& FieldBuffer::operator=(FieldBuffer&& other) {
+    if (this != &other) {
+        reset();
+        pool = other.pool;
+        std::swap(values, other.values);
+        std::swap(count, other.count);
+        std::swap(blockBytes, other.blockBytes);
+    }
+    return *this;
+}
+
+
+FieldBuffer::~FieldBuffer() {
+    reset();
+}
+
+
+void FieldBuffer::resize(size_t newCount) {
+    if (newCount * sizeof(float) > blockBytes) {
+        reset();
+        values = pool->acquireBlock(newCount * sizeof(float), &blockBytes);
+        if (!values) {
+            // The caller writes newCount floats next; there is no way to carry on
+            std::cerr << "Failed to allocate a field buffer of " << newCount * sizeof(float) << " bytes" << std::endl;
+            throw std::bad_alloc();
+        }
+    }
+    count = newCount;
+}
+
+
+void FieldBuffer::reset() {
+    if (values) {
+        pool->releaseBlock(values, blockBytes);
+    }
+    values = NULL;
+    count = 0;
+    blockBytes = 0;
+}
+
+
+FieldBufferPool::FieldBufferPool(size_t maxCachedBytes) : cached(0), maxCached(maxCachedBytes), mapped(0) {
+}
+
+
+FieldBufferPool::~FieldBufferPool() {
+    for (std::multimap<size_t, float*>::iterator it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+        munmap(it->second, it->first);
+    }
+}
+
+
+float* FieldBufferPool::acquireBlock(size_t bytes, size_t* blockBytes) {
+    size_t rounded = (bytes + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // The smallest free block that fits, unless it would waste more than it holds
+        std::multimap<size_t, float*>::iterator it = freeBlocks.lower_bound(rounded);
+        if (it != freeBlocks.end() && it->first <= 2 * rounded) {
+            float* block = it->second;
+            *blockBytes = it->first;
+            cached -= it->first;
+            freeBlocks.erase(it);
+            return block;
+        }
+    }
+    // Mapping and faulting in can take a while; don't hold up other threads meanwhile
+    float* block = mapBlock(rounded);
+    if (!block) {
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ++mapped;
+    *blockBytes = rounded;
+    return block;
+}
+
+
+void FieldBufferPool::releaseBlock(float* block, size_t blockBytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cached + blockBytes <= maxCached) {
+            freeBlocks.insert(std::make_pair(blockBytes, block));
+            cached += blockBytes;
+            return;
+        }
+    }
+    munmap(block, blockBytes);
+}
+
+
+size_t FieldBufferPool::mappedBlocks() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return mapped;
+}
+
+
+size_t FieldBufferPool::cachedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cached;
+}
+
+
+FieldBufferPool* sharedFieldBufferPool() {
+    static FieldBufferPool pool;
+    return &pool;
+}
@@ -0,0 +1,86 @@
+/*
+    A pool of large float buffers for fields.
+
+    A field of a few thousand texels squared is tens to hundreds of megabytes. Allocating one
+    fresh (or letting a std::vector grow) costs a page fault for every 4 KB page the first
+    time it is written, plus zero-filling it, which at streaming rates is more work than
+    generating the field. The pool maps memory in 2 MB steps, asks Linux for huge pages
+    (MAP_HUGETLB if pages are reserved, transparent huge pages otherwise) and touches every
+    page once when the block is created. Blocks go back to the pool when their FieldBuffer
+    is destroyed or resized and are handed out again for any request that fits, so after the
+    first few frames nothing is allocated or faulted in any more, even when the size changes.
+
+    The pool is thread-safe; a single FieldBuffer is not (like a std::vector).
+*/
+
+#ifndef FIELD_BUFFER_POOL_H
+#define FIELD_BUFFER_POOL_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+class FieldBufferPool;
+
+// A block of floats borrowed from a FieldBufferPool, used like a std::vector<float> that
+// never shrinks. Move-only; the block goes back to the pool when the buffer is destroyed.
+class FieldBuffer {
+public:
+    // NULL takes blocks from sharedFieldBufferPool()
+    explicit FieldBuffer(FieldBufferPool* pool = NULL);
+    FieldBuffer(FieldBuffer&& other);
+    FieldBuffer& operator=(FieldBuffer&& other);
+    ~FieldBuffer();
+
+    // Hold count floats. Shrinking, or growing within the block, keeps the contents; growing
+    // past it swaps in another block from the pool and the contents are undefined. Unlike a
+    // std::vector, new values are never zeroed.
+    void resize(size_t count);
+    // Give the block back to the pool now
+    void reset();
+
+    float* data() { return values; }
+    const float* data() const { return values; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    FieldBuffer(const FieldBuffer&);
+    FieldBuffer& operator=(const FieldBuffer&);
+
+    FieldBufferPool* pool;
+    float* values;
+    size_t count;
+    size_t blockBytes;
+};
+
+class FieldBufferPool {
+public:
+    // Free blocks beyond maxCachedBytes are unmapped instead of kept
+    explicit FieldBufferPool(size_t maxCachedBytes = (size_t)1 << 30);
+    // Every FieldBuffer of the pool must be gone by now
+    ~FieldBufferPool();
+
+    // A block of at least bytes; *blockBytes receives its real size. NULL if mapping failed.
+    float* acquireBlock(size_t bytes, size_t* blockBytes);
+    void releaseBlock(float* block, size_t blockBytes);
+
+    // Blocks mapped so far, for checking that a steady state allocates nothing
+    size_t mappedBlocks() const;
+    size_t cachedBytes() const;
+
+private:
+    FieldBufferPool(const FieldBufferPool&);
+    FieldBufferPool& operator=(const FieldBufferPool&);
+
+    mutable std::mutex mutex;
+    std::multimap<size_t, float*> freeBlocks;   // Size in bytes -> block
+    size_t cached;
+    size_t maxCached;
+    size_t mapped;
+};
+
+// The pool used by the generator, loader and ingest paths unless they are given another one
+FieldBufferPool* sharedFieldBufferPool();
+
+#endif
@@ -0,0 +1,545 @@
+#include "field_codec.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HEATMAP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+static_assert(sizeof(CompressedFieldHeader) == 40, "CompressedFieldHeader is part of the file format");
+
+// About a megabyte of floats per chunk: enough for the coder to find repeats, small enough
+// that every core gets several chunks
+static const size_t CHUNK_TEXELS = 256 * 1024;
+// Larger frames are treated as corrupt rather than allocated
+static const uint64_t MAX_COMPRESSED_TEXELS = (uint64_t)1 << 30;
+
+
+FieldEncoding defaultFieldEncoding() {
+    FieldEncoding encoding;
+    encoding.quantization = FIELD_QUANTIZE_NONE;
+    encoding.codec = FIELD_CODEC_LZ4;
+    encoding.fixedRange = false;
+    encoding.rangeMin = 0.0f;
+    encoding.rangeMax = 1.0f;
+    return encoding;
+}
+
+
+bool parseFieldQuantization(const char* name, FieldQuantization* quantization) {
+    if (strcmp(name, "none") == 0) {
+        *quantization = FIELD_QUANTIZE_NONE;
+    } else if (strcmp(name, "16") == 0) {
+        *quantization = FIELD_QUANTIZE_16;
+    } else if (strcmp(name, "8") == 0) {
+        *quantization = FIELD_QUANTIZE_8;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+bool parseFieldCodec(const char* name, FieldCodec* codec) {
+    if (strcmp(name, "none") == 0) {
+        *codec = FIELD_CODEC_NONE;
+    } else if (strcmp(name, "lz4") == 0) {
+        *codec = FIELD_CODEC_LZ4;
+    } else if (strcmp(name, "zstd") == 0) {
+#ifndef HEATMAP_HAVE_ZSTD
+        std::cerr << "This build has no zstd support (configure with zstd installed)" << std::endl;
+        return false;
+#endif
+        *codec = FIELD_CODEC_ZSTD;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// ---- LZ4 block format (see lz4_Block_format.md of the LZ4 project) ----
+
+static uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+
+static void writeLength(std::vector<unsigned char>* out, size_t length) {
+    while (length >= 255) {
+        out->push_back(255);
+        length -= 255;
+    }
+    out->push_back((unsigned char)length);
+}
+
+
+// One sequence: literals, then a match of matchLength at offset (matchLength 0: the last literals)
+static void writeSequence(std::vector<unsigned char>* out, const unsigned char* literals, size_t literalLength,
+                          size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength ? matchLength - 4 : 0;
+    out->push_back((unsigned char)((std::min(literalLength, (size_t)15) << 4) | std::min(matchCode, (size_t)15)));
+    if (literalLength >= 15) {
+        writeLength(out, literalLength - 15);
+    }
+    out->insert(out->end(), literals, literals + literalLength);
+    if (matchLength) {
+        out->push_back((unsigned char)(offset & 0xff));
+        out->push_back((unsigned char)(offset >> 8));
+        if (matchCode >= 15) {
+            writeLength(out, matchCode - 15);
+        }
+    }
+}
+
+
+// Greedy LZ4 compressor with a hash table of 4-byte prefixes
+static void lz4Compress(const unsigned char* src, size_t size, std::vector<unsigned char>* out) {
+    out->clear();
+    // The format wants the last 5 bytes as literals and no match starting in the last 12
+    const size_t matchStartLimit = size > 12 ? size - 12 : 0;
+    const size_t matchEndLimit = size > 5 ? size - 5 : 0;
+    const int hashBits = 14;
+    std::vector<uint32_t> table((size_t)1 << hashBits, 0);  // Position + 1 of the last prefix with each hash
+
+    size_t anchor = 0;
+    size_t position = 0;
+    unsigned misses = 0;
+    while (position < matchStartLimit) {
+        uint32_t prefix = read32(src + position);
+        uint32_t hash = (prefix * 2654435761u) >> (32 - hashBits);
+        size_t candidate = table[hash];
+        table[hash] = (uint32_t)(position + 1);
+        if (candidate == 0 || position - (candidate - 1) > 65535 || read32(src + candidate - 1) != prefix) {
+            // Incompressible stretches are skipped faster and faster
+            position += 1 + (misses++ >> 6);
+            continue;
+        }
+        size_t match = candidate - 1;
+        size_t length = 4;
+        while (position + length < matchEndLimit && src[match + length] == src[position + length]) {
+            ++length;
+        }
+        writeSequence(out, src + anchor, position - anchor, position - match, length);
+        position += length;
+        anchor = position;
+        misses = 0;
+    }
+    writeSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+
+static bool readLength(const unsigned char* src, size_t size, size_t* position, size_t* length) {
+    unsigned char byte;
+    do {
+        if (*position >= size) {
+            return false;
+        }
+        byte = src[(*position)++];
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+
+// Decode a block that has to fill dst exactly; false on any malformed input
+static bool lz4Decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t dstSize) {
+    size_t in = 0, out = 0;
+    while (in < size) {
+        unsigned char token = src[in++];
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(src, size, &in, &literalLength)) {
+            return false;
+        }
+        if (literalLength > size - in || literalLength > dstSize - out) {
+            return false;
+        }
+        memcpy(dst + out, src + in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        if (in == size) {
+            break;  // The last sequence has no match
+        }
+        if (size - in < 2) {
+            return false;
+        }
+        size_t offset = src[in] | ((size_t)src[in + 1] << 8);
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(src, size, &in, &matchLength)) {
+            return false;
+        }
+        matchLength += 4;
+        if (offset == 0 || offset > out || matchLength > dstSize - out) {
+            return false;
+        }
+        if (offset >= matchLength) {
+            memcpy(dst + out, dst + out - offset, matchLength);
+        } else {
+            // Overlapping match: repeats the last offset bytes
+            for (size_t i = 0; i < matchLength; ++i) {
+                dst[out + i] = dst[out + i - offset];
+            }
+        }
+        out += matchLength;
+    }
+    return out == dstSize;
+}
+
+
+// ---- Stages ----
+
+static int bytesPerElement(FieldQuantization quantization) {
+    return quantization == FIELD_QUANTIZE_NONE ? 4 : (quantization == FIELD_QUANTIZE_16 ? 2 : 1);
+}
+
+
+// Encoder and decoder both go through these, so they agree on every quantized value
+struct Quantizer {
+    float rangeMin;
+    float scale;            // Levels per unit
+    float step;             // Units per level
+    uint32_t maxLevel;
+};
+
+
+static Quantizer makeQuantizer(FieldQuantization quantization, float rangeMin, float rangeMax) {
+    Quantizer q;
+    q.rangeMin = rangeMin;
+    q.maxLevel = quantization == FIELD_QUANTIZE_16 ? 65535u : 255u;
+    float range = rangeMax - rangeMin;
+    q.scale = range > 0.0f ? (float)q.maxLevel / range : 0.0f;
+    q.step = range > 0.0f ? range / (float)q.maxLevel : 0.0f;
+    return q;
+}
+
+
+static uint32_t quantize(const Quantizer& q, float value) {
+    float level = (value - q.rangeMin) * q.scale;
+    if (!(level > 0.0f)) {
+        return 0;   // Below the range, or NaN
+    }
+    if (level >= (float)q.maxLevel) {
+        return q.maxLevel;
+    }
+    return (uint32_t)(level + 0.5f);
+}
+
+
+static float dequantize(const Quantizer& q, uint32_t level) {
+    return q.rangeMin + (float)level * q.step;
+}
+
+
+static uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    return bits;
+}
+
+
+static float bitsFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+
+static bool compressChunk(FieldCodec codec, const unsigned char* raw, size_t size, std::vector<unsigned char>* out) {
+    if (codec == FIELD_CODEC_LZ4) {
+        lz4Compress(raw, size, out);
+    } else if (codec == FIELD_CODEC_ZSTD) {
+#ifdef HEATMAP_HAVE_ZSTD
+        out->resize(ZSTD_compressBound(size));
+        size_t written = ZSTD_compress(out->data(), out->size(), raw, size, 3);
+        if (ZSTD_isError(written)) {
+            return false;
+        }
+        out->resize(written);
+#else
+        return false;
+#endif
+    }
+    // A chunk that doesn't shrink is stored as it is; its size says so
+    if (codec == FIELD_CODEC_NONE || out->size() >= size) {
+        out->assign(raw, raw + size);
+    }
+    return true;
+}
+
+
+static bool decompressChunk(FieldCodec codec, const unsigned char* chunk, size_t size, unsigned char* raw,
+                            size_t rawSize) {
+    if (size == rawSize) {
+        memcpy(raw, chunk, size);
+        return true;
+    }
+    if (codec == FIELD_CODEC_LZ4) {
+        return lz4Decompress(chunk, size, raw, rawSize);
+    }
+#ifdef HEATMAP_HAVE_ZSTD
+    if (codec == FIELD_CODEC_ZSTD) {
+        size_t written = ZSTD_decompress(raw, rawSize, chunk, size);
+        return !ZSTD_isError(written) && written == rawSize;
+    }
+#endif
+    return false;
+}
+
+
+// Run fn(chunk) for every chunk, on the pool if there is one
+static void forEachChunk(uint32_t chunkCount, ThreadPool* pool, const std::function<void(uint32_t)>& fn) {
+    if (pool && pool->threadCount() > 1 && chunkCount > 1) {
+        pool->parallelFor(0, (int)chunkCount, 1, [&](int begin, int end) {
+            for (int chunk = begin; chunk < end; ++chunk) {
+                fn((uint32_t)chunk);
+            }
+        });
+    } else {
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+            fn(chunk);
+        }
+    }
+}
+
+
+bool encodeCompressedField(const float* data, int width, int height, const float* reference,
+                           const FieldEncoding& encoding, std::vector<unsigned char>* out, float* reconstructed,
+                           ThreadPool* pool) {
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    CompressedFieldHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "HMC1", 4);
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.quantization = (uint8_t)encoding.quantization;
+    header.codec = (uint8_t)encoding.codec;
+    header.delta = reference ? 1 : 0;
+    header.chunkRows = (uint32_t)std::max((size_t)1, CHUNK_TEXELS / (size_t)width);
+    header.chunkCount = (header.height + header.chunkRows - 1) / header.chunkRows;
+    size_t texels = (size_t)width * (size_t)height;
+
+    // Quantized frames cover their own range unless the caller fixed one
+    header.rangeMin = encoding.rangeMin;
+    header.rangeMax = encoding.rangeMax;
+    if (encoding.quantization != FIELD_QUANTIZE_NONE && !encoding.fixedRange) {
+        float low = INFINITY, high = -INFINITY;
+        for (size_t i = 0; i < texels; ++i) {
+            // Written so NaNs are skipped
+            low = data[i] < low ? data[i] : low;
+            high = data[i] > high ? data[i] : high;
+        }
+        header.rangeMin = low <= high ? low : 0.0f;
+        header.rangeMax = low <= high ? high : 0.0f;
+    }
+    Quantizer quantizer = makeQuantizer(encoding.quantization, header.rangeMin, header.rangeMax);
+    int elementBytes = bytesPerElement(encoding.quantization);
+    uint32_t mask = elementBytes == 4 ? 0xffffffffu : ((1u << (8 * elementBytes)) - 1);
+
+    std::vector<std::vector<unsigned char> > chunks(header.chunkCount);
+    std::atomic<bool> failed(false); // Set by any of the pool threads
+    forEachChunk(header.chunkCount, pool, [&](uint32_t chunk) {
+        size_t first = (size_t)chunk * header.chunkRows * (size_t)width;
+        size_t count = std::min((size_t)header.chunkRows * (size_t)width, texels - first);
+        // Byte planes: byte b of element i goes to b * count + i
+        std::vector<unsigned char> planes(count * elementBytes);
+        for (size_t i = 0; i < count; ++i) {
+            size_t texel = first + i;
+            uint32_t element;
+            float decoded;
+            if (encoding.quantization == FIELD_QUANTIZE_NONE) {
+                element = floatBits(data[texel]);
+                decoded = data[texel];
+                if (reference) {
+                    element ^= floatBits(reference[texel]);
+                }
+            } else {
+                uint32_t level = quantize(quantizer, data[texel]);
+                decoded = dequantize(quantizer, level);
+                element = reference ? (level - quantize(quantizer, reference[texel])) & mask : level;
+            }
+            // reference may be reconstructed: only this texel of it has been read so far
+            if (reconstructed) {
+                reconstructed[texel] = decoded;
+            }
+            for (int b = 0; b < elementBytes; ++b) {
+                planes[b * count + i] = (unsigned char)(element >> (8 * b));
+            }
+        }
+        if (!compressChunk(encoding.codec, planes.data(), planes.size(), &chunks[chunk])) {
+            failed = true;
+        }
+    });
+    if (failed) {
+        std::cerr << "Failed to compress a field" << std::endl;
+        return false;
+    }
+
+    size_t tableBytes = (size_t)header.chunkCount * 4;
+    header.dataBytes = tableBytes;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        header.dataBytes += chunks[i].size();
+    }
+    out->resize(sizeof(header) + header.dataBytes);
+    unsigned char* dst = out->data();
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        uint32_t size = (uint32_t)chunks[i].size();
+        memcpy(dst + i * 4, &size, 4);
+    }
+    dst += tableBytes;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        memcpy(dst, chunks[i].data(), chunks[i].size());
+        dst += chunks[i].size();
+    }
+    return true;
+}
+
+
+bool readCompressedFieldHeader(const unsigned char* bytes, size_t size, CompressedFieldHeader* header) {
+    if (size < sizeof(*header)) {
+        return false;
+    }
+    memcpy(header, bytes, sizeof(*header));
+    uint64_t texels = (uint64_t)header->width * header->height;
+    return memcmp(header->magic, "HMC1", 4) == 0 && texels > 0 && texels <= MAX_COMPRESSED_TEXELS &&
+           header->quantization <= FIELD_QUANTIZE_8 && header->codec <= FIELD_CODEC_ZSTD && header->delta <= 1 &&
+           header->chunkRows > 0 && header->chunkCount == (header->height + header->chunkRows - 1) / header->chunkRows &&
+           header->dataBytes >= (uint64_t)header->chunkCount * 4;
+}
+
+
+bool decodeCompressedField(const unsigned char* bytes, size_t size, const float* reference, float* out,
+                           ThreadPool* pool) {
+    CompressedFieldHeader header;
+    if (!readCompressedFieldHeader(bytes, size, &header) || size - sizeof(header) < header.dataBytes) {
+        std::cerr << "Not a valid compressed field" << std::endl;
+        return false;
+    }
+    if (header.delta && !reference) {
+        std::cerr << "A delta frame needs the frame before it" << std::endl;
+        return false;
+    }
+#ifndef HEATMAP_HAVE_ZSTD
+    if (header.codec == FIELD_CODEC_ZSTD) {
+        std::cerr << "The field is zstd-compressed, but this build has no zstd support" << std::endl;
+        return false;
+    }
+#endif
+
+    // Where every chunk starts, from the size table
+    const unsigned char* table = bytes + sizeof(header);
+    std::vector<size_t> chunkOffset(header.chunkCount + 1);
+    chunkOffset[0] = sizeof(header) + (size_t)header.chunkCount * 4;
+    for (uint32_t i = 0; i < header.chunkCount; ++i) {
+        uint32_t chunkSize;
+        memcpy(&chunkSize, table + (size_t)i * 4, 4);
+        chunkOffset[i + 1] = chunkOffset[i] + chunkSize;
+    }
+    if (chunkOffset[header.chunkCount] != sizeof(header) + header.dataBytes) {
+        std::cerr << "Corrupt chunk table in a compressed field" << std::endl;
+        return false;
+    }
+
+    FieldQuantization quantization = (FieldQuantization)header.quantization;
+    Quantizer quantizer = makeQuantizer(quantization, header.rangeMin, header.rangeMax);
+    int elementBytes = bytesPerElement(quantization);
+    uint32_t mask = elementBytes == 4 ? 0xffffffffu : ((1u << (8 * elementBytes)) - 1);
+    size_t width = header.width;
+    size_t texels = width * header.height;
+
+    std::atomic<bool> failed(false);
+    forEachChunk(header.chunkCount, pool, [&](uint32_t chunk) {
+        size_t first = (size_t)chunk * header.chunkRows * width;
+        size_t count = std::min((size_t)header.chunkRows * width, texels - first);
+        std::vector<unsigned char> planes(count * elementBytes);
+        if (!decompressChunk((FieldCodec)header.codec, bytes + chunkOffset[chunk],
+                             chunkOffset[chunk + 1] - chunkOffset[chunk], planes.data(), planes.size())) {
+            failed = true;
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            size_t texel = first + i;
+            uint32_t element = 0;
+            for (int b = 0; b < elementBytes; ++b) {
+                element |= (uint32_t)planes[b * count + i] << (8 * b);
+            }
+            if (quantization == FIELD_QUANTIZE_NONE) {
+                out[texel] = bitsFloat(header.delta ? element ^ floatBits(reference[texel]) : element);
+            } else {
+                uint32_t level = header.delta ? (element + quantize(quantizer, reference[texel])) & mask : element;
+                out[texel] = dequantize(quantizer, level);
+            }
+        }
+    });
+    if (failed) {
+        std::cerr << "Corrupt chunk in a compressed field" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+// Map a whole file read-only; fn gets the bytes. False if the file can't be mapped.
+static bool withMappedFile(const char* path, const std::function<bool(const unsigned char*, size_t)>& fn) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open compressed field: " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "Failed to map compressed field: " << path << std::endl;
+        return false;
+    }
+    // Chunks are decoded in parallel, front to back within each
+    madvise(base, (size_t)info.st_size, MADV_WILLNEED);
+    bool ok = fn((const unsigned char*)base, (size_t)info.st_size);
+    munmap(base, (size_t)info.st_size);
+    return ok;
+}
+
+
+bool readCompressedFieldFileHeader(const char* path, CompressedFieldHeader* header) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    unsigned char bytes[sizeof(CompressedFieldHeader)];
+    bool ok = read(fd, bytes, sizeof(bytes)) == (ssize_t)sizeof(bytes) &&
+              readCompressedFieldHeader(bytes, sizeof(bytes), header);
+    close(fd);
+    return ok;
+}
+
+
+bool decodeCompressedFieldFile(const char* path, const float* reference, float* out, ThreadPool* pool) {
+    return withMappedFile(path, [&](const unsigned char* bytes, size_t size) {
+        if (!decodeCompressedField(bytes, size, reference, out, pool)) {
+            std::cerr << "Failed to decode " << path << std::endl;
+            return false;
+        }
+        return true;
+    });
+}
@@ -0,0 +1,98 @@
+/*
+    Compressed fields: .hmc files and compressed stream frames.
+
+    A full float field of 8192 x 8192 is 256 MB. Consecutive frames of a simulation differ
+    little, and neighbouring values share most of their bits, so a frame goes through four
+    stages that each make the next one work better:
+
+      quantize   optionally map [rangeMin, rangeMax] onto 16 or 8 bits (lossy), otherwise
+                 keep the exact 32-bit float patterns
+      delta      optionally store every value relative to the previous frame of the sequence:
+                 the difference of the quantized values, or the XOR of the float bits, so
+                 an unchanged value becomes zero
+      shuffle    split every chunk into byte planes (all first bytes, then all second bytes,
+                 ...): mostly-zero high bytes turn into long runs
+      compress   a built-in LZ4 block coder (fast enough to decode faster than a disk reads),
+                 or zstd when the build has it (smaller, slower)
+
+    Rows are grouped into chunks that are compressed independently, so a frame is decoded on
+    all cores at once. Delta frames decode exactly against the previous decoded frame: the
+    encoder predicts from what the decoder will reconstruct, never from the original
+    values, so quantization errors don't pile up along a sequence.
+
+    File layout: CompressedFieldHeader, chunkCount uint32 compressed chunk sizes, the chunks.
+*/
+
+#ifndef FIELD_CODEC_H
+#define FIELD_CODEC_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+class ThreadPool;
+
+enum FieldQuantization {
+    FIELD_QUANTIZE_NONE = 0,    // Exact 32-bit floats
+    FIELD_QUANTIZE_16 = 1,
+    FIELD_QUANTIZE_8 = 2
+};
+
+enum FieldCodec {
+    FIELD_CODEC_NONE = 0,
+    FIELD_CODEC_LZ4 = 1,
+    FIELD_CODEC_ZSTD = 2        // Only if built with HEATMAP_HAVE_ZSTD
+};
+
+struct CompressedFieldHeader {
+    char magic[4];          // "HMC1"
+    uint32_t width;
+    uint32_t height;
+    uint8_t quantization;   // FieldQuantization
+    uint8_t codec;          // FieldCodec
+    uint8_t delta;          // 1 if the values are relative to the previous frame
+    uint8_t reserved;
+    float rangeMin;         // Quantized values cover [rangeMin, rangeMax]
+    float rangeMax;
+    uint32_t chunkRows;     // Rows per chunk; the last chunk may have fewer
+    uint32_t chunkCount;
+    uint64_t dataBytes;     // Bytes after the header: the chunk sizes and the chunks
+};
+
+struct FieldEncoding {
+    FieldQuantization quantization;
+    FieldCodec codec;
+    bool fixedRange;        // Quantize [rangeMin, rangeMax] instead of each frame's own range
+    float rangeMin;
+    float rangeMax;
+};
+
+// Exact floats, LZ4
+FieldEncoding defaultFieldEncoding();
+
+bool parseFieldQuantization(const char* name, FieldQuantization* quantization);   // "none", "16", "8"
+bool parseFieldCodec(const char* name, FieldCodec* codec);                        // "none", "lz4", "zstd"
+
+// Compress a width x height field into out (header included). With a reference (the
+// previous frame as the decoder returns it) the frame is stored as a delta against it.
+// reconstructed (optional, may be the same as reference) receives the frame as the decoder
+// will return it: the reference to pass with the next frame.
+bool encodeCompressedField(const float* data, int width, int height, const float* reference,
+                           const FieldEncoding& encoding, std::vector<unsigned char>* out, float* reconstructed,
+                           ThreadPool* pool = 0);
+
+// Check the header at the start of bytes (size bytes long); false if it isn't a valid frame
+bool readCompressedFieldHeader(const unsigned char* bytes, size_t size, CompressedFieldHeader* header);
+
+// Decode a frame into out (width * height floats). Delta frames need the previous frame as
+// reference, which may be out itself. The chunks are decoded in parallel on the pool.
+bool decodeCompressedField(const unsigned char* bytes, size_t size, const float* reference, float* out,
+                           ThreadPool* pool = 0);
+
+// The header of a .hmc file; false if the file isn't one
+bool readCompressedFieldFileHeader(const char* path, CompressedFieldHeader* header);
+
+// Map a .hmc file and decode it into out, which must hold the header's width * height floats
+bool decodeCompressedFieldFile(const char* path, const float* reference, float* out, ThreadPool* pool = 0);
+
+#endif
@@ -0,0 +1,244 @@
+#include "field_generator.h"
+#include "cpu_dispatch.h"
+#include "thread_pool.h"
+
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HEATMAP_HAVE_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define HEATMAP_HAVE_NEON_KERNEL 1
+#include <arm_neon.h>
+#endif
+
+
+// Constants for the polynomial sine.
+// 2*pi is split into a short "hi" part that multiplies exactly and a "lo" correction
+// (Cody-Waite reduction), so reducing large arguments doesn't lose precision.
+static const float INV_TWO_PI = 0.15915494309189535f;
+static const float TWO_PI_HI = 6.28125f;
+static const float TWO_PI_LO = 0.0019353071795864769f;
+static const float PI_F = 3.14159265358979324f;
+static const float HALF_PI = 1.57079632679489662f;
+// Taylor coefficients of sin(r) up to r^11, accurate to ~1e-7 on [-pi/2, pi/2]
+static const float SIN_C3 = -1.6666667e-1f;
+static const float SIN_C5 = 8.3333333e-3f;
+static const float SIN_C7 = -1.9841270e-4f;
+static const float SIN_C9 = 2.7557319e-6f;
+static const float SIN_C11 = -2.5052108e-8f;
+
+
+RingParams defaultRingParams() {
+    RingParams params;
+    params.scale = 30.0f;   // adjust frequency
+    params.centerX = 0.5f;  // Center of the texture
+    params.centerY = 0.5f;
+    params.phase = 0.0f;
+    params.amplitude = 1.0f;
+    params.offset = 0.0f;
+    return params;
+}
+
+
+// Polynomial sine: reduce to [-pi, pi], fold into [-pi/2, pi/2], then evaluate the odd polynomial
+static inline float fastSin(float x) {
+    float k = std::nearbyint(x * INV_TWO_PI);
+    float r = x - k * TWO_PI_HI;
+    r = r - k * TWO_PI_LO;
+    // sin(pi - r) == sin(r), which maps the outer quarters back into the accurate range
+    if (r > HALF_PI) {
+        r = PI_F - r;
+    } else if (r < -HALF_PI) {
+        r = -PI_F - r;
+    }
+    float r2 = r * r;
+    float p = SIN_C11;
+    p = p * r2 + SIN_C9;
+    p = p * r2 + SIN_C7;
+    p = p * r2 + SIN_C5;
+    p = p * r2 + SIN_C3;
+    return r + r * r2 * p;
+}
+
+
+// One row of the field, one pixel at a time.
+// dy2 is the squared vertical distance to the center, which is the same for the whole row.
+// This is the kernel of CPUs without AVX2 or NEON; the compiler's own vectorization of it is
+// built per instruction set (see cpu_dispatch.h), so SSE4 machines still get packed code.
+HEATMAP_TARGET_CLONES
+static void ringRowScalar(float* out, int count, int firstX, float invWidth, float dy2, const RingParams& params) {
+    for (int x = 0; x < count; ++x) {
+        // Normalize x to the range [0, 1]
+        float xNorm = (float)(firstX + x) * invWidth;
+        // Squared difference instead of pow(..., 2.0f)
+        float dx = xNorm - params.centerX;
+        float dist = std::sqrt(dx * dx + dy2);
+        // Apply the sine function to the distance and scale it into the requested range
+        float value = fastSin(params.scale * dist - params.phase);
+        out[x] = params.offset + params.amplitude * value;
+    }
+}
+
+
+#ifdef HEATMAP_HAVE_AVX2_KERNEL
+// Eight pixels per iteration. Compiled for AVX2 + FMA regardless of the global flags;
+// it is only called after the runtime check in resolveFieldKernel.
+__attribute__((target("avx2,fma")))
+static void ringRowAvx2(float* out, int count, int firstX, float invWidth, float dy2, const RingParams& params) {
+    const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 vInvWidth = _mm256_set1_ps(invWidth);
+    const __m256 vCenterX = _mm256_set1_ps(params.centerX);
+    const __m256 vDy2 = _mm256_set1_ps(dy2);
+    const __m256 vScale = _mm256_set1_ps(params.scale);
+    const __m256 vPhase = _mm256_set1_ps(params.phase);
+    const __m256 vAmplitude = _mm256_set1_ps(params.amplitude);
+    const __m256 vOffset = _mm256_set1_ps(params.offset);
+
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        __m256 xs = _mm256_add_ps(_mm256_set1_ps((float)(firstX + x)), lane);
+        __m256 dx = _mm256_fmsub_ps(xs, vInvWidth, vCenterX);
+        __m256 dist = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, vDy2));
+        __m256 arg = _mm256_fmsub_ps(vScale, dist, vPhase);
+
+        // Same range reduction and polynomial as fastSin, eight lanes at a time
+        __m256 k = _mm256_round_ps(_mm256_mul_ps(arg, _mm256_set1_ps(INV_TWO_PI)),
+                                   _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(TWO_PI_HI), arg);
+        r = _mm256_fnmadd_ps(k, _mm256_set1_ps(TWO_PI_LO), r);
+        __m256 upper = _mm256_cmp_ps(r, _mm256_set1_ps(HALF_PI), _CMP_GT_OQ);
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(PI_F), r), upper);
+        __m256 lower = _mm256_cmp_ps(r, _mm256_set1_ps(-HALF_PI), _CMP_LT_OQ);
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(-PI_F), r), lower);
+        __m256 r2 = _mm256_mul_ps(r, r);
+        __m256 p = _mm256_set1_ps(SIN_C11);
+        p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(SIN_C9));
+        p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(SIN_C7));
+        p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(SIN_C5));
+        p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(SIN_C3));
+        __m256 s = _mm256_fmadd_ps(_mm256_mul_ps(r, r2), p, r);
+
+        _mm256_storeu_ps(out + x, _mm256_fmadd_ps(s, vAmplitude, vOffset));
+    }
+    // Leftover pixels at the end of the row
+    ringRowScalar(out + x, count - x, firstX + x, invWidth, dy2, params);
+}
+#endif
+
+
+#ifdef HEATMAP_HAVE_NEON_KERNEL
+// Four pixels per iteration. NEON (with FMA and rounding) is part of every AArch64 CPU.
+static void ringRowNeon(float* out, int count, int firstX, float invWidth, float dy2, const RingParams& params) {
+    const float laneInit[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    const float32x4_t lane = vld1q_f32(laneInit);
+    const float32x4_t vInvWidth = vdupq_n_f32(invWidth);
+    const float32x4_t vCenterX = vdupq_n_f32(params.centerX);
+    const float32x4_t vDy2 = vdupq_n_f32(dy2);
+    const float32x4_t vScale = vdupq_n_f32(params.scale);
+    const float32x4_t vPhase = vdupq_n_f32(params.phase);
+    const float32x4_t vAmplitude = vdupq_n_f32(params.amplitude);
+    const float32x4_t vOffset = vdupq_n_f32(params.offset);
+
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        float32x4_t xs = vaddq_f32(vdupq_n_f32((float)(firstX + x)), lane);
+        float32x4_t dx = vsubq_f32(vmulq_f32(xs, vInvWidth), vCenterX);
+        float32x4_t dist = vsqrtq_f32(vfmaq_f32(vDy2, dx, dx));
+        float32x4_t arg = vsubq_f32(vmulq_f32(vScale, dist), vPhase);
+
+        float32x4_t k = vrndnq_f32(vmulq_f32(arg, vdupq_n_f32(INV_TWO_PI)));
+        float32x4_t r = vfmsq_f32(arg, k, vdupq_n_f32(TWO_PI_HI));
+        r = vfmsq_f32(r, k, vdupq_n_f32(TWO_PI_LO));
+        uint32x4_t upper = vcgtq_f32(r, vdupq_n_f32(HALF_PI));
+        r = vbslq_f32(upper, vsubq_f32(vdupq_n_f32(PI_F), r), r);
+        uint32x4_t lower = vcltq_f32(r, vdupq_n_f32(-HALF_PI));
+        r = vbslq_f32(lower, vsubq_f32(vdupq_n_f32(-PI_F), r), r);
+        float32x4_t r2 = vmulq_f32(r, r);
+        float32x4_t p = vdupq_n_f32(SIN_C11);
+        p = vfmaq_f32(vdupq_n_f32(SIN_C9), p, r2);
+        p = vfmaq_f32(vdupq_n_f32(SIN_C7), p, r2);
+        p = vfmaq_f32(vdupq_n_f32(SIN_C5), p, r2);
+        p = vfmaq_f32(vdupq_n_f32(SIN_C3), p, r2);
+        float32x4_t s = vfmaq_f32(r, vmulq_f32(r, r2), p);
+
+        vst1q_f32(out + x, vfmaq_f32(vOffset, s, vAmplitude));
+    }
+    ringRowScalar(out + x, count - x, firstX + x, invWidth, dy2, params);
+}
+#endif
+
+
+FieldKernel resolveFieldKernel(FieldKernel kernel) {
+#ifdef HEATMAP_HAVE_AVX2_KERNEL
+    bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if ((kernel == FIELD_KERNEL_AUTO || kernel == FIELD_KERNEL_AVX2) && avx2) {
+        return FIELD_KERNEL_AVX2;
+    }
+#endif
+#ifdef HEATMAP_HAVE_NEON_KERNEL
+    if (kernel == FIELD_KERNEL_AUTO || kernel == FIELD_KERNEL_NEON) {
+        return FIELD_KERNEL_NEON;
+    }
+#endif
+    return FIELD_KERNEL_SCALAR;
+}
+
+
+const char* fieldKernelName(FieldKernel kernel) {
+    switch (kernel) {
+    case FIELD_KERNEL_AUTO: return "auto";
+    case FIELD_KERNEL_SCALAR: return "scalar";
+    case FIELD_KERNEL_AVX2: return "avx2";
+    case FIELD_KERNEL_NEON: return "neon";
+    }
+    return "unknown";
+}
+
+
+typedef void (*RingRowFn)(float*, int, int, float, float, const RingParams&);
+
+static RingRowFn ringRowFunction(FieldKernel kernel) {
+    switch (resolveFieldKernel(kernel)) {
+#ifdef HEATMAP_HAVE_AVX2_KERNEL
+    case FIELD_KERNEL_AVX2: return ringRowAvx2;
+#endif
+#ifdef HEATMAP_HAVE_NEON_KERNEL
+    case FIELD_KERNEL_NEON: return ringRowNeon;
+#endif
+    default: return ringRowScalar;
+    }
+}
+
+
+void generateRingRegion(float* data, int stride, int originX, int originY, int width, int height,
+                        int fieldWidth, int fieldHeight, const RingParams& params,
+                        ThreadPool* pool, FieldKernel kernel) {
+    RingRowFn row = ringRowFunction(kernel);
+    float invWidth = 1.0f / (float)fieldWidth;
+    float invHeight = 1.0f / (float)fieldHeight;
+
+    // Generate rows [rowBegin, rowEnd) of the rectangle
+    auto rows = [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            float dy = (float)(originY + y) * invHeight - params.centerY;
+            row(data + (size_t)y * stride, width, originX, invWidth, dy * dy, params);
+        }
+    };
+
+    if (pool && pool->threadCount() > 1 && height > 1) {
+        // A few chunks per worker keeps them busy even if some finish early
+        int grain = height / (int)(pool->threadCount() * 4);
+        pool->parallelFor(0, height, grain > 0 ? grain : 1, rows);
+    } else {
+        rows(0, height);
+    }
+}
+
+
+void generateRingField(float* data, int width, int height, const RingParams& params,
+                       ThreadPool* pool, FieldKernel kernel) {
+    generateRingRegion(data, width, 0, 0, width, height, width, height, params, pool, kernel);
+}
@@ -0,0 +1,55 @@
+/*
+    Procedural ring field (effect of rings radiating from the center).
+
+    value(x, y) = offset + amplitude * sin(scale * distance((x, y), center) - phase)
+
+    By default the values are the raw sine in [-1, 1]; the display finds the range of the
+    field on the GPU (see value_range.h). Formats that only hold [0, 1] (r16, r8) need
+    amplitude = offset = 0.5.
+
+    The generator has a scalar kernel and SIMD kernels (AVX2 on x86, NEON on ARM). All of them
+    use the same polynomial sine so they produce the same picture, and the fastest kernel the
+    CPU supports is picked at runtime. Rows can be split across a ThreadPool.
+*/
+
+#ifndef FIELD_GENERATOR_H
+#define FIELD_GENERATOR_H
+
+class ThreadPool;
+
+struct RingParams {
+    float scale;    // Frequency of the rings
+    float centerX;  // Center of the rings in normalized [0, 1] coordinates
+    float centerY;
+    float phase;    // Shifts the rings outwards over time
+    float amplitude; // value = offset + amplitude * sin(...)
+    float offset;
+};
+
+// The parameters the original demo used: scale 30 around the center of the texture,
+// with raw values (amplitude 1, offset 0)
+RingParams defaultRingParams();
+
+enum FieldKernel {
+    FIELD_KERNEL_AUTO,      // Best kernel supported by this CPU
+    FIELD_KERNEL_SCALAR,
+    FIELD_KERNEL_AVX2,
+    FIELD_KERNEL_NEON
+};
+
+// Resolve FIELD_KERNEL_AUTO (or an unsupported request) to a kernel this CPU can run
+FieldKernel resolveFieldKernel(FieldKernel kernel);
+const char* fieldKernelName(FieldKernel kernel);
+
+// Fill a width x height sub-rectangle of a larger fieldWidth x fieldHeight field.
+// (originX, originY) is the top-left texel of the rectangle; rows in data are stride floats apart.
+// With a pool the rows are split across its workers, otherwise everything runs on the caller.
+void generateRingRegion(float* data, int stride, int originX, int originY, int width, int height,
+                        int fieldWidth, int fieldHeight, const RingParams& params,
+                        ThreadPool* pool = 0, FieldKernel kernel = FIELD_KERNEL_AUTO);
+
+// Fill a complete, tightly packed width x height field
+void generateRingField(float* data, int width, int height, const RingParams& params,
+                       ThreadPool* pool = 0, FieldKernel kernel = FIELD_KERNEL_AUTO);
+
+#endif
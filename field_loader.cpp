@@ -0,0 +1,261 @@
+#include "field_loader.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "field_codec.h"
+
+
+static bool hasExtension(const char* path, const char* extension) {
+    size_t pathLength = strlen(path), extensionLength = strlen(extension);
+    return pathLength >= extensionLength && strcmp(path + pathLength - extensionLength, extension) == 0;
+}
+
+
+// Find the value of 'key' in the Python dict literal of a .npy header
+static std::string npyHeaderValue(const std::string& header, const char* key) {
+    size_t keyPos = header.find(std::string("'") + key + "'");
+    if (keyPos == std::string::npos) {
+        return "";
+    }
+    size_t colon = header.find(':', keyPos);
+    if (colon == std::string::npos) {
+        return "";
+    }
+    size_t begin = header.find_first_not_of(' ', colon + 1);
+    if (begin == std::string::npos) {
+        return "";
+    }
+    // Values are a quoted string, a tuple or a bare word (True / False)
+    size_t end;
+    if (header[begin] == '\'') {
+        end = header.find('\'', begin + 1) + 1;
+    } else if (header[begin] == '(') {
+        end = header.find(')', begin) + 1;
+    } else {
+        end = header.find_first_of(",}", begin);
+    }
+    return end == std::string::npos ? "" : header.substr(begin, end - begin);
+}
+
+
+// Parse the header of a mapped .npy file and locate its data
+static bool parseNpy(const unsigned char* bytes, size_t length, MappedField* field, const char* path) {
+    if (length < 10 || memcmp(bytes, "\x93NUMPY", 6) != 0) {
+        std::cerr << "Not a NumPy file: " << path << std::endl;
+        return false;
+    }
+    // Version 1 stores the header length in 2 bytes, versions 2 and 3 in 4 bytes
+    int major = bytes[6];
+    size_t headerLength, headerStart;
+    if (major == 1) {
+        headerLength = bytes[8] | (bytes[9] << 8);
+        headerStart = 10;
+    } else {
+        if (length < 12) {
+            return false;
+        }
+        headerLength = bytes[8] | (bytes[9] << 8) | (bytes[10] << 16) | ((size_t)bytes[11] << 24);
+        headerStart = 12;
+    }
+    if (headerLength > length - headerStart) {
+        std::cerr << "Truncated NumPy header: " << path << std::endl;
+        return false;
+    }
+    std::string header((const char*)bytes + headerStart, headerLength);
+
+    std::string descr = npyHeaderValue(header, "descr");
+    if (descr != "'<f4'") {
+        std::cerr << "Unsupported NumPy dtype " << descr << " in " << path << " (expected '<f4')" << std::endl;
+        return false;
+    }
+    if (npyHeaderValue(header, "fortran_order") != "False") {
+        std::cerr << "Fortran-ordered arrays are not supported: " << path << std::endl;
+        return false;
+    }
+    int height, width;
+    if (sscanf(npyHeaderValue(header, "shape").c_str(), "(%d, %d)", &height, &width) != 2) {
+        std::cerr << "Expected a 2D array in " << path << std::endl;
+        return false;
+    }
+
+    field->width = width;
+    field->height = height;
+    field->data = (const float*)(bytes + headerStart + headerLength);
+    return true;
+}
+
+
+static bool parseHmf(const unsigned char* bytes, size_t length, MappedField* field, const char* path) {
+    HeatmapFileHeader header;
+    if (length < sizeof(header)) {
+        std::cerr << "Truncated heatmap file: " << path << std::endl;
+        return false;
+    }
+    memcpy(&header, bytes, sizeof(header));
+    if (memcmp(header.magic, "HMF1", 4) != 0 || header.valueType != 0) {
+        std::cerr << "Not a float heatmap file: " << path << std::endl;
+        return false;
+    }
+    // The offset comes from the file: it has to point past the header, at aligned floats,
+    // inside the file (the values after it are checked by the caller)
+    if (header.dataOffset < sizeof(header) || header.dataOffset % sizeof(float) != 0 || header.dataOffset > length) {
+        std::cerr << "Invalid data offset " << header.dataOffset << " in heatmap file: " << path << std::endl;
+        return false;
+    }
+    field->width = (int)header.width;
+    field->height = (int)header.height;
+    field->data = (const float*)(bytes + header.dataOffset);
+    return true;
+}
+
+
+bool openMappedField(const char* path, MappedField* field, bool prefetch, int rawWidth, int rawHeight) {
+    field->fd = -1;
+    field->base = NULL;
+    field->length = 0;
+
+    field->fd = open(path, O_RDONLY);
+    if (field->fd < 0) {
+        std::cerr << "Failed to open field file: " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(field->fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "Field file is empty: " << path << std::endl;
+        closeMappedField(field);
+        return false;
+    }
+    field->length = (size_t)info.st_size;
+
+    // Map the whole file read-only; nothing is read from disk until a page is touched
+    field->base = mmap(NULL, field->length, PROT_READ, MAP_PRIVATE, field->fd, 0);
+    if (field->base == MAP_FAILED) {
+        field->base = NULL;
+        std::cerr << "Failed to map field file: " << path << std::endl;
+        closeMappedField(field);
+        return false;
+    }
+    // The upload walks the file front to back: ask for aggressive read-ahead,
+    // and optionally start reading everything right now in the background
+    madvise(field->base, field->length, MADV_SEQUENTIAL);
+    if (prefetch) {
+        madvise(field->base, field->length, MADV_WILLNEED);
+    }
+
+    const unsigned char* bytes = (const unsigned char*)field->base;
+    bool parsed;
+    if (hasExtension(path, ".npy")) {
+        parsed = parseNpy(bytes, field->length, field, path);
+    } else if (hasExtension(path, ".hmf")) {
+        parsed = parseHmf(bytes, field->length, field, path);
+    } else if (hasExtension(path, ".hmc")) {
+        // The values aren't in the file as floats; loadFieldFrame decodes them
+        std::cerr << "Compressed fields can't be mapped, they have to be decoded: " << path << std::endl;
+        parsed = false;
+    } else {
+        field->width = rawWidth;
+        field->height = rawHeight;
+        field->data = (const float*)bytes;
+        parsed = rawWidth > 0 && rawHeight > 0;
+        if (!parsed) {
+            std::cerr << "Raw field " << path << " needs its size (--size WIDTHxHEIGHT)" << std::endl;
+        }
+    }
+
+    // The data has to be inside the file. The parsers keep the offset within the file, so
+    // comparing with what is left after it can't wrap around the way adding to it could.
+    bool fits = false;
+    if (parsed && field->width > 0 && field->height > 0) {
+        size_t dataOffset = (size_t)((const unsigned char*)field->data - bytes);
+        size_t width = (size_t)field->width, height = (size_t)field->height;
+        fits = dataOffset <= field->length && height <= (SIZE_MAX / sizeof(float)) / width &&
+               width * height * sizeof(float) <= field->length - dataOffset;
+    }
+    if (parsed && !fits) {
+        std::cerr << "Field file is smaller than its " << field->width << "x" << field->height
+                  << " header says: " << path << std::endl;
+        parsed = false;
+    }
+    if (!parsed) {
+        closeMappedField(field);
+        return false;
+    }
+    return true;
+}
+
+
+void closeMappedField(MappedField* field) {
+    if (field->base) {
+        munmap(field->base, field->length);
+        field->base = NULL;
+    }
+    if (field->fd >= 0) {
+        close(field->fd);
+        field->fd = -1;
+    }
+    field->data = NULL;
+}
+
+
+bool writeFieldFile(const char* path, const float* data, int width, int height) {
+    std::vector<unsigned char> compressed;
+    if (hasExtension(path, ".hmc") &&
+        !encodeCompressedField(data, width, height, NULL, defaultFieldEncoding(), &compressed, NULL)) {
+        return false;
+    }
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Failed to create field file: " << path << std::endl;
+        return false;
+    }
+
+    bool ok;
+    if (!compressed.empty()) {
+        // A key frame with the default encoding: lossless floats and LZ4
+        ok = fwrite(compressed.data(), 1, compressed.size(), file) == compressed.size();
+        ok = fclose(file) == 0 && ok;
+        if (!ok) {
+            std::cerr << "Failed to write field file: " << path << std::endl;
+        }
+        return ok;
+    } else if (hasExtension(path, ".npy")) {
+        // Version 1 header, padded with spaces so the data starts on a 64-byte boundary
+        char dict[128];
+        snprintf(dict, sizeof(dict), "{'descr': '<f4', 'fortran_order': False, 'shape': (%d, %d), }", height, width);
+        std::string header = dict;
+        size_t total = 10 + header.size() + 1;
+        header.append((64 - total % 64) % 64, ' ');
+        header += '\n';
+        unsigned char preamble[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                                       (unsigned char)(header.size() & 0xff), (unsigned char)(header.size() >> 8) };
+        ok = fwrite(preamble, 1, sizeof(preamble), file) == sizeof(preamble)
+          && fwrite(header.data(), 1, header.size(), file) == header.size();
+    } else {
+        HeatmapFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "HMF1", 4);
+        header.width = (uint32_t)width;
+        header.height = (uint32_t)height;
+        header.valueType = 0;
+        header.dataOffset = sizeof(header);
+        ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+
+    size_t count = (size_t)width * (size_t)height;
+    ok = ok && fwrite(data, sizeof(float), count, file) == count;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        std::cerr << "Failed to write field file: " << path << std::endl;
+    }
+    return ok;
+}
@@ -0,0 +1,50 @@
+/*
+    Loading scalar fields from disk.
+
+    Files are memory-mapped instead of read: opening a field only maps it, and the pages are
+    read by the kernel the first time the upload touches them, straight from the page cache
+    into the pixel buffer. No intermediate copy of the whole field is made in our own memory.
+
+    Supported files (all little-endian 32-bit floats, row by row, first row at the bottom):
+      .npy  NumPy arrays with dtype '<f4' and shape (height, width), C order
+      .hmf  Our own format: a 32-byte header (see HeatmapFileHeader) followed by the data
+      .hmc  Compressed fields (see field_codec.h). These can't be mapped as floats and are
+            decoded by loadFieldFrame (frame_cache.h) instead.
+      other Headerless raw floats; the size has to be given by the caller
+*/
+
+#ifndef FIELD_LOADER_H
+#define FIELD_LOADER_H
+
+#include <cstddef>
+#include <stdint.h>
+
+// Header of .hmf files
+struct HeatmapFileHeader {
+    char magic[4];          // "HMF1"
+    uint32_t width;
+    uint32_t height;
+    uint32_t valueType;     // 0 = 32-bit float
+    uint64_t dataOffset;    // Byte offset of the first value from the start of the file
+    uint64_t reserved;
+};
+
+struct MappedField {
+    int fd;
+    void* base;             // Start of the mapping (the whole file)
+    size_t length;
+    const float* data;      // First value of the field inside the mapping
+    int width;
+    int height;
+};
+
+// Map a field file. rawWidth/rawHeight are only used for headerless files.
+// With prefetch the kernel starts reading the whole file in the background right away.
+bool openMappedField(const char* path, MappedField* field, bool prefetch, int rawWidth = 0, int rawHeight = 0);
+
+void closeMappedField(MappedField* field);
+
+// Write a field as .npy, .hmf or .hmc (a lossless key frame), depending on the extension of path
+bool writeFieldFile(const char* path, const float* data, int width, int height);
+
+#endif
@@ -1,16 +1,57 @@
-#version 120
+#version 330 core
 
 // uniform stays constant, don't change between fragments
 // it's used to pass non-changing data from C++ to shaders
+#ifdef HEATMAP_PANELS
+uniform sampler2DArray heatmapTexture; // One layer per panel, see heatmap_panels.h
+flat in float Layer;              // Layer of the panel being drawn
+#else
 uniform sampler2D heatmapTexture; // The texture containing the scalar field
-varying vec2 TexCoord;            // Texture coordinates from the vertex shader
+#endif
+uniform sampler1D colormapTexture; // Lookup table from scalar to color, see colormap.h
+uniform float colormapSize;       // Number of entries in the lookup table
+uniform sampler2D valueRange;     // Texel (0, 0) holds the field's (min, max), see value_range.h
+uniform float isolineCount = 0.0; // Isolines at 1/(N+1), ..., N/(N+1) of the value range, 0 = none
+uniform float isolineWidth = 1.0; // Their width in pixels
+in vec2 TexCoord;                 // Texture coordinates from the vertex shader
 
-// Convert scalar value to color (heatmap: blue to red)
+out vec4 FragColor;               // Color of the pixel
+
+// Convert scalar value to color by looking it up in the colormap
 vec4 scalarToColor(float value) {
-    return vec4(value, 0.0, 1.0 - value, 1.0); // Blue to red gradient
+    // Map [0, 1] onto the centers of the first and last entry, so both ends get their exact color
+    float coordinate = (clamp(value, 0.0, 1.0) * (colormapSize - 1.0) + 0.5) / colormapSize;
+    return texture(colormapTexture, coordinate);
+}
+
+// How much of this pixel an isoline covers, from 0 to 1. fwidth tells how much the scaled value
+// changes from one pixel to the next, which turns the distance to the nearest level into pixels:
+// the lines stay isolineWidth wide at any zoom, however steep or flat the field, and cost a
+// handful of instructions in the pass that colors the pixel anyway.
+float isolineCoverage(float normalized) {
+    float scaled = normalized * (isolineCount + 1.0);
+    float pixels = abs(fract(scaled + 0.5) - 0.5) / max(fwidth(scaled), 1e-6);
+    float coverage = 1.0 - smoothstep(0.5 * isolineWidth - 0.5, 0.5 * isolineWidth + 0.5, pixels);
+    // The ends of the range are no levels: only the values beyond them would round to them
+    return scaled > 0.5 && scaled < isolineCount + 0.5 ? coverage : 0.0;
 }
 
 void main() {
-    float scalarValue = texture2D(heatmapTexture, TexCoord).r; // Sample scalar value from texture
-    gl_FragColor = scalarToColor(scalarValue); // Map scalar to color
+#ifdef HEATMAP_PANELS
+    float scalarValue = texture(heatmapTexture, vec3(TexCoord, Layer)).r; // Sample this panel's layer
+#else
+    float scalarValue = texture(heatmapTexture, TexCoord).r; // Sample scalar value from texture
+#endif
+    vec2 range = texelFetch(valueRange, ivec2(0, 0), 0).rg; // Current min and max of the field
+    float normalized = (scalarValue - range.x) / max(range.y - range.x, 1e-30); // Stretch to [0, 1]
+    // fwidth compares this pixel with its neighbours, so they all have to get this far: no
+    // branch or discard before it. With isolineCount 0 the coverage is 0 anyway.
+    float isolines = isolineCoverage(normalized);
+    FragColor = scalarToColor(normalized); // Map scalar to color
+    FragColor.rgb = mix(FragColor.rgb, vec3(0.0), 0.75 * isolines); // Darken the lines
+#ifndef HEATMAP_PANELS
+    if (any(lessThan(TexCoord, vec2(0.0))) || any(greaterThan(TexCoord, vec2(1.0)))) {
+        discard; // Zoomed out or panned past the edge: no field here, keep the background
+    }
+#endif
 }
\ No newline at end of file
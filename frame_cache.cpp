@@ -0,0 +1,303 @@
+#include "frame_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "field_codec.h"
+#include "field_loader.h"
+
+
+bool isCompressedFieldFile(const std::string& path) {
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".hmc") == 0;
+}
+
+
+bool loadFieldFrame(const std::string& path, int rawWidth, int rawHeight, CachedFrame* frame,
+                    const CachedFrame* reference, ThreadPool* pool) {
+    if (isCompressedFieldFile(path)) {
+        CompressedFieldHeader header;
+        if (!readCompressedFieldFileHeader(path.c_str(), &header)) {
+            std::cerr << "Not a compressed field file: " << path << std::endl;
+            return false;
+        }
+        if (header.delta && (!reference || reference->width != (int)header.width ||
+                             reference->height != (int)header.height)) {
+            std::cerr << path << " is a delta frame and needs the frame before it" << std::endl;
+            return false;
+        }
+        frame->width = (int)header.width;
+        frame->height = (int)header.height;
+        frame->data.resize((size_t)header.width * header.height);
+        return decodeCompressedFieldFile(path.c_str(), header.delta ? reference->data.data() : NULL,
+                                         frame->data.data(), pool);
+    }
+    MappedField mapped;
+    if (!openMappedField(path.c_str(), &mapped, true, rawWidth, rawHeight)) {
+        return false;
+    }
+    frame->width = mapped.width;
+    frame->height = mapped.height;
+    frame->data.resize((size_t)mapped.width * (size_t)mapped.height);
+    memcpy(frame->data.data(), mapped.data, frame->data.size() * sizeof(float));
+    closeMappedField(&mapped);
+    return true;
+}
+
+
+bool isDeltaFieldFile(const std::string& path) {
+    CompressedFieldHeader header;
+    return isCompressedFieldFile(path) && readCompressedFieldFileHeader(path.c_str(), &header) && header.delta;
+}
+
+
+bool openFieldFile(const std::string& path, MappedField* field, CachedFrame* decoded, bool prefetch,
+                   int rawWidth, int rawHeight, ThreadPool* pool) {
+    if (!isCompressedFieldFile(path)) {
+        return openMappedField(path.c_str(), field, prefetch, rawWidth, rawHeight);
+    }
+    if (!loadFieldFrame(path, rawWidth, rawHeight, decoded, NULL, pool)) {
+        return false;
+    }
+    // Nothing mapped: closeMappedField only forgets the pointer
+    field->fd = -1;
+    field->base = NULL;
+    field->length = 0;
+    field->data = decoded->data.data();
+    field->width = decoded->width;
+    field->height = decoded->height;
+    return true;
+}
+
+
+bool listFrameSequence(const char* path, std::vector<std::string>* paths) {
+    paths->clear();
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        std::cerr << "Failed to open frame sequence: " << path << std::endl;
+        return false;
+    }
+    if (S_ISDIR(info.st_mode)) {
+        DIR* directory = opendir(path);
+        if (!directory) {
+            std::cerr << "Failed to read directory: " << path << std::endl;
+            return false;
+        }
+        std::string prefix = std::string(path) + "/";
+        while (struct dirent* entry = readdir(directory)) {
+            std::string file = prefix + entry->d_name;
+            if (entry->d_name[0] != '.' && stat(file.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                paths->push_back(file);
+            }
+        }
+        closedir(directory);
+        // Recorders number their frames; zero-padded names sort in time order
+        std::sort(paths->begin(), paths->end());
+    } else {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            size_t begin = line.find_first_not_of(" \t\r");
+            if (begin != std::string::npos) {
+                paths->push_back(line.substr(begin, line.find_last_not_of(" \t\r") + 1 - begin));
+            }
+        }
+    }
+    if (paths->empty()) {
+        std::cerr << "No frames in " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+FrameCache::FrameCache() : width(0), height(0), capacityFrames(0), stopping(false) {
+}
+
+
+FrameCache::~FrameCache() {
+    stop();
+}
+
+
+bool FrameCache::start(const std::vector<std::string>& framePaths, int frameWidth, int frameHeight,
+                       size_t budgetBytes, unsigned loadThreads, const std::function<void()>& callback) {
+    stop();
+    paths = framePaths;
+    width = frameWidth;
+    height = frameHeight;
+    onLoaded = callback;
+    size_t frameBytes = (size_t)width * (size_t)height * sizeof(float);
+    capacityFrames = (int)std::min(budgetBytes / frameBytes, paths.size());
+    if (capacityFrames < 2) {
+        std::cerr << "The frame cache budget holds fewer than two " << width << "x" << height << " frames" << std::endl;
+        return false;
+    }
+    if (loadThreads == 0) {
+        // Loading is mostly waiting for the disk; a few requests in flight keep it busy
+        loadThreads = std::min(4u, std::max(1u, std::thread::hardware_concurrency() / 2));
+    }
+    stopping = false;
+    decodePool.reset(new ThreadPool());
+    for (unsigned i = 0; i < loadThreads; ++i) {
+        threads.push_back(std::thread(&FrameCache::run, this));
+    }
+    return true;
+}
+
+
+void FrameCache::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    threads.clear();
+    decodePool.reset();
+    entries.clear();
+    lru.clear();
+    wanted.clear();
+    loading.clear();
+    failed.clear();
+}
+
+
+void FrameCache::touch(Entry* entry, int frame) {
+    lru.erase(entry->lruPosition);
+    lru.push_front(frame);
+    entry->lruPosition = lru.begin();
+}
+
+
+void FrameCache::insert(int frame, const std::shared_ptr<const CachedFrame>& loaded) {
+    std::unordered_map<int, Entry>::iterator it = entries.find(frame);
+    if (it != entries.end()) {
+        // Another thread decoded it on its way to a later frame
+        touch(&it->second, frame);
+        return;
+    }
+    // New frames go to the front, so eviction takes from the back
+    lru.push_front(frame);
+    Entry entry = { loaded, lru.begin() };
+    entries[frame] = entry;
+    while ((int)entries.size() > capacityFrames) {
+        entries.erase(lru.back());
+        lru.pop_back();
+    }
+}
+
+
+void FrameCache::setPlayhead(int frame, int direction, int count, int step) {
+    int frames = (int)paths.size();
+    // Never ask for more than fits, or the window would evict its own beginning
+    count = std::min(std::min(count, capacityFrames - 1), frames);
+    step = std::max(step, 1);
+    std::lock_guard<std::mutex> lock(mutex);
+    wanted.clear();
+    std::vector<int> window;
+    for (int i = 0; i < count; ++i) {
+        int wantedFrame = ((frame + direction * i * step) % frames + frames) % frames;
+        window.push_back(wantedFrame);
+        if (!entries.count(wantedFrame) && !loading.count(wantedFrame) && !failed.count(wantedFrame)) {
+            wanted.push_back(wantedFrame);
+        }
+    }
+    // Mark the cached part of the window as used, farthest first, so the frames the playhead
+    // reaches next are the last ones to be evicted
+    for (size_t i = window.size(); i-- > 0;) {
+        std::unordered_map<int, Entry>::iterator it = entries.find(window[i]);
+        if (it != entries.end()) {
+            touch(&it->second, window[i]);
+        }
+    }
+    if (!wanted.empty()) {
+        wake.notify_all();
+    }
+}
+
+
+std::shared_ptr<const CachedFrame> FrameCache::get(int frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<int, Entry>::iterator it = entries.find(frame);
+    if (it == entries.end()) {
+        return std::shared_ptr<const CachedFrame>();
+    }
+    touch(&it->second, frame);
+    return it->second.frame;
+}
+
+
+size_t FrameCache::cachedFrames() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+
+void FrameCache::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || !wanted.empty(); });
+        if (stopping) {
+            return;
+        }
+        int frame = wanted.front();
+        wanted.erase(wanted.begin());
+        loading.insert(frame);
+
+        // Delta frames are decoded on top of the frame before them: go back to the nearest
+        // frame that is cached or self-contained. Reading the headers needs no lock.
+        lock.unlock();
+        std::vector<int> chain(1, frame);
+        std::shared_ptr<const CachedFrame> reference;
+        while (chain.back() > 0 && isDeltaFieldFile(paths[chain.back()])) {
+            {
+                std::lock_guard<std::mutex> chainLock(mutex);
+                std::unordered_map<int, Entry>::iterator it = entries.find(chain.back() - 1);
+                if (it != entries.end()) {
+                    reference = it->second.frame;
+                    break;
+                }
+            }
+            chain.push_back(chain.back() - 1);
+        }
+
+        // The disk reads and the decoding happen without the lock
+        bool ok = true;
+        std::vector<std::shared_ptr<const CachedFrame> > decoded;
+        for (size_t i = chain.size(); i-- > 0 && ok;) {
+            std::shared_ptr<CachedFrame> loaded(new CachedFrame());
+            ok = loadFieldFrame(paths[chain[i]], width, height, loaded.get(), reference.get(), decodePool.get());
+            if (ok && (loaded->width != width || loaded->height != height)) {
+                std::cerr << paths[chain[i]] << " is " << loaded->width << "x" << loaded->height << ", not " << width
+                          << "x" << height << " like the rest of the sequence" << std::endl;
+                ok = false;
+            }
+            reference = loaded;
+            decoded.push_back(reference);
+        }
+        lock.lock();
+
+        loading.erase(frame);
+        if (!ok) {
+            failed.insert(frame);
+            continue;
+        }
+        // The frames decoded on the way are kept too; the requested one ends up most recent
+        for (size_t i = 0; i < decoded.size(); ++i) {
+            insert(chain[chain.size() - 1 - i], decoded[i]);
+        }
+        if (onLoaded) {
+            lock.unlock();
+            onLoaded();
+            lock.lock();
+        }
+    }
+}
@@ -0,0 +1,123 @@
+/*
+    A RAM cache of the frames of a recorded sequence, filled ahead of the playhead.
+
+    A recorded run is a list of field files (see field_loader.h), one per time step. Reading
+    one from disk takes far longer than showing it, so playback never reads on the render
+    thread: it tells the cache where the playhead is and which way it moves, and a few
+    background threads load the frames in front of it into blocks of the field buffer pool.
+    The render thread only ever takes what is already in memory.
+
+    The cache holds at most budgetBytes of frames and evicts the least recently used ones,
+    so frames just behind the playhead stay around for scrubbing back, while a jump to a
+    far part of the run drops the old window.
+
+    Compressed delta frames can only be decoded on top of the frame before them. When that
+    isn't cached, the loading thread walks back to the nearest frame that is (or to a key
+    frame) and decodes forward from there, keeping every frame on the way: going backwards
+    through a delta-coded run decodes a group of frames at once, like a video player.
+*/
+
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "field_buffer_pool.h"
+#include "field_loader.h"
+#include "thread_pool.h"
+
+struct CachedFrame {
+    int width;
+    int height;
+    FieldBuffer data;       // width * height values, first row at the bottom
+};
+
+// Read a whole field file into frame->data. rawWidth/rawHeight are used for headerless files.
+// Compressed .hmc files (field_codec.h) are decoded on the pool; a delta frame needs the
+// frame before it as reference.
+bool loadFieldFrame(const std::string& path, int rawWidth, int rawHeight, CachedFrame* frame,
+                    const CachedFrame* reference = NULL, ThreadPool* pool = NULL);
+
+// true for .hmc files, which have to be decoded instead of mapped
+bool isCompressedFieldFile(const std::string& path);
+
+// true if path is a compressed delta frame, which can't be decoded without the frame before it
+bool isDeltaFieldFile(const std::string& path);
+
+// Open a field file to show it: map it (see field_loader.h) or, if it is compressed, decode
+// it into decoded. Either way field->data points at the values until closeMappedField.
+bool openFieldFile(const std::string& path, MappedField* field, CachedFrame* decoded, bool prefetch,
+                   int rawWidth, int rawHeight, ThreadPool* pool = NULL);
+
+// The files of a sequence: every regular file of a directory, sorted by name, or the lines of
+// a list file ('#' starts a comment). Returns false if there isn't a single frame.
+bool listFrameSequence(const char* path, std::vector<std::string>* paths);
+
+class FrameCache {
+public:
+    FrameCache();
+    ~FrameCache();
+
+    // Start loadThreads threads (0 picks a few) loading frames of width x height out of paths.
+    // onLoaded (optional) runs on a loading thread after every frame, e.g. to wake the render loop.
+    bool start(const std::vector<std::string>& paths, int width, int height, size_t budgetBytes,
+               unsigned loadThreads, const std::function<void()>& onLoaded);
+    void stop();
+
+    // Load frame, then count frames in the given direction (+1 or -1, wrapping around the
+    // end), every step-th one. Replaces the previous request: frames that haven't started
+    // loading yet and aren't wanted any more are forgotten.
+    void setPlayhead(int frame, int direction, int count, int step);
+
+    // The frame if it is in memory, NULL otherwise. The frame stays valid while the caller
+    // holds on to it, even if the cache evicts it meanwhile.
+    std::shared_ptr<const CachedFrame> get(int frame);
+
+    // How many frames fit into the budget
+    int capacity() const { return capacityFrames; }
+    int frameCount() const { return (int)paths.size(); }
+    size_t cachedFrames() const;
+
+private:
+    FrameCache(const FrameCache&);
+    FrameCache& operator=(const FrameCache&);
+
+    struct Entry {
+        std::shared_ptr<const CachedFrame> frame;
+        std::list<int>::iterator lruPosition;
+    };
+
+    void run();
+    // Called with the mutex held: most recently used at the front
+    void touch(Entry* entry, int frame);
+    void insert(int frame, const std::shared_ptr<const CachedFrame>& loaded);
+
+    std::vector<std::string> paths;
+    int width;
+    int height;
+    int capacityFrames;
+    std::function<void()> onLoaded;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::unordered_map<int, Entry> entries;
+    std::list<int> lru;
+    std::vector<int> wanted;                // Frames to load, most urgent first
+    std::unordered_set<int> loading;        // Frames a thread is loading right now
+    std::unordered_set<int> failed;         // Frames that couldn't be read, not tried again
+    bool stopping;
+    std::vector<std::thread> threads;
+    std::unique_ptr<ThreadPool> decodePool;    // Decodes the chunks of compressed frames in parallel
+};
+
+#endif
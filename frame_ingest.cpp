@@ -0,0 +1,277 @@
+#include "frame_ingest.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "field_codec.h"
+#include "field_loader.h"
+
+// Larger frames are treated as a corrupt stream rather than allocated
+static const uint64_t MAX_INGEST_TEXELS = (uint64_t)1 << 28;
+
+
+FrameIngest::FrameIngest()
+    : spare(NULL), previousWidth(0), previousHeight(0), running(false), dropped(0), sequence(0), listenFd(-1) {
+    stopPipe[0] = stopPipe[1] = -1;
+}
+
+
+FrameIngest::~FrameIngest() {
+    stop();
+}
+
+
+bool FrameIngest::start(int port, const std::function<void()>& callback) {
+    stop();
+    onFrame = callback;
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << "Failed to create the ingest socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((uint16_t)port);
+    if (bind(listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 1) != 0) {
+        std::cerr << "Failed to listen on port " << port << ": " << strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+    if (pipe(stopPipe) != 0) {
+        std::cerr << "Failed to create the ingest pipe" << std::endl;
+        stop();
+        return false;
+    }
+
+    // Every buffer starts out free
+    pool.clear();
+    for (int i = 0; i < FRAME_INGEST_POOL_SIZE; ++i) {
+        pool.push_back(std::unique_ptr<IngestFrame>(new IngestFrame()));
+        recycled.tryPush(pool.back().get());
+    }
+    decodePool.reset(new ThreadPool());
+    running = true;
+    thread = std::thread(&FrameIngest::run, this);
+    return true;
+}
+
+
+void FrameIngest::stop() {
+    if (running) {
+        running = false;
+        char wake = 0;
+        if (write(stopPipe[1], &wake, 1) < 0) {
+            // Nothing else to do: the thread checks running whenever poll returns
+        }
+        thread.join();
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (stopPipe[i] >= 0) {
+            close(stopPipe[i]);
+            stopPipe[i] = -1;
+        }
+    }
+    // The queues only hold pointers into the pool; empty them before the pool goes away
+    IngestFrame* frame;
+    while (ready.tryPop(&frame)) {
+    }
+    while (recycled.tryPop(&frame)) {
+    }
+    spare = NULL;
+    pool.clear();
+    decodePool.reset();
+}
+
+
+IngestFrame* FrameIngest::takeLatest() {
+    IngestFrame* latest = NULL;
+    IngestFrame* frame;
+    while (ready.tryPop(&frame)) {
+        if (latest) {
+            // A newer frame arrived before this one was shown
+            release(latest);
+            ++dropped;
+        }
+        latest = frame;
+    }
+    return latest;
+}
+
+
+void FrameIngest::release(IngestFrame* frame) {
+    // There are fewer buffers than slots, so this never fails
+    recycled.tryPush(frame);
+}
+
+
+// Wait until the connection (or the stop pipe) is readable, then read; false on EOF, errors or stop
+bool FrameIngest::readFully(int connection, void* buffer, size_t bytes) {
+    char* out = (char*)buffer;
+    while (bytes > 0) {
+        struct pollfd fds[2] = { { connection, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (!running || (fds[1].revents & POLLIN)) {
+            return false;
+        }
+        ssize_t received = recv(connection, out, bytes, 0);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        out += received;
+        bytes -= (size_t)received;
+    }
+    return true;
+}
+
+
+// Read the rest of a compressed frame whose first startBytes are already in start, and decode
+// it into destination. false only if the stream is broken; a frame that can't be decoded
+// leaves *width at 0.
+bool FrameIngest::readCompressedFrame(int connection, const void* start, size_t startBytes,
+                                      FieldBuffer* destination, int* width, int* height) {
+    CompressedFieldHeader header;
+    memcpy(&header, start, startBytes);
+    if (!readFully(connection, (char*)&header + startBytes, sizeof(header) - startBytes)) {
+        return false;
+    }
+    uint64_t texels = (uint64_t)header.width * header.height;
+    if (!readCompressedFieldHeader((const unsigned char*)&header, sizeof(header), &header) ||
+        texels > MAX_INGEST_TEXELS || header.dataBytes > texels * sizeof(float) * 2 + 65536) {
+        std::cerr << "Ingest: not a valid compressed frame, closing the connection" << std::endl;
+        return false;
+    }
+    compressed.resize(sizeof(header) + (size_t)header.dataBytes);
+    memcpy(&compressed[0], &header, sizeof(header));
+    if (!readFully(connection, &compressed[sizeof(header)], (size_t)header.dataBytes)) {
+        return false;
+    }
+
+    // Decode in place over the previous frame, then copy it out: the next delta frame
+    // needs it even if this one is dropped
+    *width = 0;
+    if (header.delta && (previousWidth != (int)header.width || previousHeight != (int)header.height)) {
+        std::cerr << "Ingest: delta frame without the frame before it, skipped" << std::endl;
+        return true;
+    }
+    previous.resize((size_t)texels);
+    if (!decodeCompressedField(&compressed[0], compressed.size(), previous.data(), previous.data(),
+                               decodePool.get())) {
+        previousWidth = previousHeight = 0;
+        return true;
+    }
+    previousWidth = *width = (int)header.width;
+    previousHeight = *height = (int)header.height;
+    destination->resize((size_t)texels);
+    memcpy(destination->data(), previous.data(), (size_t)texels * sizeof(float));
+    return true;
+}
+
+
+bool FrameIngest::readFrame(int connection) {
+    HeatmapFileHeader header;
+    if (!readFully(connection, &header, sizeof(header))) {
+        return false;
+    }
+
+    // No free buffer means the render thread is behind: read the frame anyway, so the stream
+    // stays in sync, but throw it away. A buffer taken for a frame that didn't arrive
+    // completely is kept for the next one.
+    if (!spare) {
+        recycled.tryPop(&spare);
+    }
+    FieldBuffer* destination = spare ? &spare->data : &discard;
+    int width, height;
+    if (memcmp(header.magic, "HMC1", 4) == 0) {
+        if (!readCompressedFrame(connection, &header, sizeof(header), destination, &width, &height)) {
+            return false;
+        }
+        if (width == 0) {
+            return true;
+        }
+    } else {
+        uint64_t texels = (uint64_t)header.width * header.height;
+        if (memcmp(header.magic, "HMF1", 4) != 0 || header.valueType != 0 || texels == 0 ||
+            texels > MAX_INGEST_TEXELS || header.dataOffset < sizeof(header)) {
+            std::cerr << "Ingest: not a float .hmf frame, closing the connection" << std::endl;
+            return false;
+        }
+        // Skip whatever lies between the header and the data
+        for (uint64_t skip = header.dataOffset - sizeof(header); skip > 0;) {
+            char padding[256];
+            size_t chunk = skip < sizeof(padding) ? (size_t)skip : sizeof(padding);
+            if (!readFully(connection, padding, chunk)) {
+                return false;
+            }
+            skip -= chunk;
+        }
+        destination->resize((size_t)texels);
+        if (!readFully(connection, destination->data(), (size_t)texels * sizeof(float))) {
+            return false;
+        }
+        width = (int)header.width;
+        height = (int)header.height;
+        // Delta frames are relative to the previous compressed frame only
+        previousWidth = previousHeight = 0;
+    }
+    ++sequence;
+    if (!spare) {
+        ++dropped;
+        return true;
+    }
+    IngestFrame* frame = spare;
+    spare = NULL;
+    frame->width = width;
+    frame->height = height;
+    frame->sequence = sequence;
+    ready.tryPush(frame);
+    if (onFrame) {
+        onFrame();
+    }
+    return true;
+}
+
+
+void FrameIngest::run() {
+    while (running) {
+        struct pollfd fds[2] = { { listenFd, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) <= 0 || (fds[1].revents & POLLIN)) {
+            continue;
+        }
+        int connection = accept(listenFd, NULL, NULL);
+        if (connection < 0) {
+            continue;
+        }
+        std::cout << "Ingest: solver connected" << std::endl;
+        previousWidth = previousHeight = 0;
+        while (readFrame(connection)) {
+        }
+        close(connection);
+        if (running) {
+            std::cout << "Ingest: solver disconnected" << std::endl;
+        }
+    }
+}
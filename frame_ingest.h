@@ -0,0 +1,91 @@
+/*
+    Receiving fields from a remote solver over TCP.
+
+    A background thread listens on a port and reads frames from one connection at a time.
+    Every frame is a .hmf file as described in field_loader.h: the 32-byte HeatmapFileHeader
+    followed by width * height little-endian floats, so sending a set of .hmf files back to
+    back (e.g. with netcat) is a valid stream. Compressed frames (field_codec.h) work the
+    same way: a delta frame is decoded against the frame before it on the same connection,
+    so the solver only sends what changed.
+
+    Frames are decoded into a small pool of buffers (blocks of the shared FieldBufferPool,
+    so a new size doesn't fault in fresh memory) and handed to the render thread through a
+    lock-free single-producer single-consumer queue; a second queue brings the buffers back.
+    Nothing ever waits for the render thread: the render loop only shows the newest frame
+    and recycles the older ones, and while it holds every buffer new frames are read and
+    dropped. The picture on screen is therefore never more than a couple of frames behind
+    the solver, however fast it sends.
+*/
+
+#ifndef FRAME_INGEST_H
+#define FRAME_INGEST_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "field_buffer_pool.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
+
+// Buffers in the pool: one being filled, one on screen, the rest waiting
+const int FRAME_INGEST_POOL_SIZE = 4;
+
+struct IngestFrame {
+    int width;
+    int height;
+    uint64_t sequence;          // Counts the frames received, dropped ones included
+    FieldBuffer data;           // width * height values, first row at the bottom
+};
+
+class FrameIngest {
+public:
+    FrameIngest();
+    ~FrameIngest();
+
+    // Listen on port (all interfaces) and start the receiving thread. onFrame (optional)
+    // runs on that thread after every frame, e.g. to wake up a render loop waiting for events.
+    bool start(int port, const std::function<void()>& onFrame);
+    void stop();
+
+    // The newest frame received since the last call, or NULL. Older frames are dropped.
+    // The render thread owns the frame until it passes it to release.
+    IngestFrame* takeLatest();
+    void release(IngestFrame* frame);
+
+    // Frames that were received but never shown
+    uint64_t droppedFrames() const { return dropped; }
+
+private:
+    FrameIngest(const FrameIngest&);
+    FrameIngest& operator=(const FrameIngest&);
+
+    void run();
+    bool readFrame(int connection);
+    bool readCompressedFrame(int connection, const void* start, size_t startBytes, FieldBuffer* destination,
+                             int* width, int* height);
+    bool readFully(int connection, void* buffer, size_t bytes);
+
+    std::vector<std::unique_ptr<IngestFrame> > pool;
+    SpscQueue<IngestFrame*, 8> ready;       // Receiving thread -> render thread
+    SpscQueue<IngestFrame*, 8> recycled;    // Render thread -> receiving thread
+    IngestFrame* spare;                     // Free buffer held by the receiving thread
+    FieldBuffer discard;                    // Where frames go that find no free buffer
+    std::vector<unsigned char> compressed;  // The compressed frame being read
+    FieldBuffer previous;                   // The last decoded frame, reference for the next delta frame
+    int previousWidth;
+    int previousHeight;                     // 0 until the connection sent a frame
+    std::unique_ptr<ThreadPool> decodePool;
+    std::function<void()> onFrame;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> dropped;
+    uint64_t sequence;
+    int listenFd;
+    int stopPipe[2];                        // Wakes the receiving thread up when stopping
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+
+static const char* gpuSectionName(int section) {
+    switch (section) {
+    case GPU_SECTION_UPLOAD: return "upload";
+    case GPU_SECTION_DRAW: return "draw";
+    case GPU_SECTION_SWAP: return "swap";
+    }
+    return "unknown";
+}
+
+
+bool createFrameStats(FrameStats* stats, const char* csvPath) {
+    // GL_TIME_ELAPSED is core in 3.3
+    stats->gpuTimers = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (stats->gpuTimers) {
+        glGenQueries(FRAME_STATS_LATENCY * GPU_SECTION_COUNT, &stats->queries[0][0]);
+    }
+    for (int i = 0; i < FRAME_STATS_LATENCY; ++i) {
+        for (int j = 0; j < GPU_SECTION_COUNT; ++j) {
+            stats->issued[i][j] = false;
+        }
+    }
+    stats->slot = 0;
+    stats->sectionOpen = false;
+    stats->frame = -1;
+    stats->frameStart = -1.0;
+    stats->recentNext = 0;
+    stats->csv = NULL;
+
+    if (csvPath) {
+        stats->csv = fopen(csvPath, "w");
+        if (!stats->csv) {
+            std::cerr << "Failed to create stats file: " << csvPath << std::endl;
+            return false;
+        }
+        fprintf(stats->csv, "frame,frame_busy_ms,generate_ms");
+        for (int j = 0; j < GPU_SECTION_COUNT; ++j) {
+            fprintf(stats->csv, ",gpu_%s_ms", gpuSectionName(j));
+        }
+        fprintf(stats->csv, "\n");
+    }
+    return true;
+}
+
+
+// A frame has all the times it is ever going to get: log it and add it to the window
+static void completeSample(FrameStats* stats, const FrameSample& sample) {
+    if (stats->csv) {
+        fprintf(stats->csv, "%lld,%.3f,%.3f", sample.frame, sample.frameMs, sample.generateMs);
+        for (int j = 0; j < GPU_SECTION_COUNT; ++j) {
+            if (sample.gpuMs[j] >= 0.0) {
+                fprintf(stats->csv, ",%.3f", sample.gpuMs[j]);
+            } else {
+                fprintf(stats->csv, ",");
+            }
+        }
+        fprintf(stats->csv, "\n");
+    }
+    if (sample.frameMs < 0.0) {
+        return; // The frame never ended (the last one, when stopping)
+    }
+    if (stats->recent.size() < (size_t)FRAME_STATS_WINDOW) {
+        stats->recent.push_back(sample);
+    } else {
+        stats->recent[stats->recentNext] = sample;
+        stats->recentNext = (stats->recentNext + 1) % FRAME_STATS_WINDOW;
+    }
+}
+
+
+void beginFrameStats(FrameStats* stats, double now) {
+    ++stats->frame;
+    stats->slot = (int)(stats->frame % FRAME_STATS_LATENCY);
+
+    // This query set was last used FRAME_STATS_LATENCY frames ago, by the oldest pending frame.
+    // Read what has arrived without waiting; whatever hasn't is dropped.
+    if (stats->pending.size() >= (size_t)FRAME_STATS_LATENCY) {
+        FrameSample sample = stats->pending.front();
+        stats->pending.pop_front();
+        for (int j = 0; j < GPU_SECTION_COUNT; ++j) {
+            if (!stats->issued[stats->slot][j]) {
+                continue;
+            }
+            GLint available = 0;
+            glGetQueryObjectiv(stats->queries[stats->slot][j], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(stats->queries[stats->slot][j], GL_QUERY_RESULT, &nanoseconds);
+                sample.gpuMs[j] = (double)nanoseconds / 1e6;
+            }
+        }
+        completeSample(stats, sample);
+    }
+    for (int j = 0; j < GPU_SECTION_COUNT; ++j) {
+        stats->issued[stats->slot][j] = false;
+    }
+
+    FrameSample sample;
+    sample.frame = stats->frame;
+    sample.frameMs = -1.0;
+    sample.generateMs = 0.0;
+    for (int j = 0; j < GPU_SECTION_COUNT; ++j) {
+        sample.gpuMs[j] = -1.0;
+    }
+    stats->pending.push_back(sample);
+    stats->frameStart = now;
+}
+
+
+void endFrameStats(FrameStats* stats, double now) {
+    if (!stats->pending.empty() && stats->frameStart >= 0.0) {
+        stats->pending.back().frameMs = (now - stats->frameStart) * 1000.0;
+    }
+}
+
+
+void beginGpuSection(FrameStats* stats, GpuSection section) {
+    if (!stats->gpuTimers || stats->sectionOpen) {
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, stats->queries[stats->slot][section]);
+    stats->issued[stats->slot][section] = true;
+    stats->sectionOpen = true;
+}
+
+
+void endGpuSection(FrameStats* stats) {
+    if (stats->sectionOpen) {
+        glEndQuery(GL_TIME_ELAPSED);
+        stats->sectionOpen = false;
+    }
+}
+
+
+void addGenerateTime(FrameStats* stats, double milliseconds) {
+    if (!stats->pending.empty()) {
+        stats->pending.back().generateMs += milliseconds;
+    }
+}
+
+
+double frameTimePercentile(const FrameStats* stats, double percentile) {
+    if (stats->recent.empty()) {
+        return -1.0;
+    }
+    std::vector<double> times;
+    times.reserve(stats->recent.size());
+    for (size_t i = 0; i < stats->recent.size(); ++i) {
+        times.push_back(stats->recent[i].frameMs);
+    }
+    size_t index = (size_t)(percentile / 100.0 * (times.size() - 1) + 0.5);
+    std::nth_element(times.begin(), times.begin() + index, times.end());
+    return times[index];
+}
+
+
+std::string frameStatsSummary(const FrameStats* stats) {
+    std::ostringstream text;
+    text.setf(std::ios::fixed);
+    text.precision(2);
+    double p50 = frameTimePercentile(stats, 50.0), p99 = frameTimePercentile(stats, 99.0);
+    if (p50 < 0.0) {
+        return "collecting frame times...";
+    }
+    // Busy time only: from the start of the update to the end of the swap, without the idle
+    // time an on-demand loop spends waiting for events in between
+    text << "frame busy p50 " << p50 << " ms, p99 " << p99 << " ms";
+
+    // Average of the measured samples; sections that were never measured are left out
+    double generate = 0.0;
+    for (size_t i = 0; i < stats->recent.size(); ++i) {
+        generate += stats->recent[i].generateMs;
+    }
+    text << " | generate " << generate / stats->recent.size() << " ms";
+    for (int j = 0; j < GPU_SECTION_COUNT; ++j) {
+        double sum = 0.0;
+        int count = 0;
+        for (size_t i = 0; i < stats->recent.size(); ++i) {
+            if (stats->recent[i].gpuMs[j] >= 0.0) {
+                sum += stats->recent[i].gpuMs[j];
+                ++count;
+            }
+        }
+        if (count > 0) {
+            text << " | gpu " << gpuSectionName(j) << " " << sum / count << " ms";
+        }
+    }
+    return text.str();
+}
+
+
+void destroyFrameStats(FrameStats* stats) {
+    endGpuSection(stats);
+    // The last few frames never get their GPU times; log them without
+    while (!stats->pending.empty()) {
+        completeSample(stats, stats->pending.front());
+        stats->pending.pop_front();
+    }
+    if (stats->gpuTimers) {
+        glDeleteQueries(FRAME_STATS_LATENCY * GPU_SECTION_COUNT, &stats->queries[0][0]);
+    }
+    if (stats->csv) {
+        fclose(stats->csv);
+        stats->csv = NULL;
+    }
+}
@@ -0,0 +1,83 @@
+/*
+    Frame timing: CPU timers and GPU timer queries, with p50/p99 summaries and a CSV log.
+
+    GPU times come from GL_TIME_ELAPSED queries around the upload, draw and swap sections of
+    a frame. Reading a query result right away would wait for the GPU to catch up, so every
+    frame uses its own set of queries from a ring of FRAME_STATS_LATENCY sets, and a frame's
+    results are only read when its set comes around again. If they still aren't ready then,
+    the frame simply goes without GPU times; the loop never waits for them.
+
+    Because of that a frame is complete (and written to the CSV file) a few frames late.
+*/
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <GL/glew.h>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Frames in flight before a frame's GPU queries are read back
+const int FRAME_STATS_LATENCY = 3;
+
+enum GpuSection {
+    GPU_SECTION_UPLOAD,     // Everything that changes the field: uploads, generation, reductions
+    GPU_SECTION_DRAW,
+    GPU_SECTION_SWAP,
+    GPU_SECTION_COUNT
+};
+
+// Timings of one frame in milliseconds; negative means not measured
+struct FrameSample {
+    long long frame;
+    double frameMs;         // From beginFrameStats to endFrameStats: the update, draw and swap, not idle time
+    double generateMs;      // CPU time spent producing the field
+    double gpuMs[GPU_SECTION_COUNT];
+};
+
+struct FrameStats {
+    bool gpuTimers;                         // false without timer queries
+    GLuint queries[FRAME_STATS_LATENCY][GPU_SECTION_COUNT];
+    bool issued[FRAME_STATS_LATENCY][GPU_SECTION_COUNT];
+    int slot;                               // Query set of the current frame
+    bool sectionOpen;
+    long long frame;
+    double frameStart;                      // Seconds, from the clock passed to beginFrameStats
+    std::deque<FrameSample> pending;        // Frames still waiting for their GPU times
+    std::vector<FrameSample> recent;        // Same window, complete samples
+    size_t recentNext;
+    FILE* csv;
+};
+
+// Frames the percentiles are computed over
+const int FRAME_STATS_WINDOW = 240;
+
+// csvPath may be NULL; otherwise every completed frame is appended to that file
+bool createFrameStats(FrameStats* stats, const char* csvPath);
+
+// Start a frame at time now (seconds). Also collects the GPU times of the frame that last
+// used this frame's query set.
+void beginFrameStats(FrameStats* stats, double now);
+
+// End the frame at time now, after the swap. Waiting for events until the next frame
+// doesn't count, so the frame times are what a frame costs even when the loop sleeps.
+void endFrameStats(FrameStats* stats, double now);
+
+// Bracket GPU work; sections can't nest
+void beginGpuSection(FrameStats* stats, GpuSection section);
+void endGpuSection(FrameStats* stats);
+
+// Add CPU time spent producing the field during the current frame
+void addGenerateTime(FrameStats* stats, double milliseconds);
+
+// Percentile (0..100) of the frame times in the window, -1 if there are none yet
+double frameTimePercentile(const FrameStats* stats, double percentile);
+
+// One line with p50/p99 frame time and the average GPU section times of the window
+std::string frameStatsSummary(const FrameStats* stats);
+
+void destroyFrameStats(FrameStats* stats);
+
+#endif
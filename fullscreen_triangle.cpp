@@ -0,0 +1,28 @@
+#include "fullscreen_triangle.h"
+
+
+void clearFullscreenTriangle(FullscreenTriangle* triangle) {
+    triangle->vertexArray = 0;
+}
+
+
+void createFullscreenTriangle(FullscreenTriangle* triangle) {
+    glGenVertexArrays(1, &triangle->vertexArray);
+}
+
+
+void drawFullscreenTriangle(FullscreenTriangle* triangle) {
+    GLint previousVertexArray;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+    glBindVertexArray(triangle->vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(previousVertexArray);
+}
+
+
+void destroyFullscreenTriangle(FullscreenTriangle* triangle) {
+    if (triangle->vertexArray) {
+        glDeleteVertexArrays(1, &triangle->vertexArray);
+        triangle->vertexArray = 0;
+    }
+}
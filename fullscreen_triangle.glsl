@@ -0,0 +1,18 @@
+#version 330 core
+
+// Vertex shader without attributes: drawing 3 vertices gives one triangle that covers the
+// whole render target, with the corners at (-1, -1), (3, -1) and (-1, 3).
+// The part outside the screen is clipped away; inside, TexCoord runs from 0 to 1.
+
+out vec2 TexCoord; // Pass this to the fragment shader
+
+// Part of the texture the window shows: xy is its lower left corner, zw its size (see
+// view_transform.h). The default, the whole texture, is what every other pass wants.
+uniform vec4 uView = vec4(0.0, 0.0, 1.0, 1.0);
+
+void main()
+{
+    vec2 position = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+    gl_Position = vec4(position, 0.0, 1.0);
+    TexCoord = uView.xy + (position * 0.5 + 0.5) * uView.zw;
+}
@@ -0,0 +1,32 @@
+/*
+    A single triangle covering the whole render target, for passes that compute one value per
+    texel (generating the field, reducing mipmap levels, drawing an untransformed heatmap)
+    with fullscreen_triangle.glsl.
+
+    The vertex shader makes the positions up from gl_VertexID, so there are no vertex buffers
+    or attributes to set up, only the (empty) vertex array object a core profile requires.
+    One oversized triangle also avoids shading the pixels along the diagonal of a two-triangle
+    quad twice.
+*/
+
+#ifndef FULLSCREEN_TRIANGLE_H
+#define FULLSCREEN_TRIANGLE_H
+
+#include <GL/glew.h>
+
+struct FullscreenTriangle {
+    GLuint vertexArray; // Empty, the vertices come from gl_VertexID
+};
+
+// The state of a triangle that was never created, which destroyFullscreenTriangle accepts
+void clearFullscreenTriangle(FullscreenTriangle* triangle);
+
+void createFullscreenTriangle(FullscreenTriangle* triangle);
+
+// Draw the triangle with the currently bound program.
+// The caller's vertex array binding is left untouched.
+void drawFullscreenTriangle(FullscreenTriangle* triangle);
+
+void destroyFullscreenTriangle(FullscreenTriangle* triangle);
+
+#endif
@@ -0,0 +1,99 @@
+#include "gpu_field_generator.h"
+#include "shader.h"
+
+#include <iostream>
+#include <string>
+
+
+// Work group size declared in ring_compute.glsl
+static const int RING_GROUP_SIZE = 16;
+
+
+bool createGpuFieldGenerator(GpuFieldGenerator* generator, HeatmapFormat format) {
+    generator->format = format;
+    generator->useCompute = GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_image_load_store);
+    generator->framebuffer = 0;
+    generator->triangle.vertexArray = 0;
+
+    if (generator->useCompute) {
+        // The image format qualifier in the shader has to match the texture's format
+        std::string defines = std::string("#define FIELD_FORMAT ") + heatmapImageFormat(format);
+        generator->program = createComputeProgram("ring_compute.glsl", defines.c_str());
+    } else {
+        generator->program = createShaderProgram("fullscreen_triangle.glsl", "ring_fragment.glsl");
+        createFullscreenTriangle(&generator->triangle);
+        glGenFramebuffers(1, &generator->framebuffer);
+    }
+
+    int success;
+    glGetProgramiv(generator->program, GL_LINK_STATUS, &success);
+    if (!success) {
+        std::cerr << "Failed to build the GPU field generator" << std::endl;
+        destroyGpuFieldGenerator(generator);
+        return false;
+    }
+
+    generator->fieldSizeLocation = glGetUniformLocation(generator->program, "fieldSize");
+    generator->scaleLocation = glGetUniformLocation(generator->program, "scale");
+    generator->centerLocation = glGetUniformLocation(generator->program, "center");
+    generator->phaseLocation = glGetUniformLocation(generator->program, "phase");
+    generator->amplitudeLocation = glGetUniformLocation(generator->program, "amplitude");
+    generator->offsetLocation = glGetUniformLocation(generator->program, "offset");
+    return true;
+}
+
+
+void generateRingFieldGPU(GpuFieldGenerator* generator, GLuint texture, int width, int height,
+                          const RingParams& params) {
+    // Leave the caller's program bound when we're done
+    GLint previousProgram;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+    glUseProgram(generator->program);
+    glUniform1f(generator->scaleLocation, params.scale);
+    glUniform2f(generator->centerLocation, params.centerX, params.centerY);
+    glUniform1f(generator->phaseLocation, params.phase);
+    glUniform1f(generator->amplitudeLocation, params.amplitude);
+    glUniform1f(generator->offsetLocation, params.offset);
+
+    if (generator->useCompute) {
+        // Bind level 0 of the texture to image unit 0 and launch one invocation per texel
+        glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, heatmapInternalFormat(generator->format));
+        glDispatchCompute((width + RING_GROUP_SIZE - 1) / RING_GROUP_SIZE,
+                          (height + RING_GROUP_SIZE - 1) / RING_GROUP_SIZE, 1);
+        // Make the image writes visible to the sampler used by the heatmap shader
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    } else {
+        glUniform2f(generator->fieldSizeLocation, (float)width, (float)height);
+
+        // Render into the texture instead of the window, one fragment per texel
+        GLint previousViewport[4];
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, generator->framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Heatmap texture is not renderable on this driver" << std::endl;
+        }
+        glViewport(0, 0, width, height);
+
+        drawFullscreenTriangle(&generator->triangle);
+
+        // Detach the texture so it can be sampled again, and go back to drawing into the window
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+
+    glUseProgram(previousProgram);
+}
+
+
+void destroyGpuFieldGenerator(GpuFieldGenerator* generator) {
+    if (generator->framebuffer) {
+        glDeleteFramebuffers(1, &generator->framebuffer);
+        generator->framebuffer = 0;
+    }
+    destroyFullscreenTriangle(&generator->triangle);
+    glDeleteProgram(generator->program);
+    generator->program = 0;
+}
@@ -0,0 +1,43 @@
+/*
+    Generates the ring field on the GPU, straight into the heatmap texture.
+
+    With GL 4.3 a compute shader (ring_compute.glsl) writes every texel with imageStore.
+    Older contexts draw a fullscreen triangle into a framebuffer object with the texture attached and let
+    a fragment shader (ring_fragment.glsl) compute the value per texel instead.
+    Either way no field data crosses the bus, so changing the parameters is nearly free.
+*/
+
+#ifndef GPU_FIELD_GENERATOR_H
+#define GPU_FIELD_GENERATOR_H
+
+#include <GL/glew.h>
+
+#include "field_generator.h"
+#include "fullscreen_triangle.h"
+#include "texture_format.h"
+
+struct GpuFieldGenerator {
+    bool useCompute;        // Compute shader path (GL 4.3) or render-to-texture fallback
+    HeatmapFormat format;   // Format of the textures this generator writes
+    GLuint program;
+    GLuint framebuffer;     // Fallback only: renders into the heatmap texture
+    FullscreenTriangle triangle; // Fallback only: covers the framebuffer
+    GLint fieldSizeLocation;
+    GLint scaleLocation;
+    GLint centerLocation;
+    GLint phaseLocation;
+    GLint amplitudeLocation;
+    GLint offsetLocation;
+};
+
+// Build the generator program for the current context and for textures of the given format.
+// Returns false if it failed to link.
+bool createGpuFieldGenerator(GpuFieldGenerator* generator, HeatmapFormat format = HEATMAP_FORMAT_R32F);
+
+// Overwrite the width x height texture with the ring pattern described by params
+void generateRingFieldGPU(GpuFieldGenerator* generator, GLuint texture, int width, int height,
+                          const RingParams& params);
+
+void destroyGpuFieldGenerator(GpuFieldGenerator* generator);
+
+#endif
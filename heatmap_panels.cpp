@@ -0,0 +1,138 @@
+#include "heatmap_panels.h"
+
+#include <cmath>
+#include <iostream>
+
+const char* const HEATMAP_PANEL_DEFINES = "#define HEATMAP_PANELS 1";
+
+
+bool createHeatmapPanels(HeatmapPanels* panels, int panelWidth, int panelHeight, int panelCount,
+                         HeatmapFormat format) {
+    panels->texture = 0;
+    panels->instanceBuffer = 0;
+    panels->vertexArray = 0;
+    panels->panelWidth = panelWidth;
+    panels->panelHeight = panelHeight;
+    panels->panelCount = panelCount;
+    panels->format = format;
+
+    GLint maxLayers;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    if (panelCount <= 0 || panelCount > maxLayers) {
+        std::cerr << "Panel count must be between 1 and " << maxLayers << " (GL_MAX_ARRAY_TEXTURE_LAYERS)" << std::endl;
+        return false;
+    }
+    GLint maxSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (panelWidth > maxSize || panelHeight > maxSize) {
+        std::cerr << "Panels can't be larger than GL_MAX_TEXTURE_SIZE (" << maxSize << ")" << std::endl;
+        return false;
+    }
+    panels->packed.resize((size_t)panelWidth * (size_t)panelHeight * heatmapBytesPerTexel(format));
+
+    // One layer per panel, all the same size and format
+    glGenTextures(1, &panels->texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, panels->texture);
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, heatmapInternalFormat(format), panelWidth, panelHeight, panelCount);
+    } else {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, heatmapInternalFormat(format), panelWidth, panelHeight, panelCount,
+                     0, GL_RED, heatmapPixelType(format), NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+    // The transforms are the only vertex attribute, advancing once per instance
+    GLint previousVertexArray, previousArrayBuffer;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previousArrayBuffer);
+    glGenVertexArrays(1, &panels->vertexArray);
+    glGenBuffers(1, &panels->instanceBuffer);
+    glBindVertexArray(panels->vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, panels->instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)panelCount * 4 * sizeof(float), NULL, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glVertexAttribDivisor(0, 1);
+    glBindVertexArray(previousVertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, previousArrayBuffer);
+
+    // Roughly square grid by default
+    layoutHeatmapPanels(panels, (int)std::ceil(std::sqrt((double)panelCount)), 0.05f);
+    return true;
+}
+
+
+void uploadHeatmapPanel(HeatmapPanels* panels, int index, const float* data) {
+    size_t count = (size_t)panels->panelWidth * (size_t)panels->panelHeight;
+    const void* pixels = data;
+    if (panels->format != HEATMAP_FORMAT_R32F) {
+        packHeatmapTexels(data, panels->packed.data(), count, panels->format);
+        pixels = panels->packed.data();
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, panels->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, index, panels->panelWidth, panels->panelHeight, 1,
+                    GL_RED, heatmapPixelType(panels->format), pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+
+void layoutHeatmapPanels(HeatmapPanels* panels, int columns, float gap) {
+    if (columns < 1) {
+        columns = 1;
+    }
+    int rows = (panels->panelCount + columns - 1) / columns;
+    // Size of one grid cell in normalized device coordinates, and of the panel inside it
+    float cellWidth = 2.0f / columns;
+    float cellHeight = 2.0f / rows;
+    float scaleX = cellWidth * (1.0f - gap) * 0.5f;
+    float scaleY = cellHeight * (1.0f - gap) * 0.5f;
+
+    // Panel 0 goes top left, then left to right and top to bottom
+    std::vector<float> transforms((size_t)panels->panelCount * 4);
+    for (int i = 0; i < panels->panelCount; ++i) {
+        int column = i % columns;
+        int row = i / columns;
+        transforms[i * 4 + 0] = scaleX;
+        transforms[i * 4 + 1] = scaleY;
+        transforms[i * 4 + 2] = -1.0f + (column + 0.5f) * cellWidth;
+        transforms[i * 4 + 3] = 1.0f - (row + 0.5f) * cellHeight;
+    }
+
+    GLint previousArrayBuffer;
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previousArrayBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, panels->instanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)(transforms.size() * sizeof(float)), transforms.data());
+    glBindBuffer(GL_ARRAY_BUFFER, previousArrayBuffer);
+}
+
+
+void drawHeatmapPanels(HeatmapPanels* panels) {
+    GLint previousVertexArray;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, panels->texture);
+    glBindVertexArray(panels->vertexArray);
+    // Four corners per panel as a triangle strip, one instance per panel
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, panels->panelCount);
+    glBindVertexArray(previousVertexArray);
+}
+
+
+void destroyHeatmapPanels(HeatmapPanels* panels) {
+    if (panels->vertexArray) {
+        glDeleteVertexArrays(1, &panels->vertexArray);
+        panels->vertexArray = 0;
+    }
+    if (panels->instanceBuffer) {
+        glDeleteBuffers(1, &panels->instanceBuffer);
+        panels->instanceBuffer = 0;
+    }
+    if (panels->texture) {
+        glDeleteTextures(1, &panels->texture);
+        panels->texture = 0;
+    }
+}
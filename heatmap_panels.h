@@ -0,0 +1,52 @@
+/*
+    Many small heatmaps side by side, drawn with a single instanced draw call.
+
+    All panels live in the layers of one GL_TEXTURE_2D_ARRAY and share one program. A small
+    per-instance buffer holds where each panel goes on the screen (the same scale.xy /
+    offset.zw transform vertex_shader.glsl uses for tiles); panel_vertex.glsl makes the
+    corners of each quad up from gl_VertexID and picks the layer from gl_InstanceID. Drawing
+    a thousand panels therefore costs one glDrawArraysInstanced instead of a thousand
+    texture binds and draws.
+
+    The display program for panels is panel_vertex.glsl + fragment_shader.glsl compiled with
+    HEATMAP_PANEL_DEFINES, which switches the fragment shader to the array texture.
+*/
+
+#ifndef HEATMAP_PANELS_H
+#define HEATMAP_PANELS_H
+
+#include <GL/glew.h>
+#include <vector>
+
+#include "texture_format.h"
+
+// Defines for createShaderProgram / beginShaderProgramBuild of the panel display program
+extern const char* const HEATMAP_PANEL_DEFINES;
+
+struct HeatmapPanels {
+    GLuint texture;         // GL_TEXTURE_2D_ARRAY, one layer per panel
+    GLuint instanceBuffer;  // One vec4 transform per panel
+    GLuint vertexArray;     // Instanced attribute 0 = the transform, no per-vertex data
+    int panelWidth;
+    int panelHeight;
+    int panelCount;
+    HeatmapFormat format;
+    std::vector<unsigned char> packed;  // One panel in the texture's format
+};
+
+// Allocate the array texture and lay the panels out in a grid that fills the window
+bool createHeatmapPanels(HeatmapPanels* panels, int panelWidth, int panelHeight, int panelCount,
+                         HeatmapFormat format = HEATMAP_FORMAT_R32F);
+
+// Replace the field of one panel
+void uploadHeatmapPanel(HeatmapPanels* panels, int index, const float* data);
+
+// Arrange the panels in rows of 'columns', leaving gap (a fraction of a cell) between them
+void layoutHeatmapPanels(HeatmapPanels* panels, int columns, float gap);
+
+// Draw every panel with the currently bound panel program, sampling texture unit 0
+void drawHeatmapPanels(HeatmapPanels* panels);
+
+void destroyHeatmapPanels(HeatmapPanels* panels);
+
+#endif
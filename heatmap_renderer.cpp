@@ -0,0 +1,329 @@
+#include "heatmap_renderer.h"
+
+#include <iostream>
+
+
+void setDisplaySamplerUnits(GLuint program) {
+    glUniform1i(glGetUniformLocation(program, "heatmapTexture"), 0);
+    glUniform1i(glGetUniformLocation(program, "colormapTexture"), 1);
+    glUniform1i(glGetUniformLocation(program, "valueRange"), 2);
+    glUniform1f(glGetUniformLocation(program, "colormapSize"), (float)COLORMAP_SIZE);
+}
+
+
+HeatmapRenderer::HeatmapRenderer() {
+    clear();
+}
+
+
+HeatmapRenderer::~HeatmapRenderer() {
+    destroy();
+}
+
+
+HeatmapRenderer::HeatmapRenderer(HeatmapRenderer&& other) {
+    moveFrom(other);
+}
+
+
+HeatmapRenderer& HeatmapRenderer::operator=(HeatmapRenderer&& other) {
+    if (this != &other) {
+        destroy();
+        moveFrom(other);
+    }
+    return *this;
+}
+
+
+// The state of a new renderer: every object name is 0, so there is nothing to free
+void HeatmapRenderer::clear() {
+    clearTextureStream(&stream);
+    clearValueRange(&valueRange);
+    clearColormap(&colormap);
+    clearFullscreenTriangle(&triangle);
+    building = false;
+    fromCache = false;
+    program = 0;
+    viewLocation = isolineCountLocation = isolineWidthLocation = -1;
+    shown = 0;
+    TextureRect all = { 0.0f, 0.0f, 1.0f, 1.0f };
+    view = all;
+    isolineCount = 0.0f;
+    isolineWidth = 1.0f;
+    fixedMin = 0.0f;
+    fixedMax = 1.0f;
+    autoRange = false;
+    rangeChanged = false;
+}
+
+
+// Take over other's objects and leave it empty, so its destructor frees nothing
+void HeatmapRenderer::moveFrom(HeatmapRenderer& other) {
+    stream = other.stream;
+    valueRange = other.valueRange;
+    colormap = other.colormap;
+    triangle = other.triangle;
+    build = other.build;
+    building = other.building;
+    fromCache = other.fromCache;
+    program = other.program;
+    viewLocation = other.viewLocation;
+    isolineCountLocation = other.isolineCountLocation;
+    isolineWidthLocation = other.isolineWidthLocation;
+    shown = other.shown;
+    view = other.view;
+    isolineCount = other.isolineCount;
+    isolineWidth = other.isolineWidth;
+    fixedMin = other.fixedMin;
+    fixedMax = other.fixedMax;
+    autoRange = other.autoRange;
+    rangeChanged = other.rangeChanged;
+    other.clear();
+}
+
+
+bool HeatmapRenderer::create(const HeatmapRendererOptions& options) {
+    destroy();
+    if (options.width <= 0 || options.height <= 0 || options.levels <= 0) {
+        std::cerr << "Invalid heatmap size " << options.width << "x" << options.height << " with "
+                  << options.levels << " levels" << std::endl;
+        return false;
+    }
+    std::vector<float> rgb;
+    if (!builtinColormap(options.colormap, &rgb) && !loadColormapFile(options.colormap.c_str(), &rgb)) {
+        return false;
+    }
+
+    // The driver compiles while the objects below are created and the first field is uploaded
+    beginShaderProgramBuild(&build, options.vertexShader.c_str(), options.fragmentShader.c_str());
+    building = true;
+    if (!createTextureStream(&stream, options.width, options.height, options.format, options.levels) ||
+        !createColormap(&colormap, options.colormap, rgb)) {
+        destroy();
+        return false;
+    }
+    // If the reduction can't be built, the range stays fixed at [0, 1]
+    createValueRange(&valueRange, options.width, options.height);
+    autoRange = valueRange.program != 0;
+    createFullscreenTriangle(&triangle);
+    return true;
+}
+
+
+bool HeatmapRenderer::finishProgram() {
+    if (!building) {
+        return program != 0;
+    }
+    building = false;
+    GLuint linked = finishProgramBuild(&build);
+    fromCache = build.fromCache;
+    if (!build.linked) {
+        std::cerr << "Failed to build the heatmap display program" << std::endl;
+        glDeleteProgram(linked);
+        return false;
+    }
+    useProgram(linked);
+    return true;
+}
+
+
+// Take linked over as the display program: point its samplers at their units and look up
+// the uniforms render() sets
+void HeatmapRenderer::useProgram(GLuint linked) {
+    program = linked;
+    GLint previousProgram;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    glUseProgram(program);
+    setDisplaySamplerUnits(program);
+    viewLocation = glGetUniformLocation(program, "uView");
+    isolineCountLocation = glGetUniformLocation(program, "isolineCount");
+    isolineWidthLocation = glGetUniformLocation(program, "isolineWidth");
+    glUseProgram(previousProgram);
+}
+
+
+void HeatmapRenderer::setProgram(GLuint linked) {
+    // A build still in flight would otherwise finish later and replace this one
+    if (building) {
+        finishProgram();
+    }
+    if (program) {
+        glDeleteProgram(program);
+    }
+    useProgram(linked);
+}
+
+
+void HeatmapRenderer::destroy() {
+    if (building) {
+        glDeleteProgram(finishProgramBuild(&build));
+    }
+    destroyTextureStream(&stream);
+    destroyValueRange(&valueRange);
+    destroyColormap(&colormap);
+    destroyFullscreenTriangle(&triangle);
+    if (program) {
+        glDeleteProgram(program);
+    }
+    clear();
+}
+
+
+bool HeatmapRenderer::resize(int width, int height, int levels) {
+    if (!valid()) {
+        return false;
+    }
+    if (width == stream.width && height == stream.height && levels == stream.levels) {
+        return true;
+    }
+    HeatmapFormat format = stream.format;
+    destroyTextureStream(&stream);
+    if (!createTextureStream(&stream, width, height, format, levels)) {
+        destroy();
+        return false;
+    }
+    // The reduction's textures are sized for the field; a fixed range has to be set again
+    destroyValueRange(&valueRange);
+    bool reducible = createValueRange(&valueRange, width, height);
+    autoRange = autoRange && reducible;
+    if (!autoRange) {
+        setFixedValueRange(&valueRange, fixedMin, fixedMax);
+    }
+    shown = 0;
+    rangeChanged = true;
+    return true;
+}
+
+
+bool HeatmapRenderer::upload(const float* data, ThreadPool* pool) {
+    if (!valid() || !uploadTextureStream(&stream, data, pool)) {
+        return false;
+    }
+    rangeChanged = true;
+    return true;
+}
+
+
+bool HeatmapRenderer::updateRects(const float* data, const std::vector<DirtyRect>& rects, ThreadPool* pool) {
+    if (!valid() || !updateTextureStreamRects(&stream, data, rects, pool)) {
+        return false;
+    }
+    rangeChanged = true;
+    return true;
+}
+
+
+void* HeatmapRenderer::beginUpload() {
+    return valid() ? beginTextureStreamUpload(&stream) : NULL;
+}
+
+
+void HeatmapRenderer::endUpload() {
+    if (!valid()) {
+        return;
+    }
+    endTextureStreamUpload(&stream);
+    rangeChanged = true;
+}
+
+
+void HeatmapRenderer::textureChanged() {
+    rangeChanged = true;
+}
+
+
+void HeatmapRenderer::showTexture(GLuint texture) {
+    shown = texture;
+    rangeChanged = true;
+}
+
+
+void HeatmapRenderer::setValueRange(float minValue, float maxValue) {
+    if (!valid()) {
+        return;
+    }
+    fixedMin = minValue;
+    fixedMax = maxValue;
+    setFixedValueRange(&valueRange, minValue, maxValue);
+    autoRange = false;
+}
+
+
+void HeatmapRenderer::setAutoRange() {
+    if (!valid() || !valueRange.program) {
+        return;
+    }
+    autoRange = true;
+    rangeChanged = true;
+}
+
+
+void HeatmapRenderer::updateValueRange() {
+    // The range is measured once per field, however often it is drawn
+    if (valid() && autoRange && rangeChanged) {
+        reduceValueRange(&valueRange, shownTexture(), stream.width, stream.height);
+        rangeChanged = false;
+    }
+}
+
+
+bool HeatmapRenderer::setColormap(const std::string& name) {
+    if (!valid()) {
+        return false;
+    }
+    std::vector<float> rgb;
+    Colormap replacement;
+    if ((!builtinColormap(name, &rgb) && !loadColormapFile(name.c_str(), &rgb)) ||
+        !createColormap(&replacement, name, rgb)) {
+        return false;
+    }
+    destroyColormap(&colormap);
+    colormap = replacement;
+    return true;
+}
+
+
+void HeatmapRenderer::setView(const TextureRect& rect) {
+    view = rect;
+}
+
+
+void HeatmapRenderer::setIsolines(int count, float width) {
+    isolineCount = count > 0 ? (float)count : 0.0f;
+    isolineWidth = width;
+}
+
+
+void HeatmapRenderer::render(GLuint framebuffer, int x, int y, int width, int height) {
+    if (!valid() || !finishProgram()) {
+        return;
+    }
+    // Remember the caller's state we are about to change
+    GLint previousDrawFramebuffer, previousReadFramebuffer, previousProgram;
+    GLint previousViewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDrawFramebuffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    updateValueRange();
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glViewport(x, y, width, height);
+    glUseProgram(program);
+    glUniform4f(viewLocation, view.u0, view.v0, view.u1 - view.u0, view.v1 - view.v0);
+    glUniform1f(isolineCountLocation, isolineCount);
+    glUniform1f(isolineWidthLocation, isolineWidth);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, colormap.texture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, valueRange.result);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, shownTexture());
+    drawFullscreenTriangle(&triangle);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDrawFramebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    glUseProgram(previousProgram);
+}
@@ -0,0 +1,175 @@
+/*
+    The heatmap as a component for other programs' render loops.
+
+    A HeatmapRenderer owns everything needed to show one scalar field: the streamed texture
+    (texture_stream.h), the colormap, the GPU value range and the display program, all in
+    the caller's context. The caller keeps its window, its loop and its framebuffers; fields
+    go in through the same streaming uploads the viewer uses, and render() draws into any
+    framebuffer the caller names, so there are no extra contexts, context switches or
+    copies of the picture. The viewer's own single-texture mode is built on it too.
+
+    The display program is compiled in the background (see shader.h) while the caller goes
+    on to upload the first field; the first render() waits for it if it isn't done yet.
+
+    The renderer frees its GL objects when it is destroyed, so it has to go before its
+    context does. It can be moved (e.g. into a container) but not copied: two copies would
+    free the same objects.
+
+        HeatmapRendererOptions options;
+        options.width = 1024;
+        options.height = 1024;
+        HeatmapRenderer heatmap;
+        heatmap.create(options);            // with the context current and GLEW initialized
+        ...
+        heatmap.upload(field);              // whenever the field changes
+        heatmap.render(framebuffer, 0, 0, width, height);
+*/
+
+#ifndef HEATMAP_RENDERER_H
+#define HEATMAP_RENDERER_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+#include "colormap.h"
+#include "fullscreen_triangle.h"
+#include "shader.h"
+#include "texture_format.h"
+#include "texture_stream.h"
+#include "value_range.h"
+#include "view_transform.h"
+
+class ThreadPool;
+
+struct HeatmapRendererOptions {
+    int width;                      // Size of the field
+    int height;
+    HeatmapFormat format;           // Texel format, see texture_format.h
+    int levels;                     // Mipmap levels of the texture; the caller fills the lower ones
+    std::string colormap;           // A built-in colormap or a colormap file, see colormap.h
+    std::string vertexShader;       // The display shaders, relative to the working directory
+    std::string fragmentShader;
+
+    HeatmapRendererOptions()
+        : width(256), height(256), format(HEATMAP_FORMAT_R32F), levels(1), colormap("blue-red"),
+          vertexShader("fullscreen_triangle.glsl"), fragmentShader("fragment_shader.glsl") {}
+};
+
+// Point the samplers of a display program (fragment_shader.glsl), which must be current, at
+// the units render() binds: the field on 0, the colormap on 1 and the value range on 2
+void setDisplaySamplerUnits(GLuint program);
+
+class HeatmapRenderer {
+public:
+    HeatmapRenderer();
+    ~HeatmapRenderer();
+
+    // Moving hands the GL objects over; the renderer moved from is empty afterwards
+    HeatmapRenderer(HeatmapRenderer&& other);
+    HeatmapRenderer& operator=(HeatmapRenderer&& other);
+
+    // Create the GL objects in the current context (GL 3.3 core, GLEW initialized) and start
+    // building the display program. Upload a field before rendering the first time.
+    bool create(const HeatmapRendererOptions& options);
+    void destroy();
+    bool valid() const { return stream.texture != 0; }
+
+    // Wait for the display program. render() does this itself the first time; calling it
+    // earlier decides when the wait happens. false if the program didn't link, and then
+    // render() draws nothing.
+    bool finishProgram();
+    bool programFromCache() const { return fromCache; }
+
+    // Replace the display program with another linked one built from the same kind of
+    // shaders (e.g. after they were edited). The renderer takes it over and frees the old one.
+    void setProgram(GLuint program);
+
+    // A field of another size (or number of mipmap levels): new texture and range reduction.
+    // The texture is undefined until the next upload. On false the renderer is empty.
+    bool resize(int width, int height, int levels = 1);
+
+    // A new field: width * height floats, first row at the bottom. On false the upload
+    // buffer couldn't be mapped and the previous field stays.
+    bool upload(const float* data, ThreadPool* pool = 0);
+    // Only the rectangles changed; data is still the complete field
+    bool updateRects(const float* data, const std::vector<DirtyRect>& rects, ThreadPool* pool = 0);
+    // Write the field straight into the upload buffer, in the texture format (see
+    // beginTextureStreamUpload), and queue the copy with endUpload; if it returns NULL,
+    // don't call endUpload
+    void* beginUpload();
+    void endUpload();
+    // The texture was written some other way (e.g. by a compute shader): measure its range again
+    void textureChanged();
+
+    // Show another texture with the field's size and format instead of the streamed one,
+    // e.g. a frame of playback.h; 0 goes back to the streamed texture
+    void showTexture(GLuint texture);
+
+    // Map fixed values onto the ends of the colormap, or measure the field's range on the
+    // GPU after every change (the default)
+    void setValueRange(float minValue, float maxValue);
+    void setAutoRange();
+    // Measure the range now if the field changed since the last time, instead of in the
+    // next render() (e.g. to count it as part of the update)
+    void updateValueRange();
+
+    // A built-in colormap or a colormap file. On failure the current colormap stays.
+    bool setColormap(const std::string& colormap);
+
+    // The part of the field to show, see view_transform.h; the default is all of it
+    void setView(const TextureRect& view);
+
+    // Isolines as in fragment_shader.glsl, count 0 turns them off
+    void setIsolines(int count, float width = 1.0f);
+
+    // Draw into the rectangle (x, y, width, height) of framebuffer (0 is the default one).
+    // Pixels the view shows outside the field keep what the caller drew there.
+    // The framebuffer bindings, viewport and program are restored afterwards; texture units
+    // 0 to 2 are left bound to the renderer's textures.
+    void render(GLuint framebuffer, int x, int y, int width, int height);
+
+    // The streamed field texture, e.g. for the caller's own shaders, and the one render()
+    // draws (see showTexture)
+    GLuint texture() const { return stream.texture; }
+    GLuint shownTexture() const { return shown ? shown : stream.texture; }
+    int width() const { return stream.width; }
+    int height() const { return stream.height; }
+    HeatmapFormat format() const { return stream.format; }
+    int levels() const { return stream.levels; }
+    // The textures render() binds to units 1 and 2, for drawing the same picture elsewhere
+    GLuint colormapTexture() const { return colormap.texture; }
+    GLuint valueRangeTexture() const { return valueRange.result; }
+    // The stream itself, for code that uploads through its pixel buffers (see playback.h)
+    TextureStream* textureStream() { return &stream; }
+
+private:
+    HeatmapRenderer(const HeatmapRenderer&);
+    HeatmapRenderer& operator=(const HeatmapRenderer&);
+
+    void clear();
+    void moveFrom(HeatmapRenderer& other);
+    void useProgram(GLuint linked);
+
+    TextureStream stream;
+    ValueRange valueRange;
+    Colormap colormap;
+    FullscreenTriangle triangle;
+    ProgramBuild build;         // The display program while it is being built
+    bool building;
+    bool fromCache;             // The finished program came out of the binary cache
+    GLuint program;             // 0 until the build has finished and linked
+    GLint viewLocation;
+    GLint isolineCountLocation;
+    GLint isolineWidthLocation;
+    GLuint shown;               // Texture drawn instead of the streamed one, 0 if none
+    TextureRect view;
+    float isolineCount;
+    float isolineWidth;
+    float fixedMin;             // The range set by setValueRange
+    float fixedMax;
+    bool autoRange;
+    bool rangeChanged;          // The field changed since its range was last measured
+};
+
+#endif
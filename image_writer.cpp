@@ -0,0 +1,240 @@
+#include "image_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+
+#include "texture_format.h"
+
+
+ImageFileType imageFileTypeForPath(const std::string& path) {
+    if (path.size() >= 4) {
+        std::string extension = path.substr(path.size() - 4);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".exr") {
+            return IMAGE_FILE_EXR;
+        }
+    }
+    return IMAGE_FILE_PNG;
+}
+
+
+// Lookup table of the CRC-32 used by PNG chunks (the same as zlib's)
+struct CrcTable {
+    uint32_t entries[256];
+    CrcTable() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+    }
+};
+
+
+static uint32_t updateCrc(uint32_t crc, const unsigned char* data, size_t length) {
+    // Built on first use; initializing a local static is thread-safe, and encoders run in parallel
+    static const CrcTable table;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+
+static void appendBigEndian(std::vector<unsigned char>* out, uint32_t value) {
+    out->push_back((unsigned char)(value >> 24));
+    out->push_back((unsigned char)(value >> 16));
+    out->push_back((unsigned char)(value >> 8));
+    out->push_back((unsigned char)value);
+}
+
+
+static void appendLittleEndian(std::vector<unsigned char>* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out->push_back((unsigned char)(value >> (8 * i)));
+    }
+}
+
+
+// Append a chunk: length, type, data, and the CRC of type and data
+static void appendChunk(std::vector<unsigned char>* out, const char* type, const unsigned char* data, size_t length) {
+    appendBigEndian(out, (uint32_t)length);
+    size_t start = out->size();
+    out->insert(out->end(), type, type + 4);
+    out->insert(out->end(), data, data + length);
+    appendBigEndian(out, updateCrc(0xffffffffu, out->data() + start, length + 4) ^ 0xffffffffu);
+}
+
+
+static void encodePng(const unsigned char* rgba, int width, int height, int stride, bool flipRows,
+                      std::vector<unsigned char>* out) {
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    out->assign(signature, signature + sizeof(signature));
+
+    std::vector<unsigned char> header;
+    appendBigEndian(&header, (uint32_t)width);
+    appendBigEndian(&header, (uint32_t)height);
+    header.push_back(8);    // Bits per channel
+    header.push_back(2);    // Color type: RGB
+    header.push_back(0);    // Compression: deflate
+    header.push_back(0);    // Filtering: adaptive (every row uses filter 0, none)
+    header.push_back(0);    // No interlacing
+    appendChunk(out, "IHDR", header.data(), header.size());
+
+    // Raw scanlines: a filter byte, then the RGB pixels
+    size_t rowBytes = 1 + (size_t)width * 3;
+    std::vector<unsigned char> raw(rowBytes * height);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* source = rgba + (size_t)(flipRows ? height - 1 - y : y) * stride;
+        unsigned char* row = &raw[rowBytes * y];
+        row[0] = 0;
+        for (int x = 0; x < width; ++x) {
+            row[1 + x * 3] = source[x * 4];
+            row[2 + x * 3] = source[x * 4 + 1];
+            row[3 + x * 3] = source[x * 4 + 2];
+        }
+    }
+
+    // zlib stream made of stored blocks of at most 65535 bytes each
+    std::vector<unsigned char> compressed;
+    compressed.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    compressed.push_back(0x78);
+    compressed.push_back(0x01);
+    size_t offset = 0;
+    do {
+        size_t length = std::min<size_t>(65535, raw.size() - offset);
+        compressed.push_back(offset + length == raw.size() ? 1 : 0);   // Final block flag, type 00
+        compressed.push_back((unsigned char)length);
+        compressed.push_back((unsigned char)(length >> 8));
+        compressed.push_back((unsigned char)~length);
+        compressed.push_back((unsigned char)(~length >> 8));
+        compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+    // Adler-32 of the uncompressed data
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw.size(); ++i) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(&compressed, (b << 16) | a);
+    appendChunk(out, "IDAT", compressed.data(), compressed.size());
+    appendChunk(out, "IEND", NULL, 0);
+}
+
+
+// Header attribute: name, type, size of the value, then the value
+static void appendExrAttribute(std::vector<unsigned char>* out, const char* name, const char* type,
+                               const std::vector<unsigned char>& value) {
+    out->insert(out->end(), name, name + strlen(name) + 1);
+    out->insert(out->end(), type, type + strlen(type) + 1);
+    appendLittleEndian(out, (uint32_t)value.size(), 4);
+    out->insert(out->end(), value.begin(), value.end());
+}
+
+
+static void encodeExr(const unsigned char* rgba, int width, int height, int stride, bool flipRows,
+                      std::vector<unsigned char>* out) {
+    out->clear();
+    appendLittleEndian(out, 20000630, 4);   // Magic number
+    appendLittleEndian(out, 2, 4);          // Version 2, single-part scanline file
+
+    // Channels in alphabetical order, as the format requires: B, G, R, all half floats
+    std::vector<unsigned char> value;
+    const char* channels[3] = { "B", "G", "R" };
+    for (int c = 0; c < 3; ++c) {
+        value.push_back((unsigned char)channels[c][0]);
+        value.push_back(0);
+        appendLittleEndian(&value, 1, 4);   // HALF
+        appendLittleEndian(&value, 0, 4);   // pLinear and three reserved bytes
+        appendLittleEndian(&value, 1, 4);   // x sampling
+        appendLittleEndian(&value, 1, 4);   // y sampling
+    }
+    value.push_back(0);
+    appendExrAttribute(out, "channels", "chlist", value);
+    appendExrAttribute(out, "compression", "compression", std::vector<unsigned char>(1, 0));
+    value.clear();
+    appendLittleEndian(&value, 0, 4);
+    appendLittleEndian(&value, 0, 4);
+    appendLittleEndian(&value, (uint32_t)(width - 1), 4);
+    appendLittleEndian(&value, (uint32_t)(height - 1), 4);
+    appendExrAttribute(out, "dataWindow", "box2i", value);
+    appendExrAttribute(out, "displayWindow", "box2i", value);
+    appendExrAttribute(out, "lineOrder", "lineOrder", std::vector<unsigned char>(1, 0));
+    float one = 1.0f;
+    uint32_t oneBits;
+    memcpy(&oneBits, &one, 4);
+    value.clear();
+    appendLittleEndian(&value, oneBits, 4);
+    appendExrAttribute(out, "pixelAspectRatio", "float", value);
+    appendExrAttribute(out, "screenWindowWidth", "float", value);
+    appendExrAttribute(out, "screenWindowCenter", "v2f", std::vector<unsigned char>(8, 0));
+    out->push_back(0);
+
+    // Offset table: where each scanline starts. Uncompressed lines all have the same size.
+    size_t lineBytes = (size_t)width * 3 * 2;
+    size_t firstLine = out->size() + (size_t)height * 8;
+    for (int y = 0; y < height; ++y) {
+        appendLittleEndian(out, firstLine + (size_t)y * (8 + lineBytes), 8);
+    }
+
+    // sRGB to linear for every 8-bit value
+    float linear[256];
+    for (int i = 0; i < 256; ++i) {
+        float c = i / 255.0f;
+        linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    std::vector<float> line((size_t)width * 3);
+    std::vector<unsigned char> packed(lineBytes);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* source = rgba + (size_t)(flipRows ? height - 1 - y : y) * stride;
+        for (int c = 0; c < 3; ++c) {
+            int channel = 2 - c;     // B, G, R
+            for (int x = 0; x < width; ++x) {
+                line[(size_t)c * width + x] = linear[source[x * 4 + channel]];
+            }
+        }
+        packHeatmapTexels(line.data(), packed.data(), line.size(), HEATMAP_FORMAT_R16F);
+        appendLittleEndian(out, (uint32_t)y, 4);
+        appendLittleEndian(out, (uint32_t)lineBytes, 4);
+        out->insert(out->end(), packed.begin(), packed.end());
+    }
+}
+
+
+void encodeImage(ImageFileType type, const unsigned char* rgba, int width, int height, int stride, bool flipRows,
+                 std::vector<unsigned char>* out) {
+    if (type == IMAGE_FILE_EXR) {
+        encodeExr(rgba, width, height, stride, flipRows, out);
+    } else {
+        encodePng(rgba, width, height, stride, flipRows, out);
+    }
+}
+
+
+bool writeImageFile(const char* path, const std::vector<unsigned char>& bytes) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Failed to create image file: " << path << std::endl;
+        return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    if (fclose(file) != 0 || !ok) {
+        std::cerr << "Failed to write image file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool writePng(const char* path, const unsigned char* rgba, int width, int height, int stride, bool flipRows) {
+    std::vector<unsigned char> bytes;
+    encodePng(rgba, width, height, stride, flipRows, &bytes);
+    return writeImageFile(path, bytes);
+}
@@ -0,0 +1,42 @@
+/*
+    Writing rendered heatmaps to image files.
+
+    PNG files are written without any library: the pixels go into "stored" deflate blocks,
+    which are uncompressed, so the only work per byte is the CRC and the Adler checksum.
+    The files are larger than a compressing encoder would make them, but writing one is
+    about as fast as copying the pixels.
+
+    OpenEXR files are uncompressed scanline images with half-float R, G and B channels. The
+    8-bit sRGB colors are converted to linear values, as EXR viewers expect.
+
+    Encoding and writing are separate steps so they can run on different threads (see
+    export_pipeline.h).
+*/
+
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <string>
+#include <vector>
+
+enum ImageFileType {
+    IMAGE_FILE_PNG,
+    IMAGE_FILE_EXR
+};
+
+// Pick the file type from the extension of path: ".exr" is EXR, anything else PNG
+ImageFileType imageFileTypeForPath(const std::string& path);
+
+// Encode 8-bit RGBA pixels into the bytes of an image file (the alpha channel is dropped).
+// stride is the distance between rows in bytes; with flipRows the first row in memory
+// becomes the bottom row of the image, as in pixels read back from OpenGL.
+void encodeImage(ImageFileType type, const unsigned char* rgba, int width, int height, int stride, bool flipRows,
+                 std::vector<unsigned char>* out);
+
+// Write encoded bytes to path
+bool writeImageFile(const char* path, const std::vector<unsigned char>& bytes);
+
+// Encode and write a PNG in one go
+bool writePng(const char* path, const unsigned char* rgba, int width, int height, int stride, bool flipRows);
+
+#endif
@@ -0,0 +1,242 @@
+#include "lod_pyramid.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+
+int lodLevelCount(int width, int height) {
+    int levels = 1;
+    int size = width > height ? width : height;
+    while (size > 1) {
+        size /= 2;
+        ++levels;
+    }
+    return levels;
+}
+
+
+bool parseLodReduction(const std::string& name, LodReduction* reduction) {
+    if (name == "mean") {
+        *reduction = LOD_REDUCE_MEAN;
+    } else if (name == "max") {
+        *reduction = LOD_REDUCE_MAX;
+    } else if (name == "min") {
+        *reduction = LOD_REDUCE_MIN;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+bool createLodPyramid(LodPyramid* pyramid, LodReduction reduction) {
+    pyramid->reduction = reduction;
+    pyramid->program = 0;
+    pyramid->framebuffer = 0;
+    pyramid->triangle.vertexArray = 0;
+    pyramid->viewTexture = 0;
+    pyramid->viewLevels = 0;
+
+    // The mean of a whole pyramid is exactly the driver's mipmap generation; the program is
+    // only needed to build parts of levels, and without it every build is a full one
+    pyramid->program = createShaderProgram("fullscreen_triangle.glsl", "lod_reduce.glsl");
+    int success;
+    glGetProgramiv(pyramid->program, GL_LINK_STATUS, &success);
+    if (!success && reduction == LOD_REDUCE_MEAN) {
+        glDeleteProgram(pyramid->program);
+        pyramid->program = 0;
+        return true;
+    }
+    if (!success) {
+        std::cerr << "Failed to build the LOD reduction program" << std::endl;
+        destroyLodPyramid(pyramid);
+        return false;
+    }
+    pyramid->sourceSizeLocation = glGetUniformLocation(pyramid->program, "sourceSize");
+    pyramid->destinationSizeLocation = glGetUniformLocation(pyramid->program, "destinationSize");
+    pyramid->reductionLocation = glGetUniformLocation(pyramid->program, "reduction");
+
+    createFullscreenTriangle(&pyramid->triangle);
+    glGenFramebuffers(1, &pyramid->framebuffer);
+    return true;
+}
+
+
+// Render levels 1..levels-1 with the reduction program, only inside regions[level] if given.
+// The sampler sees levels 0..levels-1 afterwards.
+static void reduceLevels(LodPyramid* pyramid, GLuint texture, int width, int height, int levels,
+                         const LodRegion* regions) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // Remember the state we are about to change
+    GLint previousProgram;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    GLint previousViewport[4];
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    glUseProgram(pyramid->program);
+    glUniform1i(pyramid->reductionLocation, (int)pyramid->reduction);
+    glUniform1i(glGetUniformLocation(pyramid->program, "sourceTexture"), 0);
+
+    // Read single texels, never a blend of neighbours or levels
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, pyramid->framebuffer);
+
+    for (int level = 1; level < levels; ++level) {
+        int sourceWidth = width >> (level - 1), sourceHeight = height >> (level - 1);
+        int destinationWidth = width >> level, destinationHeight = height >> level;
+        if (sourceWidth < 1) sourceWidth = 1;
+        if (sourceHeight < 1) sourceHeight = 1;
+        if (destinationWidth < 1) destinationWidth = 1;
+        if (destinationHeight < 1) destinationHeight = 1;
+
+        // Sample only the previous level while rendering into this one. Reading and writing
+        // different levels of the same texture is allowed as long as they don't overlap.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+        glViewport(0, 0, destinationWidth, destinationHeight);
+        if (regions) {
+            const LodRegion& region = regions[level];
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(region.x0, region.y0, region.x1 - region.x0 + 1, region.y1 - region.y0 + 1);
+        }
+
+        glUniform2f(pyramid->sourceSizeLocation, (float)sourceWidth, (float)sourceHeight);
+        glUniform2f(pyramid->destinationSizeLocation, (float)destinationWidth, (float)destinationHeight);
+        drawFullscreenTriangle(&pyramid->triangle);
+    }
+
+    if (regions) {
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    // Expose the built levels again and let the sampler choose between them
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    glUseProgram(previousProgram);
+}
+
+
+void buildLodPyramid(LodPyramid* pyramid, GLuint texture, int width, int height, int levels) {
+    if (pyramid->viewTexture == texture) {
+        pyramid->viewTexture = 0;
+    }
+    if (levels <= 1) {
+        return;
+    }
+    if (pyramid->reduction == LOD_REDUCE_MEAN) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        return;
+    }
+    reduceLevels(pyramid, texture, width, height, levels, NULL);
+}
+
+
+int lodLevelsForView(int width, int height, int levels, const TextureRect& view, int framebufferWidth,
+                     int framebufferHeight) {
+    // The sampler picks level log2(texels per pixel) of the axis that is squeezed most
+    float texelsPerPixel = std::max((view.u1 - view.u0) * (float)width / (float)std::max(framebufferWidth, 1),
+                                    (view.v1 - view.v0) * (float)height / (float)std::max(framebufferHeight, 1));
+    if (texelsPerPixel <= 1.0f) {
+        return 1;
+    }
+    int coarsest = (int)std::floor(std::log2(texelsPerPixel)) + 1;
+    return std::min(coarsest + 1, levels);
+}
+
+
+// The texels of every level below 0 the view needs: what it shows (plus a texel for the
+// bilinear filter), and what the next coarser level is built from
+static void viewRegions(int width, int height, int levels, const TextureRect& view, std::vector<LodRegion>* regions) {
+    regions->assign(levels, LodRegion());
+    for (int level = levels - 1; level >= 1; --level) {
+        int levelWidth = std::max(width >> level, 1), levelHeight = std::max(height >> level, 1);
+        LodRegion region;
+        region.x0 = (int)std::floor(view.u0 * levelWidth) - 1;
+        region.y0 = (int)std::floor(view.v0 * levelHeight) - 1;
+        region.x1 = (int)std::ceil(view.u1 * levelWidth);
+        region.y1 = (int)std::ceil(view.v1 * levelHeight);
+        if (level < levels - 1) {
+            // A texel of the next level reads up to 3x3 texels of this one
+            const LodRegion& coarser = (*regions)[level + 1];
+            region.x0 = std::min(region.x0, 2 * coarser.x0);
+            region.y0 = std::min(region.y0, 2 * coarser.y0);
+            region.x1 = std::max(region.x1, 2 * coarser.x1 + 2);
+            region.y1 = std::max(region.y1, 2 * coarser.y1 + 2);
+        }
+        region.x0 = std::max(region.x0, 0);
+        region.y0 = std::max(region.y0, 0);
+        region.x1 = std::min(region.x1, levelWidth - 1);
+        region.y1 = std::min(region.y1, levelHeight - 1);
+        (*regions)[level] = region;
+    }
+}
+
+
+void buildLodPyramidForView(LodPyramid* pyramid, GLuint texture, int width, int height, int levels,
+                            const TextureRect& view, int framebufferWidth, int framebufferHeight) {
+    if (!pyramid->program) {
+        buildLodPyramid(pyramid, texture, width, height, levels);
+        return;
+    }
+    int needed = lodLevelsForView(width, height, levels, view, framebufferWidth, framebufferHeight);
+    viewRegions(width, height, needed, view, &pyramid->viewRegions);
+    pyramid->viewTexture = texture;
+    pyramid->viewLevels = needed;
+    if (needed > 1) {
+        reduceLevels(pyramid, texture, width, height, needed, pyramid->viewRegions.data());
+    } else {
+        // Zoomed in: only level 0 is sampled, and the stale levels must not be
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+}
+
+
+bool lodPyramidCoversView(const LodPyramid* pyramid, GLuint texture, int width, int height, int levels,
+                          const TextureRect& view, int framebufferWidth, int framebufferHeight) {
+    if (pyramid->viewTexture != texture) {
+        return true; // Built in full
+    }
+    int needed = lodLevelsForView(width, height, levels, view, framebufferWidth, framebufferHeight);
+    if (needed > pyramid->viewLevels) {
+        return false;
+    }
+    std::vector<LodRegion> regions;
+    viewRegions(width, height, needed, view, &regions);
+    for (int level = 1; level < needed; ++level) {
+        const LodRegion& built = pyramid->viewRegions[level];
+        const LodRegion& wanted = regions[level];
+        if (wanted.x0 < built.x0 || wanted.y0 < built.y0 || wanted.x1 > built.x1 || wanted.y1 > built.y1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void destroyLodPyramid(LodPyramid* pyramid) {
+    if (pyramid->framebuffer) {
+        glDeleteFramebuffers(1, &pyramid->framebuffer);
+        pyramid->framebuffer = 0;
+    }
+    destroyFullscreenTriangle(&pyramid->triangle);
+    if (pyramid->program) {
+        glDeleteProgram(pyramid->program);
+        pyramid->program = 0;
+    }
+}
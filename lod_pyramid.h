@@ -0,0 +1,82 @@
+/*
+    Level-of-detail pyramid for the heatmap texture.
+
+    Without mipmaps a zoomed-out view skips most texels, which aliases and thrashes the
+    texture cache. The pyramid fills every mipmap level from the one above it on the GPU,
+    and the trilinear min filter then lets the sampler pick the right level on its own.
+
+    Averaging (like glGenerateMipmap) makes small hot spots fade away when zoomed out, so a
+    level can also keep the maximum or minimum of the texels it covers instead.
+
+    A field that changes every frame needs its pyramid rebuilt every frame, but a zoomed-in
+    view never samples the coarse levels and shows only a corner of the fine ones. Building
+    for a view (see view_transform.h) renders only the levels it samples and, in each, only
+    the texels it reads, so the cost follows the window instead of the field.
+*/
+
+#ifndef LOD_PYRAMID_H
+#define LOD_PYRAMID_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+#include "fullscreen_triangle.h"
+#include "view_transform.h"
+
+enum LodReduction {
+    LOD_REDUCE_MEAN,    // Box filter, same as glGenerateMipmap
+    LOD_REDUCE_MAX,     // Peaks stay visible at every zoom level
+    LOD_REDUCE_MIN      // Troughs stay visible at every zoom level
+};
+
+// Texels [x0, x1] x [y0, y1] of one level
+struct LodRegion {
+    int x0, y0;
+    int x1, y1;
+};
+
+struct LodPyramid {
+    LodReduction reduction;
+    GLuint program;         // lod_reduce.glsl (full builds of the mean use glGenerateMipmap instead)
+    GLuint framebuffer;
+    FullscreenTriangle triangle;
+    GLint sourceSizeLocation;
+    GLint destinationSizeLocation;
+    GLint reductionLocation;
+    // What the last buildLodPyramidForView built: its texture (0 after a full build), the
+    // number of levels and the texels of each level
+    GLuint viewTexture;
+    int viewLevels;
+    std::vector<LodRegion> viewRegions;
+};
+
+// Number of mipmap levels of a full pyramid down to 1x1
+int lodLevelCount(int width, int height);
+
+// Parse "mean", "max" or "min". Returns false for anything else.
+bool parseLodReduction(const std::string& name, LodReduction* reduction);
+
+bool createLodPyramid(LodPyramid* pyramid, LodReduction reduction);
+
+// Recompute levels 1..levels-1 of the texture from level 0. Call after every upload.
+void buildLodPyramid(LodPyramid* pyramid, GLuint texture, int width, int height, int levels);
+
+// Levels (out of levels) that view samples on a framebuffer of that size: down to about one
+// texel per pixel, plus the next one for the trilinear blend. 1 when zoomed in.
+int lodLevelsForView(int width, int height, int levels, const TextureRect& view, int framebufferWidth,
+                     int framebufferHeight);
+
+// Like buildLodPyramid, but only the levels view samples, and in them only the texels it
+// reads. The sampler is kept to those levels until the next build.
+void buildLodPyramidForView(LodPyramid* pyramid, GLuint texture, int width, int height, int levels,
+                            const TextureRect& view, int framebufferWidth, int framebufferHeight);
+
+// false if texture was last built for a view that doesn't cover this one (after panning or
+// zooming out), so drawing it needs another buildLodPyramidForView first
+bool lodPyramidCoversView(const LodPyramid* pyramid, GLuint texture, int width, int height, int levels,
+                          const TextureRect& view, int framebufferWidth, int framebufferHeight);
+
+void destroyLodPyramid(LodPyramid* pyramid);
+
+#endif
@@ -0,0 +1,46 @@
+#version 330 core
+
+// Builds one mipmap level of the heatmap from the level above it.
+// The source texture is restricted to that single level (base = max level), so plain
+// texture lookups read it directly. Each destination texel covers a 2x2 block of source
+// texels, or up to 3x3 where an odd source size doesn't divide evenly.
+
+uniform sampler2D sourceTexture;
+uniform vec2 sourceSize;        // Size of the source level in texels
+uniform vec2 destinationSize;   // Size of the level being written
+uniform int reduction;          // 0 = mean, 1 = max, 2 = min
+
+out vec4 reducedValue;
+
+void main() {
+    vec2 texel = floor(gl_FragCoord.xy);
+    // Range of source texels under this destination texel
+    vec2 first = floor(texel * sourceSize / destinationSize);
+    vec2 last = ceil((texel + 1.0) * sourceSize / destinationSize) - 1.0;
+
+    float sum = 0.0;
+    float count = 0.0;
+    float maxValue = -1e30;
+    float minValue = 1e30;
+    for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 3; ++i) {
+            vec2 source = first + vec2(float(i), float(j));
+            if (source.x > last.x || source.y > last.y) {
+                continue;
+            }
+            float value = texture(sourceTexture, (source + 0.5) / sourceSize).r;
+            sum += value;
+            count += 1.0;
+            maxValue = max(maxValue, value);
+            minValue = min(minValue, value);
+        }
+    }
+
+    float result = sum / count;
+    if (reduction == 1) {
+        result = maxValue;
+    } else if (reduction == 2) {
+        result = minValue;
+    }
+    reducedValue = vec4(result);
+}
@@ -18,144 +18,659 @@
 #include <GL/glew.h>    // GLEW library manages OpenGL extensions
 #include <GLFW/glfw3.h> // GLFW library helps us make windows
 #include <string>
-#include <fstream>      // For reading files, help us to read our shaders from separate files
-#include <sstream>      // For working with file streams, help us to read our shaders from separate files
-#include <iostream>     // For standard input/output
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>     // For standard input/output
+#include <sstream>
+
+#include "colormap.h"
+#include "display_wall.h"
+#include "export_pipeline.h"
+#include "field_buffer_pool.h"
+#include "field_codec.h"
+#include "field_generator.h"
+#include "field_loader.h"
+#include "frame_cache.h"
+#include "frame_ingest.h"
+#include "frame_stats.h"
+#include "gpu_field_generator.h"
+#include "heatmap_panels.h"
+#include "heatmap_renderer.h"
+#include "lod_pyramid.h"
+#include "offscreen_target.h"
+#include "playback.h"
+#include "rgtc_encoder.h"
+#include "shader.h"
+#include "shader_watcher.h"
+#include "shared_field.h"
+#include "texture_format.h"
+#include "texture_stream.h"
+#include "thread_pool.h"
+#include "tiled_heatmap.h"
+#include "value_range.h"
+#include "view_transform.h"
+
+
+// Generate the ring field on the CPU and stream it into the texture.
+// Float fields are generated straight into the mapped pixel buffer; the smaller formats
+// are generated into scratch memory first and packed on the way into the pixel buffer.
+// Returns false if the pixel buffer couldn't be mapped; the texture keeps its last field.
+bool streamRingField(HeatmapRenderer* heatmap, FieldBuffer& scratch, const RingParams& params, ThreadPool* pool) {
+    if (heatmap->format() == HEATMAP_FORMAT_R32F) {
+        float* frame = (float*)heatmap->beginUpload();
+        if (!frame) {
+            return false;
+        }
+        generateRingField(frame, heatmap->width(), heatmap->height(), params, pool);
+        heatmap->endUpload();
+        return true;
+    }
+    scratch.resize((size_t)heatmap->width() * (size_t)heatmap->height());
+    generateRingField(scratch.data(), heatmap->width(), heatmap->height(), params, pool);
+    return heatmap->upload(scratch.data(), pool);
+}
+
+
+// --format bc4: how much the block compression changes a field, to judge whether a dataset can take it
+void printRgtcQuality(const float* data, int width, int height, ThreadPool* pool) {
+    RgtcQuality quality;
+    measureRgtcQuality(data, width, height, &quality, pool);
+    std::cout << "BC4: PSNR " << quality.psnr << " dB, RMS error " << quality.rmsError << ", max error "
+              << quality.maxError << " (of values clamped to [0, 1])" << std::endl;
+}
+
 
+// --dirty-region: regenerate two squares that wander around the field (they cross now and
+// then, which exercises the merging) and upload only those, instead of the whole field.
+// scratch holds the complete field, so everything outside the squares keeps its last value.
+void streamDirtyRegions(HeatmapRenderer* heatmap, FieldBuffer& scratch, const RingParams& params,
+                        int regionSize, float time, ThreadPool* pool) {
+    int width = heatmap->width(), height = heatmap->height();
+    size_t texels = (size_t)width * (size_t)height;
+    if (scratch.size() != texels) {
+        scratch.resize(texels);
+        generateRingField(scratch.data(), width, height, params, pool);
+    }
+    std::vector<DirtyRect> rects;
+    for (int i = 0; i < 2; ++i) {
+        float angle = time * (i ? -0.7f : 0.5f);
+        DirtyRect rect;
+        rect.width = std::min(regionSize, width);
+        rect.height = std::min(regionSize, height);
+        rect.x = (int)((0.5f + 0.35f * std::cos(angle)) * (width - rect.width));
+        rect.y = (int)((0.5f + 0.35f * std::sin(angle)) * (height - rect.height));
+        generateRingRegion(scratch.data() + (size_t)rect.y * width + rect.x, width,
+                           rect.x, rect.y, rect.width, rect.height, width, height, params, pool);
+        rects.push_back(rect);
+    }
+    heatmap->updateRects(scratch.data(), rects, pool);
+}
+
+
+// Ring pattern of one panel: every sensor gets its own center and phase
+RingParams panelRingParams(const RingParams& base, int index, float time) {
+    RingParams params = base;
+    params.centerX = 0.3f + 0.4f * (float)((index * 37) % 101) / 100.0f;
+    params.centerY = 0.3f + 0.4f * (float)((index * 61) % 103) / 102.0f;
+    params.phase = time + 0.7f * (float)index;
+    return params;
+}
 
-// Function to read shader code from a file
-std::string readShaderFile (const char* filePath) {
-    std::ifstream shaderFile;   // Declare an input file stream
-    shaderFile.open(filePath);   // Open the file using the filePath
 
-    // If we couldn't open the shaderFile, output the error to standard error stream 
-    if (!shaderFile.is_open()) {
-        std::cerr << "Failed to open shader file: " << filePath << std::endl;
+// Generate every panel on the CPU and upload it into its layer
+void fillHeatmapPanels(HeatmapPanels* panels, FieldBuffer& scratch, const RingParams& base, float time,
+                       ThreadPool* pool) {
+    scratch.resize((size_t)panels->panelWidth * (size_t)panels->panelHeight);
+    for (int i = 0; i < panels->panelCount; ++i) {
+        generateRingField(scratch.data(), panels->panelWidth, panels->panelHeight, panelRingParams(base, i, time), pool);
+        uploadHeatmapPanel(panels, i, scratch.data());
     }
+}
+
+
+// Parse a size like "1024x768". Returns false if the text isn't two positive numbers.
+bool parseSize(const char* text, int* width, int* height) {
+    char separator;
+    return sscanf(text, "%d%c%d", width, &separator, height) == 3 && separator == 'x' && *width > 0 && *height > 0;
+}
+
+
+// The part of the field shown at one texel per pixel, centered in the window
+TextureRect centeredView(int fieldWidth, int fieldHeight, int framebufferWidth, int framebufferHeight) {
+    float halfU = 0.5f * (float)framebufferWidth / (float)fieldWidth;
+    float halfV = 0.5f * (float)framebufferHeight / (float)fieldHeight;
+    TextureRect view = { 0.5f - halfU, 0.5f - halfV, 0.5f + halfU, 0.5f + halfV };
+    return view;
+}
+
+
+// One image of a --headless batch: the field to show and the file to save it to
+struct BatchJob {
+    std::string input;      // "rings", "rings:PHASE" or a field file
+    std::string output;
+};
 
-    // Takes the entire content of the shaderFile and streams it into the string stream object.
-    std::stringstream shaderStream;
-    shaderStream << shaderFile.rdbuf(); 
-    shaderFile.close(); 
 
-    // Convert stream content to string and return it
-    return shaderStream.str();  
+// Read a batch list: one "INPUT OUTPUT" pair per line, '#' starts a comment
+bool readBatchList(const char* path, std::vector<BatchJob>* jobs) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open batch list: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::istringstream fields(line);
+        BatchJob job;
+        if (!(fields >> job.input >> job.output)) {
+            std::cerr << "Expected \"INPUT OUTPUT\" on line " << lineNumber << " of " << path << std::endl;
+            return false;
+        }
+        jobs->push_back(job);
+    }
+    return true;
 }
 
 
-// Function to compile a shader from a file
-// GLuint is a type defined in OpenGL. It is used to represent various OpenGL objects, such as shaders, textures, buffers, and programs. 
-// GL_VERTEX_SHADER or GL_FRAGMENT_SHADER is specified by the type parameter.
-GLuint compileShaderFromFile(GLenum type, const char* filePath) {
-    std::string shaderCode = readShaderFile(filePath);  // Read the shader code from the file as a string
-    const char* shaderSource = shaderCode.c_str();      // Covert the string to C-style string
+// --headless: show every field of the batch in the offscreen target and save it.
+// The colormap, value range and isolines are set up on heatmap by the caller.
+// Reading an image back and encoding it overlaps with uploading and drawing the next one.
+// Returns the number of images that failed.
+int renderBatch(const std::vector<BatchJob>& jobs, OffscreenTarget* target, HeatmapRenderer* heatmap,
+                RingParams ringParams, int rawWidth, int rawHeight, FieldBuffer& scratch, ThreadPool* pool) {
+    int failures = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const BatchJob& job = jobs[i];
+        MappedField field;
+        field.data = NULL;
+        CachedFrame decoded;
+        int width = heatmap->width(), height = heatmap->height();
+        bool rings = job.input == "rings" || job.input.compare(0, 6, "rings:") == 0;
+        if (rings) {
+            ringParams.phase = job.input.size() > 6 ? (float)atof(job.input.c_str() + 6) : 0.0f;
+            width = rawWidth;
+            height = rawHeight;
+        } else if (openFieldFile(job.input, &field, &decoded, false, rawWidth, rawHeight, pool)) {
+            width = field.width;
+            height = field.height;
+        } else {
+            ++failures;
+            continue;
+        }
 
-    GLuint shader = glCreateShader(type);                // Tells OpenGL to create a new shader with certain type (vertex or fragment)
-    glShaderSource(shader, 1, &shaderSource, NULL);      // Pass the actual shader code to OpenGL, so it knows what code to compile
-    glCompileShader(shader);                             // Compile the shader
+        if (!heatmap->resize(width, height)) {
+            if (field.data) {
+                closeMappedField(&field);
+            }
+            return failures + (int)(jobs.size() - i);
+        }
+        bool uploaded;
+        if (field.data) {
+            uploaded = heatmap->upload(field.data, pool);
+            closeMappedField(&field);
+        } else {
+            uploaded = streamRingField(heatmap, scratch, ringParams, pool);
+        }
+        // The texture still holds the previous job's field, which mustn't be saved under this name
+        if (!uploaded) {
+            std::cerr << "Failed to upload " << job.input << ", skipping " << job.output << std::endl;
+            ++failures;
+            continue;
+        }
 
-    // Check whether the shader is comiles correctly.
-    int success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, NULL, infoLog); // Get error message from OpenGL
-        std::cerr << "Error compiling shader from file: " << filePath << "\n" << infoLog << std::endl;
+        bindOffscreenTarget(target);
+        glClear(GL_COLOR_BUFFER_BIT);
+        heatmap->render(target->framebuffer, 0, 0, target->width, target->height);
+        queueOffscreenReadback(target, job.output);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
-    return shader;  // return the compiled shader obejct
+    finishOffscreenReadbacks(target);
+    return failures + target->failures;
 }
 
 
-// Function to create a shader program using vertex and fragment shaders from files.
-// A shader program takes both the vertex shader and the fragment shader and links them
-// together into one program that the GPU can use.
-GLuint createShaderProgram() {
-    GLuint vertexShader = compileShaderFromFile(GL_VERTEX_SHADER, "vertex_shader.glsl");
-    GLuint fragmentShader = compileShaderFromFile(GL_FRAGMENT_SHADER, "fragment_shader.glsl");
+// State shared between the GLFW callbacks and the render loop
+struct ViewerState {
+    bool needsRedraw;       // Something on screen changed since the last frame
+    int colormapSteps;      // Presses of the colormap key not handled yet
+    // Playback keys not handled yet
+    bool togglePause;
+    bool reverse;
+    int frameSteps;         // Arrow key presses (and repeats), right minus left
+    int speed;              // Speed picked with a number key, 0 if none
+    // Pan and zoom input not handled yet
+    double zoomSteps;       // Scroll wheel clicks and +/- presses, positive zooms in
+    float zoomX;            // Window point to zoom around, in [0, 1] from the bottom left
+    float zoomY;
+    bool dragging;          // The left mouse button is down
+    double dragX;           // Cursor position of the last drag event, in screen coordinates
+    double dragY;
+    double panX;            // Distance dragged, in screen coordinates (y down)
+    double panY;
+    bool resetView;
+    bool toggleIsolines;    // I was pressed
+};
+
+
+// The framebuffer was resized: draw into all of it and show it again
+void onFramebufferSize(GLFWwindow* window, int width, int height) {
+    glViewport(0, 0, width, height);
+    ((ViewerState*)glfwGetWindowUserPointer(window))->needsRedraw = true;
+}
+
+
+// The window system lost the contents of the window (e.g. it was uncovered)
+void onWindowRefresh(GLFWwindow* window) {
+    ((ViewerState*)glfwGetWindowUserPointer(window))->needsRedraw = true;
+}
+
+
+// The wheel zooms around the point under the cursor
+void onScroll(GLFWwindow* window, double xoffset, double yoffset) {
+    (void)xoffset;
+    ViewerState* viewer = (ViewerState*)glfwGetWindowUserPointer(window);
+    double x, y;
+    int width, height;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    viewer->zoomSteps += yoffset;
+    viewer->zoomX = width > 0 ? (float)(x / width) : 0.5f;
+    viewer->zoomY = height > 0 ? 1.0f - (float)(y / height) : 0.5f;
+    viewer->needsRedraw = true;
+}
+
+
+// Dragging with the left button pans
+void onMouseButton(GLFWwindow* window, int button, int action, int mods) {
+    (void)mods;
+    ViewerState* viewer = (ViewerState*)glfwGetWindowUserPointer(window);
+    if (button == GLFW_MOUSE_BUTTON_LEFT) {
+        viewer->dragging = action == GLFW_PRESS;
+        glfwGetCursorPos(window, &viewer->dragX, &viewer->dragY);
+    }
+}
 
-    GLuint shaderProgram = glCreateProgram();       // Create a new shader program
-    glAttachShader(shaderProgram, vertexShader);    // Attach the vertex shader
-    glAttachShader(shaderProgram, fragmentShader);  // Attach the fragment shader
-    glLinkProgram(shaderProgram);                   // Link both shaders into one program
 
-    int success;
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success); // Check if linking was successful
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog); // If linking failed, get error message
-        std::cerr << "Error linking program: " << infoLog << std::endl;
+void onCursorPos(GLFWwindow* window, double x, double y) {
+    ViewerState* viewer = (ViewerState*)glfwGetWindowUserPointer(window);
+    if (viewer->dragging) {
+        viewer->panX += x - viewer->dragX;
+        viewer->panY += y - viewer->dragY;
+        viewer->dragX = x;
+        viewer->dragY = y;
+        viewer->needsRedraw = true;
     }
+}
 
-    // We don't need the individual shaders anymore
-    glDeleteShader(vertexShader); 
-    glDeleteShader(fragmentShader);
 
-    return shaderProgram; // Return the linked shader program
+void onKey(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    (void)scancode;
+    (void)mods;
+    ViewerState* viewer = (ViewerState*)glfwGetWindowUserPointer(window);
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        ++viewer->colormapSteps;
+    }
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        viewer->toggleIsolines = !viewer->toggleIsolines;
+    }
+    // Playback: space pauses, the arrows step (holding them scrubs), R reverses, 1/2/4/8 set the speed
+    if (action == GLFW_PRESS && key == GLFW_KEY_SPACE) {
+        viewer->togglePause = !viewer->togglePause;
+    } else if (action == GLFW_PRESS && key == GLFW_KEY_R) {
+        viewer->reverse = !viewer->reverse;
+    } else if (action != GLFW_RELEASE && (key == GLFW_KEY_RIGHT || key == GLFW_KEY_LEFT)) {
+        viewer->frameSteps += key == GLFW_KEY_RIGHT ? 1 : -1;
+    } else if (action == GLFW_PRESS && (key == GLFW_KEY_1 || key == GLFW_KEY_2 || key == GLFW_KEY_4 || key == GLFW_KEY_8)) {
+        viewer->speed = key - GLFW_KEY_0;
+    }
+    // View: +/- zoom around the middle of the window, 0 shows the whole field again
+    if (action != GLFW_RELEASE && (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD ||
+                                   key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT)) {
+        viewer->zoomSteps += key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD ? 1.0 : -1.0;
+        viewer->zoomX = 0.5f;
+        viewer->zoomY = 0.5f;
+    } else if (action == GLFW_PRESS && (key == GLFW_KEY_0 || key == GLFW_KEY_KP_0)) {
+        viewer->resetView = true;
+    }
 }
 
 
-// Function to generate a 2D scalar field as a texture (our heatmap)
-// We will create sample texture as shown in the python code example (effect of rings radiating from the center)
-void generateHeatmapTexture(GLuint* texture, int width, int height) {
-    // 1D array of floats to hold our scalars
-    float* data = new float[width * height];
-
-    // adjust frequency
-    float scale = 30.0f;
-    // Center of the texture
-    float centerX = 0.5f;
-    float centerY = 0.5f;
-    // Loop over each pixel and calculate the scalar value using sin(distance from center)
-    // to create the effect of rings radiating from the center
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            // Normalize x and y to the range [0, 1]
-            float xNorm = (float)x / (float)width;
-            float yNorm = (float)y / (float)height;
-            // Calculate the distance of this point from the center of the texture
-            float dist = sqrt(pow(xNorm - centerX, 2.0f) + pow(yNorm - centerY, 2.0f));
-            // Apply the sine function to the distance
-            float value = sin(scale * dist);
-            // Normalize the sine result from range [-1, 1] to the range [0, 1]
-            value = (value + 1.0f) / 2.0f;
-            // Store the value in the texture data
-            data[y * width + x] = value;
-        }
-    }
-
-    // Generate a new texture id and stores it in *texture
-    glGenTextures(1, texture);
-    // binds the generated texture ID to the 2D texture target
-    glBindTexture(GL_TEXTURE_2D, *texture);
-    // Upload the data to the GPU 
-    // as a single-channel texture (GL_RED) since we have scaler data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_FLOAT, data);
-
-    // Define how the texture is applied when the texture coordinates fall outside the range [0, 1]
-    // S (horizontal), T (vertical)
-    // GL_CLAMP_TO_EDGE means we use edge texel color repeatedly
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    // Define how the texture is sampled when rendered at different resolutions or sizes
-    // GL_LINEAR means we do bilinear interpolation
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Clean up dynamically allocated memory
-    delete[] data;
+// The display program of the tiles and panels, and the locations the render loop needs
+// from it (the single texture is drawn by a HeatmapRenderer, which has its own)
+struct DisplayProgram {
+    GLuint program;
+    GLint quadTransformLocation;
+    GLint texCoordTransformLocation;
+    GLint isolineCountLocation;
+    GLint isolineWidthLocation;
+};
+
+
+// Look up the locations in a freshly linked display program, make it current and set its uniforms
+void useDisplayProgram(DisplayProgram* display, GLuint program) {
+    display->program = program;
+    // The attributes don't need looking up: vertex_shader.glsl gives them fixed locations
+
+    // get location of the transform that places the quad on the screen
+    display->quadTransformLocation = glGetUniformLocation(program, "quadTransform");
+    display->texCoordTransformLocation = glGetUniformLocation(program, "texCoordTransform");
+    // and of the isoline overlay, which the render loop turns on and off
+    display->isolineCountLocation = glGetUniformLocation(program, "isolineCount");
+    display->isolineWidthLocation = glGetUniformLocation(program, "isolineWidth");
+
+    // Use the shader program
+    glUseProgram(program);
+
+    // texture units allow you to use multiple textures at the same time:
+    // the heatmap goes on unit 0, the colormap on 1 and the value range on 2
+    setDisplaySamplerUnits(program);
+    // scale (1, 1) and offset (0, 0): the quad covers the whole window
+    glUniform4f(display->quadTransformLocation, 1.0f, 1.0f, 0.0f, 0.0f);
+    glUniform4f(display->texCoordTransformLocation, 1.0f, 1.0f, 0.0f, 0.0f);
 }
 
 
-int main() {
+int main(int argc, char** argv) {
+    // --live regenerates the field every frame to exercise the streaming upload path
+    // --gpu-generate computes the field on the GPU instead of uploading it from the CPU
+    // --format r32f|r16f|r16|r8|bc4 picks the texel format (and with it the memory per texel);
+    //     bc4 block-compresses a single texture on the CPU and prints what that costs in quality
+    // --size WxH sets the size of the field
+    // --dirty-region SIZE with --live only regenerates and uploads two SIZE x SIZE squares per frame
+    // --panels N shows N small fields (each --size) in a grid, all drawn with one instanced draw call
+    // --tiled splits the field into tiles (automatic when it exceeds GL_MAX_TEXTURE_SIZE),
+    //     --tile-size and --vram-budget (in MB) control the tile pool
+    // --lod mean|max|min builds a mipmap pyramid so zoomed-out views don't alias
+    // --load FILE shows a field from a .npy, .hmf or raw float file (raw files need --size),
+    //     --prefetch starts reading the whole file in the background as soon as it is mapped
+    // --no-shader-cache always compiles the shaders instead of loading cached program binaries
+    // --value-range MIN,MAX maps a fixed range onto the colormap; by default the range of a
+    //     single-texture field is measured on the GPU after every update
+    // --colormap NAME|FILE picks blue-red, viridis, inferno, turbo or a custom colormap file;
+    //     the C key cycles through all of them
+    // --watch-shaders rebuilds the display program whenever its GLSL files are saved
+    // --continuous redraws every frame; by default a static field is only redrawn when
+    //     something changes (always continuous with --live)
+    // --listen PORT shows the fields a solver sends over TCP (as .hmf frames), always the newest one
+    // --shm NAME shows the fields a producer on this machine writes into a shared-memory ring
+    // --headless LIST renders every "INPUT OUTPUT.png" line of LIST offscreen and exits; INPUT is
+    //     a field file or rings[:PHASE], --output-size WxH sets the image size (default 600x600),
+    //     --encode-threads N the number of threads encoding the PNG/EXR files (default: all cores)
+    // --stats shows p50/p99 frame times and GPU timings in the window title,
+    //     --stats-csv FILE also logs every frame to a CSV file
+    // --play DIR|LIST plays the field files of a directory (sorted by name) or a list file,
+    //     --fps N sets the frame rate at 1x (default 30), --frame-cache MB the RAM cache
+    //     (default 2048) and --gpu-frames N the number of frames kept on the GPU (default 8)
+    // --wall COLSxROWS also shows the single-texture field across a grid of windows, one per
+    //     monitor when there are enough, each drawn on its own thread and swapped together
+    // --isolines N draws N contour lines evenly spaced over the value range (the I key
+    //     toggles them, with 10 lines if none were asked for), --isoline-width PX their width
+    bool liveUpdates = false;
+    bool gpuGenerate = false;
+    HeatmapFormat fieldFormat = HEATMAP_FORMAT_R32F;
+    int fieldWidth = 256;
+    int fieldHeight = 256;
+    int panelCount = 0;
+    int dirtyRegionSize = 0;
+    bool tiled = false;
+    int tileSize = 512;
+    int vramBudgetMB = 256;
+    bool lodEnabled = false;
+    LodReduction lodReduction = LOD_REDUCE_MEAN;
+    const char* loadPath = NULL;
+    bool prefetch = false;
+    bool useShaderCache = true;
+    bool watchShaders = false;
+    bool continuous = false;
+    const char* colormapChoice = "blue-red";
+    bool fixedRange = false;
+    float fixedMin = 0.0f, fixedMax = 1.0f;
+    bool showStats = false;
+    const char* headlessList = NULL;
+    int outputWidth = 600, outputHeight = 600;
+    int encodeThreads = 0;
+    int listenPort = 0;
+    const char* sharedName = NULL;
+    const char* statsCsvPath = NULL;
+    const char* playPath = NULL;
+    double playFps = 30.0;
+    int frameCacheMB = 2048;
+    int gpuFrames = 8;
+    int wallColumns = 0, wallRows = 0;
+    int isolineCount = 0;
+    float isolineWidth = 1.0f;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--live") {
+            liveUpdates = true;
+        } else if (arg == "--gpu-generate") {
+            gpuGenerate = true;
+        } else if (arg == "--format" && i + 1 < argc) {
+            if (!parseHeatmapFormat(argv[++i], &fieldFormat)) {
+                std::cerr << "Unknown texture format: " << argv[i] << " (expected r32f, r16f, r16, r8 or bc4)" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (!parseSize(argv[++i], &fieldWidth, &fieldHeight)) {
+                std::cerr << "Invalid field size: " << argv[i] << " (expected WIDTHxHEIGHT)" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--dirty-region" && i + 1 < argc) {
+            dirtyRegionSize = atoi(argv[++i]);
+        } else if (arg == "--panels" && i + 1 < argc) {
+            panelCount = atoi(argv[++i]);
+            if (panelCount <= 0) {
+                std::cerr << "Invalid panel count: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--lod" && i + 1 < argc) {
+            if (!parseLodReduction(argv[++i], &lodReduction)) {
+                std::cerr << "Unknown LOD reduction: " << argv[i] << " (expected mean, max or min)" << std::endl;
+                return -1;
+            }
+            lodEnabled = true;
+        } else if (arg == "--load" && i + 1 < argc) {
+            loadPath = argv[++i];
+        } else if (arg == "--prefetch") {
+            prefetch = true;
+        } else if (arg == "--no-shader-cache") {
+            useShaderCache = false;
+        } else if (arg == "--value-range" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%f,%f", &fixedMin, &fixedMax) != 2 || !(fixedMax > fixedMin)) {
+                std::cerr << "Invalid value range: " << argv[i] << " (expected MIN,MAX)" << std::endl;
+                return -1;
+            }
+            fixedRange = true;
+        } else if (arg == "--colormap" && i + 1 < argc) {
+            colormapChoice = argv[++i];
+        } else if (arg == "--continuous") {
+            continuous = true;
+        } else if (arg == "--headless" && i + 1 < argc) {
+            headlessList = argv[++i];
+        } else if (arg == "--output-size" && i + 1 < argc) {
+            if (!parseSize(argv[++i], &outputWidth, &outputHeight)) {
+                std::cerr << "Invalid output size: " << argv[i] << " (expected WIDTHxHEIGHT)" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--listen" && i + 1 < argc) {
+            listenPort = atoi(argv[++i]);
+            if (listenPort <= 0 || listenPort > 65535) {
+                std::cerr << "Invalid port: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--shm" && i + 1 < argc) {
+            sharedName = argv[++i];
+        } else if (arg == "--encode-threads" && i + 1 < argc) {
+            encodeThreads = atoi(argv[++i]);
+        } else if (arg == "--play" && i + 1 < argc) {
+            playPath = argv[++i];
+        } else if (arg == "--fps" && i + 1 < argc) {
+            playFps = atof(argv[++i]);
+            if (!(playFps > 0.0)) {
+                std::cerr << "Invalid frame rate: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--frame-cache" && i + 1 < argc) {
+            frameCacheMB = atoi(argv[++i]);
+        } else if (arg == "--gpu-frames" && i + 1 < argc) {
+            gpuFrames = atoi(argv[++i]);
+            if (gpuFrames <= 0) {
+                std::cerr << "Invalid number of GPU frames: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--stats") {
+            showStats = true;
+        } else if (arg == "--stats-csv" && i + 1 < argc) {
+            statsCsvPath = argv[++i];
+            showStats = true;
+        } else if (arg == "--watch-shaders") {
+            watchShaders = true;
+        } else if (arg == "--wall" && i + 1 < argc) {
+            if (!parseSize(argv[++i], &wallColumns, &wallRows) || wallColumns <= 0 || wallRows <= 0) {
+                std::cerr << "Invalid wall layout: " << argv[i] << " (expected COLUMNSxROWS)" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--isolines" && i + 1 < argc) {
+            isolineCount = atoi(argv[++i]);
+            if (isolineCount < 0) {
+                std::cerr << "Invalid number of isolines: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--isoline-width" && i + 1 < argc) {
+            isolineWidth = (float)atof(argv[++i]);
+            if (!(isolineWidth > 0.0f)) {
+                std::cerr << "Invalid isoline width: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--tiled") {
+            tiled = true;
+        } else if (arg == "--tile-size" && i + 1 < argc) {
+            tileSize = atoi(argv[++i]);
+        } else if (arg == "--vram-budget" && i + 1 < argc) {
+            vramBudgetMB = atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return -1;
+        }
+    }
+
+    if (panelCount > 0 && loadPath) {
+        std::cerr << "--panels shows generated fields and can't be combined with --load" << std::endl;
+        return -1;
+    }
+
+    // A batch renders single fields, one after the other, without a visible window
+    std::vector<BatchJob> batchJobs;
+    if (headlessList) {
+        if (panelCount > 0 || tiled || loadPath) {
+            std::cerr << "--headless takes its fields from the batch list and can't be combined with --panels, --tiled or --load" << std::endl;
+            return -1;
+        }
+        if (!readBatchList(headlessList, &batchJobs)) {
+            return -1;
+        }
+        liveUpdates = false;
+        gpuGenerate = false;
+        lodEnabled = false;
+    }
+
+    // Received fields replace the generated one in a single texture
+    if (listenPort > 0 || sharedName) {
+        if (panelCount > 0 || tiled || loadPath || headlessList || (listenPort > 0 && sharedName)) {
+            std::cerr << "--listen and --shm show single fields and can't be combined with each other or with "
+                      << "--panels, --tiled, --load or --headless" << std::endl;
+            return -1;
+        }
+        liveUpdates = false;
+        gpuGenerate = false;
+    }
+
+    // A recorded sequence is shown one frame at a time in a single texture; the first file
+    // decides the field size
+    std::vector<std::string> playPaths;
+    if (playPath) {
+        if (panelCount > 0 || tiled || loadPath || headlessList || listenPort > 0 || sharedName) {
+            std::cerr << "--play shows single fields and can't be combined with --panels, --tiled, --load, "
+                      << "--headless, --listen or --shm" << std::endl;
+            return -1;
+        }
+        if (!listFrameSequence(playPath, &playPaths)) {
+            return -1;
+        }
+        // Only the size of the first frame is needed here, and a compressed one has it in the header
+        CompressedFieldHeader compressed;
+        MappedField first;
+        if (isCompressedFieldFile(playPaths[0])) {
+            if (!readCompressedFieldFileHeader(playPaths[0].c_str(), &compressed)) {
+                return -1;
+            }
+            fieldWidth = (int)compressed.width;
+            fieldHeight = (int)compressed.height;
+        } else if (openMappedField(playPaths[0].c_str(), &first, false, fieldWidth, fieldHeight)) {
+            fieldWidth = first.width;
+            fieldHeight = first.height;
+            closeMappedField(&first);
+        } else {
+            return -1;
+        }
+        liveUpdates = false;
+        gpuGenerate = false;
+    }
+
+    // The shared ring's header decides the field size
+    SharedFieldRing sharedRing;
+    uint64_t sharedFrame = 0;
+    if (sharedName) {
+        if (!openSharedFieldRing(&sharedRing, sharedName)) {
+            return -1;
+        }
+        fieldWidth = (int)sharedRing.header->width;
+        fieldHeight = (int)sharedRing.header->height;
+    }
+
+    // Map the field file before anything else, its header decides the field size
+    // (or decode it, if it is compressed; the decoded values stay in loadedFrame)
+    MappedField loadedField;
+    loadedField.data = NULL;
+    CachedFrame loadedFrame;
+    if (loadPath) {
+        if (!openFieldFile(loadPath, &loadedField, &loadedFrame, prefetch, fieldWidth, fieldHeight)) {
+            return -1;
+        }
+        fieldWidth = loadedField.width;
+        fieldHeight = loadedField.height;
+        // A file doesn't change, so there is nothing to regenerate
+        liveUpdates = false;
+        gpuGenerate = false;
+    }
+
     // Initialize the GLFW system, which is responsible for creating the window and handling user input.
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return -1;
     }
-    // Want to use OpenGL version 2.1
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    // Want to use OpenGL version 3.3 with the core profile, which drops the legacy API
+    // (forward compatibility is what macOS needs to hand out a core context at all)
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    // A batch only needs the context; the window is never shown
+    if (headlessList) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
     // Create a window where our OpenGL graphics will be displayed
     GLFWwindow* window = glfwCreateWindow(600, 600, "OpenGL Heatmap", NULL, NULL);
     if (!window) {
@@ -166,14 +681,132 @@ int main() {
     // Make the OpenGL context current
     glfwMakeContextCurrent(window);
 
-    // Initialize GLEW, which gives us access to all the OpenGL functions we need
+    // The callbacks tell the render loop when the picture has to be drawn again
+    ViewerState viewer;
+    viewer.needsRedraw = true;
+    viewer.colormapSteps = 0;
+    viewer.togglePause = false;
+    viewer.reverse = false;
+    viewer.frameSteps = 0;
+    viewer.speed = 0;
+    viewer.zoomSteps = 0.0;
+    viewer.zoomX = viewer.zoomY = 0.5f;
+    viewer.dragging = false;
+    viewer.dragX = viewer.dragY = 0.0;
+    viewer.panX = viewer.panY = 0.0;
+    viewer.resetView = false;
+    viewer.toggleIsolines = false;
+    glfwSetWindowUserPointer(window, &viewer);
+    glfwSetFramebufferSizeCallback(window, onFramebufferSize);
+    glfwSetWindowRefreshCallback(window, onWindowRefresh);
+    glfwSetKeyCallback(window, onKey);
+    glfwSetScrollCallback(window, onScroll);
+    glfwSetMouseButtonCallback(window, onMouseButton);
+    glfwSetCursorPosCallback(window, onCursorPos);
+
+    // Initialize GLEW, which gives us access to all the OpenGL functions we need.
+    // In a core profile GLEW only finds the functions when it is allowed to look them up
+    // directly, and its extension query leaves a harmless GL_INVALID_ENUM behind.
+    glewExperimental = GL_TRUE;
     if (glewInit() != GLEW_OK) {
         std::cerr << "Failed to initialize GLEW" << std::endl;
         return -1;
     }
+    glGetError();
 
-    // Build and compile shader program
-    GLuint shaderProgram = createShaderProgram();
+    // A single texture can't be larger than the driver's limit; beyond that we need tiles
+    GLint maxTextureSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (panelCount > 0) {
+        tiled = false; // Every panel is its own small layer
+    } else if ((headlessList || playPath) && (fieldWidth > maxTextureSize || fieldHeight > maxTextureSize)) {
+        std::cerr << (headlessList ? "--headless" : "--play") << " fields can't be larger than GL_MAX_TEXTURE_SIZE ("
+                  << maxTextureSize << ")" << std::endl;
+        glfwTerminate();
+        return -1;
+    } else if (!tiled && (fieldWidth > maxTextureSize || fieldHeight > maxTextureSize)) {
+        std::cout << "Field is larger than GL_MAX_TEXTURE_SIZE (" << maxTextureSize << "), using tiles" << std::endl;
+        tiled = true;
+    }
+    if (tiled && (tileSize < 3 || tileSize > maxTextureSize)) {
+        std::cerr << "Tile size must be between 3 and " << maxTextureSize << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    // A block-compressed field is one texture, uploaded whole from the CPU: shaders can't write
+    // into it, so there is no GPU generation or mipmap pyramid either
+    if (heatmapFormatIsCompressed(fieldFormat)) {
+        if (panelCount > 0 || tiled) {
+            std::cerr << "--format bc4 needs a single texture and can't be combined with --panels or tiles" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        if (!GLEW_VERSION_3_0 && !GLEW_ARB_texture_compression_rgtc) {
+            std::cout << "No RGTC texture support, using r8 instead of bc4" << std::endl;
+            fieldFormat = HEATMAP_FORMAT_R8;
+        }
+        if (gpuGenerate || lodEnabled) {
+            std::cout << "--gpu-generate and --lod need an uncompressed texture and are off with bc4" << std::endl;
+        }
+        gpuGenerate = false;
+        lodEnabled = false;
+    }
+
+    // The wall windows each draw their part of one texture
+    if (wallColumns > 0 && (panelCount > 0 || tiled || headlessList)) {
+        std::cerr << "--wall shows a single texture and can't be combined with --panels, tiles or --headless" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    // Start building the shader program. The driver compiles it in the background (or loads
+    // it from the binary cache) while we set up buffers and upload the field below.
+    if (!useShaderCache) {
+        setShaderCacheDirectory(NULL);
+    }
+    enableParallelShaderCompile();
+    double shaderStart = glfwGetTime();
+    // A single heatmap texture is drawn by a HeatmapRenderer, which builds its own program
+    // (with the attribute-less fullscreen triangle, no vertex data at all); tiles need the
+    // quad and its transform, panels their instances
+    bool singleTexture = !tiled && panelCount == 0;
+    const char* displayVertexShader = tiled ? "vertex_shader.glsl" : "fullscreen_triangle.glsl";
+    const char* displayDefines = NULL;
+    if (panelCount > 0) {
+        displayVertexShader = "panel_vertex.glsl";
+        displayDefines = HEATMAP_PANEL_DEFINES;
+    }
+    ProgramBuild displayBuild;
+    if (!singleTexture) {
+        beginShaderProgramBuild(&displayBuild, displayVertexShader, "fragment_shader.glsl", displayDefines);
+    }
+
+    // One lookup texture per colormap: switching colormaps only binds another texture.
+    // A choice that isn't a built-in name is read as a colormap file and joins the cycle.
+    std::vector<Colormap> colormaps;
+    int currentColormap = -1;
+    const std::vector<std::string>& colormapNames = builtinColormapNames();
+    for (size_t i = 0; i < colormapNames.size(); ++i) {
+        std::vector<float> rgb;
+        Colormap colormap;
+        if (builtinColormap(colormapNames[i], &rgb) && createColormap(&colormap, colormapNames[i], rgb)) {
+            if (colormapNames[i] == colormapChoice) {
+                currentColormap = (int)colormaps.size();
+            }
+            colormaps.push_back(colormap);
+        }
+    }
+    if (currentColormap < 0) {
+        std::vector<float> rgb;
+        Colormap colormap;
+        if (!loadColormapFile(colormapChoice, &rgb) || !createColormap(&colormap, colormapChoice, rgb)) {
+            glfwTerminate();
+            return -1;
+        }
+        currentColormap = (int)colormaps.size();
+        colormaps.push_back(colormap);
+    }
 
     // Defining the shape to render
     // Set up vertex data and buffers and configure vertex attributes
@@ -189,6 +822,12 @@ int main() {
         0, 2, 3  // Second triangle
     };
 
+    // A Vertex Array Object (VAO) remembers the buffers and the attribute layout set up below,
+    // so drawing later only needs to bind it again instead of repeating all of these calls
+    GLuint VAO;
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+
     // Generate and bind VBO and EBO
     // Vertex Buffer Object (VBO) sotres vertex data on the GPU
     // It's much faster to sotre data on the GPU than to send it from CPU every frame
@@ -207,78 +846,647 @@ int main() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    // Generate a 256x256 scalar field
-    GLuint heatmapTexture;
-    generateHeatmapTexture(&heatmapTexture, 256, 256); 
+    // Enable vertex attribute arrays
+    // Tells OpenGL that we will provide data for this attribute
+    // aPos and aTexCoord have fixed locations 0 and 1 in vertex_shader.glsl
+    glEnableVertexAttribArray(0);
+    // tells OpenGL how to interpret the vertex data stored in the currently bound GL_ARRAY_BUFFER (VBO)
+    // 0: Which attribute in the shader to map this data to (aPos).
+    // 2: The number of components per vertex (e.g., x and y for 2D positions)
+    // GL_FLOAT: The data type
+    // 4 * sizeof(float): The stride, which tells OpenGL how far apart consecutive vertices are in the buffer
+    // (void*)0: no offset
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    // similarly for aTexCoord
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    // Done recording; the VAO keeps the EBO binding and both attribute arrays
+    glBindVertexArray(0);
 
-    // Get attribute locations in the shader
-    // For us to be able to refer to and link these per-vertex attributes
-    // in the vertex shader, so we can pass data from c++ code to vertex shader
-    GLuint posAttrib = glGetAttribLocation(shaderProgram, "aPos");
-    GLuint texAttrib = glGetAttribLocation(shaderProgram, "aTexCoord");
+    // Worker threads for the field generator, and the ring pattern it draws
+    ThreadPool generatorPool;
+    RingParams ringParams = defaultRingParams();
+    if (fieldFormat == HEATMAP_FORMAT_R16 || fieldFormat == HEATMAP_FORMAT_R8 || fieldFormat == HEATMAP_FORMAT_BC4) {
+        // Normalized integers can't hold negative values: generate [0, 1] instead of [-1, 1]
+        ringParams.amplitude = 0.5f;
+        ringParams.offset = 0.5f;
+    }
+    // Fields generated on the CPU for packing; the block comes from the shared field buffer
+    // pool, so changing sizes or restarting a batch reuses memory that is already faulted in
+    FieldBuffer generatorScratch;
+
+    // Time spent producing the first field, however it is produced
+    double generateStart = glfwGetTime();
+    HeatmapRenderer heatmap;
+    TiledHeatmap tiledHeatmap;
+    GpuFieldGenerator gpuGenerator;
+    LodPyramid lodPyramid;
+    HeatmapPanels heatmapPanels;
+    PlaybackTextures playbackTextures;
+    GLuint playbackTexture = 0;     // The texture of the frame on screen, 0 when not playing
+    if (panelCount > 0) {
+        // All panels go into the layers of one array texture
+        if (!createHeatmapPanels(&heatmapPanels, fieldWidth, fieldHeight, panelCount, fieldFormat)) {
+            glfwTerminate();
+            return -1;
+        }
+        fillHeatmapPanels(&heatmapPanels, generatorScratch, ringParams, 0.0f, &generatorPool);
+        // Panels are regenerated on the CPU and have no mipmaps
+        gpuGenerate = false;
+        lodEnabled = false;
+    } else if (tiled) {
+        // Tiles are generated on demand, each one as a rectangle of the full-size field,
+        // or copied out of the mapped file (which only reads the pages of that rectangle)
+        TileSource tileSource = [&](int originX, int originY, int width, int height, float* out, int stride) {
+            if (loadedField.data) {
+                for (int y = 0; y < height; ++y) {
+                    const float* row = loadedField.data + (size_t)(originY + y) * fieldWidth + originX;
+                    memcpy(out + (size_t)y * stride, row, width * sizeof(float));
+                }
+            } else {
+                generateRingRegion(out, stride, originX, originY, width, height, fieldWidth, fieldHeight,
+                                   ringParams, &generatorPool);
+            }
+        };
+        if (!createTiledHeatmap(&tiledHeatmap, fieldWidth, fieldHeight, tileSize,
+                                (size_t)vramBudgetMB * 1024 * 1024, fieldFormat, tileSource)) {
+            glfwTerminate();
+            return -1;
+        }
+        // Tiles don't support the streaming modes or mipmaps
+        liveUpdates = false;
+        gpuGenerate = false;
+        lodEnabled = false;
+    } else {
+        // Allocate the texture for the scalar field (with a full mipmap chain for --lod)
+        // and the pixel buffers that feed it
+        if (lodEnabled && !createLodPyramid(&lodPyramid, lodReduction)) {
+            lodEnabled = false;
+        }
+        HeatmapRendererOptions heatmapOptions;
+        heatmapOptions.width = fieldWidth;
+        heatmapOptions.height = fieldHeight;
+        heatmapOptions.format = fieldFormat;
+        heatmapOptions.levels = lodEnabled ? lodLevelCount(fieldWidth, fieldHeight) : 1;
+        heatmapOptions.colormap = colormaps[currentColormap].name;
+        if (!heatmap.create(heatmapOptions)) {
+            glfwTerminate();
+            return -1;
+        }
+        // Otherwise its range is measured on the GPU after every change
+        if (fixedRange) {
+            heatmap.setValueRange(fixedMin, fixedMax);
+        }
 
-    // get location of the uniform variable heatmapTexture from the shader program
-    GLint uniformLocation = glGetUniformLocation(shaderProgram, "heatmapTexture");
+        // The GPU generator writes into the texture directly; fall back to the CPU if it can't be built
+        if (gpuGenerate && !createGpuFieldGenerator(&gpuGenerator, fieldFormat)) {
+            gpuGenerate = false;
+        }
 
-    // Use the shader program
-    glUseProgram(shaderProgram);
+        if (loadedField.data) {
+            // Pages go from the mapping straight into the pixel buffer
+            heatmap.upload(loadedField.data, &generatorPool);
+            if (heatmapFormatIsCompressed(fieldFormat)) {
+                printRgtcQuality(loadedField.data, fieldWidth, fieldHeight, &generatorPool);
+            }
+        } else if (playPath) {
+            // Recorded frames go through the stream's pixel buffers into a ring of textures of
+            // their own. The first one is read right away, so the window doesn't open empty.
+            CachedFrame first;
+            if (!createPlaybackTextures(&playbackTextures, heatmap.textureStream(), gpuFrames) ||
+                !loadFieldFrame(playPaths[0], fieldWidth, fieldHeight, &first)) {
+                heatmap.destroy();
+                glfwTerminate();
+                return -1;
+            }
+            playbackTexture = uploadPlaybackTexture(&playbackTextures, heatmap.textureStream(), 0, first.data.data(),
+                                                    &generatorPool);
+            if (!playbackTexture) {
+                std::cerr << "Failed to upload the first frame" << std::endl;
+                heatmap.destroy();
+                glfwTerminate();
+                return -1;
+            }
+            heatmap.showTexture(playbackTexture);
+            if (heatmapFormatIsCompressed(fieldFormat)) {
+                printRgtcQuality(first.data.data(), fieldWidth, fieldHeight, &generatorPool);
+            }
+        } else if (gpuGenerate) {
+            generateRingFieldGPU(&gpuGenerator, heatmap.texture(), fieldWidth, fieldHeight, ringParams);
+            heatmap.textureChanged();
+        } else {
+            streamRingField(&heatmap, generatorScratch, ringParams, &generatorPool);
+            if (heatmapFormatIsCompressed(fieldFormat)) {
+                // Only floats are generated in place; every other format leaves the field in scratch
+                printRgtcQuality(generatorScratch.data(), fieldWidth, fieldHeight, &generatorPool);
+            }
+        }
+        if (lodEnabled) {
+            buildLodPyramid(&lodPyramid, heatmap.shownTexture(), fieldWidth, fieldHeight, heatmap.levels());
+        }
+    }
+    if (!tiled) {
+        // Tiles are produced on demand while drawing instead
+        std::cout << "Field generated and uploaded in " << (glfwGetTime() - generateStart) * 1000.0 << " ms" << std::endl;
+    }
+
+    // The range of a single texture is measured by the renderer. Tiles and panels aren't in
+    // one texture, so they show the range they were generated with (or [0, 1] for files).
+    ValueRange valueRange;
+    clearValueRange(&valueRange);
+    if (!singleTexture) {
+        createValueRange(&valueRange, 1, 1);
+        if (fixedRange) {
+            setFixedValueRange(&valueRange, fixedMin, fixedMax);
+        } else if (!loadedField.data) {
+            setFixedValueRange(&valueRange, ringParams.offset - ringParams.amplitude,
+                               ringParams.offset + ringParams.amplitude);
+        }
+    }
+
+    // Now we need the program: wait for it if it isn't ready yet
+    DisplayProgram display;
+    display.program = 0;
+    bool programFromCache;
+    if (singleTexture) {
+        heatmap.finishProgram();
+        programFromCache = heatmap.programFromCache();
+    } else {
+        useDisplayProgram(&display, finishProgramBuild(&displayBuild));
+        programFromCache = displayBuild.fromCache;
+    }
+    std::cout << "Shader program ready after " << (glfwGetTime() - shaderStart) * 1000.0 << " ms"
+              << (programFromCache ? " (from binary cache)" : "") << std::endl;
+
+    // Shader files are watched on a background thread; the rebuild itself happens in the render loop
+    ShaderWatcher shaderWatcher;
+    ProgramBuild reloadBuild;
+    bool reloading = false;
+    if (watchShaders) {
+        std::vector<std::string> shaderFiles;
+        shaderFiles.push_back(displayVertexShader);
+        shaderFiles.push_back("fragment_shader.glsl");
+        // Wake the render loop up if it is waiting for events
+        if (shaderWatcher.start(shaderFiles, glfwPostEmptyEvent)) {
+            std::cout << "Watching the display shaders for changes" << std::endl;
+            if (!hasParallelShaderCompile()) {
+                std::cout << "No KHR_parallel_shader_compile: the frame that picks up a reload waits for the compiler"
+                          << std::endl;
+            }
+        }
+    }
 
-    // texture units allow you to use multiple textures at the same time
-    // tell the shader to use texture unit 0 for "heatmapTexture"
-    glUniform1i(uniformLocation, 0);
+    // The wall windows share this context's textures, so the field is still uploaded only once
+    DisplayWall displayWall;
+    if (wallColumns > 0 && !displayWall.start(window, wallColumns, wallRows, displayVertexShader, "fragment_shader.glsl")) {
+        std::cerr << "Failed to open the display wall, showing only the main window" << std::endl;
+        wallColumns = 0;
+    }
+    for (int i = 0; i < displayWall.windowCount(); ++i) {
+        // Keys pressed on the wall work like in the main window; pan and zoom stay with the main window
+        glfwSetWindowUserPointer(displayWall.window(i), &viewer);
+        glfwSetWindowRefreshCallback(displayWall.window(i), onWindowRefresh);
+        glfwSetKeyCallback(displayWall.window(i), onKey);
+    }
+
+    // Batch mode: render the list offscreen and skip the render loop
+    int exitCode = 0;
+    if (headlessList) {
+        // Images are encoded and written on the pipeline's threads while the next ones render
+        ExportPipeline exportPipeline(encodeThreads > 0 ? (unsigned)encodeThreads : 0);
+        OffscreenTarget offscreenTarget;
+        if (createOffscreenTarget(&offscreenTarget, outputWidth, outputHeight, &exportPipeline)) {
+            heatmap.setIsolines(isolineCount, isolineWidth);
+            double batchStart = glfwGetTime();
+            int failures = renderBatch(batchJobs, &offscreenTarget, &heatmap, ringParams, fieldWidth, fieldHeight,
+                                       generatorScratch, &generatorPool);
+            failures += exportPipeline.finish();
+            std::cout << "Rendered " << batchJobs.size() - failures << " of " << batchJobs.size() << " images in "
+                      << (glfwGetTime() - batchStart) * 1000.0 << " ms with " << exportPipeline.encoderCount()
+                      << " encoder threads" << std::endl;
+            exitCode = failures > 0 ? 1 : 0;
+            destroyOffscreenTarget(&offscreenTarget);
+        } else {
+            exitCode = 1;
+        }
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+
+    // Fields from a remote solver arrive on the ingest thread, which wakes the loop up for each one
+    FrameIngest frameIngest;
+    if (listenPort > 0) {
+        if (frameIngest.start(listenPort, glfwPostEmptyEvent)) {
+            std::cout << "Listening for fields on port " << listenPort << std::endl;
+        } else {
+            listenPort = 0;
+        }
+    }
+
+    // Playback: background threads load the frames ahead of the playhead into RAM and wake
+    // the loop up for each one
+    FrameCache frameCache;
+    PlaybackClock playClock;
+    int playFrame = 0;              // The frame on screen
+    int missedFrame = -1;           // The last frame that wasn't loaded when it was due
+    int missedFrames = 0;
+    if (playPath) {
+        if (!frameCache.start(playPaths, fieldWidth, fieldHeight, (size_t)frameCacheMB * 1024 * 1024, 0,
+                              glfwPostEmptyEvent)) {
+            // Its GL objects have to go while the context is still there
+            heatmap.destroy();
+            glfwTerminate();
+            return -1;
+        }
+        initPlaybackClock(&playClock, (int)playPaths.size(), playFps);
+        std::cout << "Playing " << playPaths.size() << " frames at " << playFps << " fps, " << frameCache.capacity()
+                  << " of them fit into the frame cache" << std::endl;
+    }
+    double playTime = glfwGetTime();
+
+    // Frame timing: CPU clocks plus GPU timer queries that are read back a few frames later
+    FrameStats frameStats;
+    if (showStats && !createFrameStats(&frameStats, statsCsvPath)) {
+        showStats = false;
+    }
+    double statsTitleTime = glfwGetTime();
+
+    // Live data changes every frame, so there is never a frame to skip
+    if (liveUpdates) {
+        continuous = true;
+    }
+
+    // Isolines are drawn by the display shader; I toggles them
+    bool isolinesShown = isolineCount > 0;
+    int isolineLevels = isolineCount > 0 ? isolineCount : 10;
+
+    // Pan and zoom, relative to the backend's default view
+    ViewTransform viewTransform;
+    resetViewTransform(&viewTransform);
 
     // Main render loop
-    while (!glfwWindowShouldClose(window)) {
+    while (!glfwWindowShouldClose(window) && !displayWall.shouldClose()) {
+        // Hot reload: start compiling as soon as a file changes, then check back every frame.
+        // The old program keeps drawing until the new one has linked, and a shader with errors
+        // never replaces a working one. With KHR_parallel_shader_compile a slow compile never
+        // stalls a frame; without it the next frame waits for the compile and link.
+        if (!reloading && shaderWatcher.consumeChanges()) {
+            beginShaderProgramBuild(&reloadBuild, displayVertexShader, "fragment_shader.glsl", displayDefines);
+            reloading = true;
+        }
+        if (reloading && isProgramBuildReady(&reloadBuild)) {
+            reloading = false;
+            GLuint reloaded = finishProgramBuild(&reloadBuild);
+            if (reloadBuild.linked) {
+                if (singleTexture) {
+                    heatmap.setProgram(reloaded);
+                } else {
+                    glDeleteProgram(display.program);
+                    useDisplayProgram(&display, reloaded);
+                }
+                // The wall windows have programs of their own
+                if (displayWall.windowCount() > 0 &&
+                    !displayWall.reloadProgram(displayVertexShader, "fragment_shader.glsl")) {
+                    std::cerr << "Shader reload failed on the display wall, it keeps the previous program" << std::endl;
+                }
+                viewer.needsRedraw = true;
+                std::cout << "Reloaded the display shaders" << std::endl;
+            } else {
+                glDeleteProgram(reloaded);
+                std::cerr << "Shader reload failed, keeping the previous program" << std::endl;
+            }
+        }
+
+        // Switch to the next colormap for every press of C
+        if (viewer.colormapSteps > 0) {
+            currentColormap = (currentColormap + viewer.colormapSteps) % (int)colormaps.size();
+            viewer.colormapSteps = 0;
+            viewer.needsRedraw = true;
+            if (singleTexture) {
+                heatmap.setColormap(colormaps[currentColormap].name);
+            }
+            std::cout << "Colormap: " << colormaps[currentColormap].name << std::endl;
+        }
+
+        // I turns the isolines on and off
+        if (viewer.toggleIsolines) {
+            viewer.toggleIsolines = false;
+            isolinesShown = !isolinesShown;
+            viewer.needsRedraw = true;
+        }
+        float isolines = isolinesShown ? (float)isolineLevels : 0.0f;
+
+        // Pan and zoom. The default view shows the whole texture, or tiles at one texel per
+        // pixel; zooming stops at 64 pixels per texel, and for tiles where the view would
+        // need more tiles than the pool holds. Panels stay in their grid.
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        int windowWidth = framebufferWidth;
+        int windowHeight = framebufferHeight;
+        if (wallColumns > 0) {
+            // The view is shown on the wall, so it has the wall's pixels (for zoom and LOD)
+            displayWall.framebufferSize(&framebufferWidth, &framebufferHeight);
+        }
+        TextureRect defaultView = { 0.0f, 0.0f, 1.0f, 1.0f };
+        if (tiled) {
+            defaultView = centeredView(fieldWidth, fieldHeight, framebufferWidth, framebufferHeight);
+        }
+        if (panelCount == 0 && (viewer.zoomSteps != 0.0 || viewer.panX != 0.0 || viewer.panY != 0.0 ||
+                                viewer.resetView)) {
+            ViewTransform previous = viewTransform;
+            int windowWidth, windowHeight;
+            glfwGetWindowSize(window, &windowWidth, &windowHeight);
+            if (viewer.resetView) {
+                resetViewTransform(&viewTransform);
+            }
+            if (viewer.zoomSteps != 0.0) {
+                float maxZoom = std::max(1.0f, (defaultView.u1 - defaultView.u0) * fieldWidth * 64.0f /
+                                               std::max(framebufferWidth, 1));
+                zoomViewTransform(&viewTransform, defaultView, (float)std::pow(1.25, viewer.zoomSteps), viewer.zoomX,
+                                  viewer.zoomY, 0.25f, maxZoom);
+            }
+            if (windowWidth > 0 && windowHeight > 0) {
+                panViewTransform(&viewTransform, defaultView, (float)(viewer.panX / windowWidth),
+                                 (float)(-viewer.panY / windowHeight));
+            }
+            if (tiled && countTilesInView(&tiledHeatmap, viewTransformRect(viewTransform, defaultView)) >
+                             tiledHeatmapCapacity(&tiledHeatmap)) {
+                viewTransform = previous;
+            }
+            viewer.zoomSteps = 0.0;
+            viewer.panX = viewer.panY = 0.0;
+            viewer.resetView = false;
+            viewer.needsRedraw = true;
+        }
+        TextureRect view = viewTransformRect(viewTransform, defaultView);
+
+        // Show the newest received field; frames that arrived in between are skipped
+        IngestFrame* ingested = listenPort > 0 ? frameIngest.takeLatest() : NULL;
+        if (ingested) {
+            int levels = lodEnabled ? lodLevelCount(ingested->width, ingested->height) : 1;
+            if (heatmap.resize(ingested->width, ingested->height, levels)) {
+                fieldWidth = ingested->width;
+                fieldHeight = ingested->height;
+                heatmap.upload(ingested->data.data(), &generatorPool);
+                if (lodEnabled) {
+                    buildLodPyramidForView(&lodPyramid, heatmap.texture(), fieldWidth, fieldHeight, levels, view,
+                                           framebufferWidth, framebufferHeight);
+                }
+            }
+            frameIngest.release(ingested);
+            viewer.needsRedraw = true;
+        }
+
+        // The newest complete frame of the shared ring goes from shared memory straight into a
+        // pixel buffer: the only copy it takes from the producer to the GPU
+        if (sharedName && readLatestSharedField(&sharedRing, sharedFrame, &sharedFrame, [&](const float* data) {
+                heatmap.upload(data, &generatorPool);
+            })) {
+            if (lodEnabled) {
+                buildLodPyramidForView(&lodPyramid, heatmap.texture(), fieldWidth, fieldHeight, heatmap.levels(), view,
+                                       framebufferWidth, framebufferHeight);
+            }
+            viewer.needsRedraw = true;
+        }
+
+        // Move the playhead on and show the frame it is on as soon as that is in memory; the
+        // cache meanwhile loads the next couple of seconds in the direction of play
+        if (playPath) {
+            if (viewer.togglePause) {
+                viewer.togglePause = false;
+                playClock.paused = !playClock.paused;
+                std::cout << (playClock.paused ? "Paused" : "Playing") << " at frame " << playFrame << std::endl;
+            }
+            if (viewer.reverse) {
+                viewer.reverse = false;
+                playClock.direction = -playClock.direction;
+            }
+            if (viewer.speed > 0) {
+                playClock.speed = viewer.speed;
+                viewer.speed = 0;
+                std::cout << "Playback speed " << playClock.speed << "x" << std::endl;
+            }
+            if (viewer.frameSteps != 0) {
+                // Stepping pauses, so the frame stays put for a closer look
+                playClock.paused = true;
+                stepPlaybackClock(&playClock, viewer.frameSteps);
+                viewer.frameSteps = 0;
+            }
+            double now = glfwGetTime();
+            int frame = advancePlaybackClock(&playClock, now - playTime);
+            playTime = now;
+            // Faster than the display (taken as 60 Hz) only every step-th frame can be seen:
+            // show and load just those
+            int step = playClock.paused ? 1 : std::max(1, (int)(playClock.fps * playClock.speed / 60.0));
+            frame -= frame % step;
+            frameCache.setPlayhead(frame, playClock.direction, (int)(2.0 * playClock.fps * playClock.speed / step) + 2,
+                                   step);
+            if (frame != playFrame) {
+                GLuint texture = findPlaybackTexture(&playbackTextures, frame);
+                if (!texture) {
+                    std::shared_ptr<const CachedFrame> cached = frameCache.get(frame);
+                    if (cached) {
+                        texture = uploadPlaybackTexture(&playbackTextures, heatmap.textureStream(), frame,
+                                                        cached->data.data(), &generatorPool);
+                        // 0 if it couldn't be uploaded: the previous frame stays and this one is tried again
+                        if (texture && lodEnabled) {
+                            buildLodPyramid(&lodPyramid, texture, fieldWidth, fieldHeight, heatmap.levels());
+                        }
+                    }
+                }
+                if (texture) {
+                    playbackTexture = texture;
+                    playFrame = frame;
+                    heatmap.showTexture(playbackTexture);
+                    viewer.needsRedraw = true;
+                } else if (frame != missedFrame) {
+                    // Keep showing the previous frame and keep time
+                    missedFrame = frame;
+                    ++missedFrames;
+                }
+            }
+        }
+
+        // Nothing changed since the last frame: sleep until an event arrives instead of
+        // drawing the same picture again. A pending shader rebuild still gets checked on, and
+        // the shared ring, which can't wake us up, is polled at about 250 Hz.
+        if (!continuous && !viewer.needsRedraw) {
+            if (sharedName) {
+                glfwWaitEventsTimeout(0.004);
+            } else if (playPath && !playClock.paused) {
+                // Until the next frame is due; a frame finishing its load wakes us up as well
+                glfwWaitEventsTimeout(std::max(playbackSecondsToNextFrame(&playClock), 0.001));
+            } else if (reloading) {
+                glfwWaitEventsTimeout(0.02);
+            } else {
+                glfwWaitEvents();
+            }
+            continue;
+        }
+        viewer.needsRedraw = false;
+        if (showStats) {
+            beginFrameStats(&frameStats, glfwGetTime());
+            beginGpuSection(&frameStats, GPU_SECTION_UPLOAD);
+        }
+        double updateStart = glfwGetTime();
+
+        // Stream the next frame. The copy into the texture is queued behind the previous draw,
+        // so filling the pixel buffer here overlaps with the GPU still rendering the last frame.
+        if (liveUpdates && gpuGenerate) {
+            ringParams.phase = (float)glfwGetTime();
+            generateRingFieldGPU(&gpuGenerator, heatmap.texture(), fieldWidth, fieldHeight, ringParams);
+            heatmap.textureChanged();
+        } else if (liveUpdates && panelCount > 0) {
+            fillHeatmapPanels(&heatmapPanels, generatorScratch, ringParams, (float)glfwGetTime(), &generatorPool);
+        } else if (liveUpdates && dirtyRegionSize > 0) {
+            ringParams.phase = (float)glfwGetTime();
+            streamDirtyRegions(&heatmap, generatorScratch, ringParams, dirtyRegionSize,
+                               (float)glfwGetTime(), &generatorPool);
+        } else if (liveUpdates) {
+            ringParams.phase = (float)glfwGetTime();
+            streamRingField(&heatmap, generatorScratch, ringParams, &generatorPool);
+        }
+        if (liveUpdates && lodEnabled) {
+            // The lower levels are derived from level 0, so they follow every new frame;
+            // only as far as the view samples them
+            buildLodPyramidForView(&lodPyramid, heatmap.texture(), fieldWidth, fieldHeight, heatmap.levels(), view,
+                                   framebufferWidth, framebufferHeight);
+        } else if (lodEnabled && !playbackTexture &&
+                   !lodPyramidCoversView(&lodPyramid, heatmap.texture(), fieldWidth, fieldHeight, heatmap.levels(),
+                                         view, framebufferWidth, framebufferHeight)) {
+            // A received field was built for the view before panning or zooming out
+            buildLodPyramidForView(&lodPyramid, heatmap.texture(), fieldWidth, fieldHeight, heatmap.levels(), view,
+                                   framebufferWidth, framebufferHeight);
+        }
+        if (singleTexture) {
+            // Measured here rather than in the draw, so the stats count it as part of the update
+            heatmap.updateValueRange();
+        }
+        if (showStats) {
+            // CPU side of the update: generating the field (or queuing the GPU passes)
+            addGenerateTime(&frameStats, (glfwGetTime() - updateStart) * 1000.0);
+            endGpuSection(&frameStats);
+            beginGpuSection(&frameStats, GPU_SECTION_DRAW);
+        }
+
         // Clear the screen
         glClear(GL_COLOR_BUFFER_BIT);
 
-        // Activating a the texture unit, ensure that the operations we're going to perform
-        // will affect the currently active unit
-        glActiveTexture(GL_TEXTURE0);
-        // bind the heatmap texture to the active texture unit 
-        glBindTexture(GL_TEXTURE_2D, heatmapTexture);
-
-        // Enable vertex attribute arrays
-        // Tells OpenGL that we will provide data for this attribute
-        glEnableVertexAttribArray(posAttrib);
-        // tells OpenGL how to interpret the vertex data stored in the currently bound GL_ARRAY_BUFFER (VBO)
-        // posAttrib: Which attribute in the shader to map this data to.
-        // 2: The number of components per vertex (e.g., x and y for 2D positions)
-        // GL_FLOAT: The data type
-        // 4 * sizeof(float): The stride, which tells OpenGL how far apart consecutive vertices are in the buffer
-        // (void*)0: no offset
-        glVertexAttribPointer(posAttrib, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-        // similarly for texAttrib
-        glEnableVertexAttribArray(texAttrib);
-        glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-
-        // Tell OpenGL to draw the actual shape (2 triangles, a quad)
-        // 1. the primitive type to draw is GL_TRIANGLES
-        // 2. number of indices to read from the index buffer: 6
-        // 3. data type of the indices is GL_UNSIGNED_INT
-        // 4. no offset
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // After finish using them for rendering
-        // tell OpenGL not to expect or use data for these attributes
-        glDisableVertexAttribArray(posAttrib);
-        glDisableVertexAttribArray(texAttrib);
+        if (singleTexture) {
+            // One triangle covering the whole window, showing the part of the texture in view
+            heatmap.setView(view);
+            heatmap.setIsolines(isolinesShown ? isolineLevels : 0, isolineWidth);
+            heatmap.render(0, 0, 0, windowWidth, windowHeight);
+        } else {
+            // The colormap goes on texture unit 1
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_1D, colormaps[currentColormap].texture);
+            // and the value range on unit 2
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, valueRange.result);
+            // Activating a the texture unit, ensure that the operations we're going to perform
+            // will affect the currently active unit
+            glActiveTexture(GL_TEXTURE0);
+            glUniform1f(display.isolineCountLocation, isolines);
+            glUniform1f(display.isolineWidthLocation, isolineWidth);
+        }
+        if (panelCount > 0) {
+            // Every panel in one instanced draw call
+            drawHeatmapPanels(&heatmapPanels);
+        } else if (tiled) {
+            // Make the visible tiles resident and draw each one as its own quad
+            // binding the VAO brings back the buffers and attribute layout recorded at startup
+            glBindVertexArray(VAO);
+            // Tiles that didn't fit into this frame's upload budget need another frame
+            if (updateTiledHeatmap(&tiledHeatmap, view) > 0) {
+                viewer.needsRedraw = true;
+            }
+            drawTiledHeatmap(&tiledHeatmap, view, display.quadTransformLocation, display.texCoordTransformLocation,
+                             framebufferWidth, framebufferHeight);
+        }
+
+        // The same frame on every wall window, from the textures already on the GPU
+        if (wallColumns > 0) {
+            WallFrame wallFrame;
+            wallFrame.heatmapTexture = heatmap.shownTexture();
+            wallFrame.colormapTexture = heatmap.colormapTexture();
+            wallFrame.colormapSize = COLORMAP_SIZE;
+            wallFrame.valueRangeTexture = heatmap.valueRangeTexture();
+            wallFrame.view = view;
+            wallFrame.isolineCount = isolines;
+            wallFrame.isolineWidth = isolineWidth;
+            displayWall.present(wallFrame);
+        }
 
         // rendering happens in a double-buffered environment
         // the front buffer is the currently displayed buffer
         // the back buffer is where the next frame is draw
         // swap them shows the newly rendered frame
+        if (showStats) {
+            endGpuSection(&frameStats);
+            beginGpuSection(&frameStats, GPU_SECTION_SWAP);
+        }
         glfwSwapBuffers(window);
+        if (showStats) {
+            endGpuSection(&frameStats);
+            endFrameStats(&frameStats, glfwGetTime());
+            // Twice a second is plenty for a title that has to be readable
+            if (glfwGetTime() - statsTitleTime > 0.5) {
+                statsTitleTime = glfwGetTime();
+                glfwSetWindowTitle(window, ("OpenGL Heatmap - " + frameStatsSummary(&frameStats)).c_str());
+            }
+        }
         // checking if any user inputs or system events have occurred, processes them
         glfwPollEvents();
     }
 
     // Clean up resources
+    displayWall.stop();
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glDeleteTextures(1, &heatmapTexture);
-    glDeleteProgram(shaderProgram);
+    glDeleteVertexArrays(1, &VAO);
+    if (panelCount > 0) {
+        destroyHeatmapPanels(&heatmapPanels);
+    } else if (tiled) {
+        destroyTiledHeatmap(&tiledHeatmap);
+    } else {
+        heatmap.destroy();
+    }
+    if (gpuGenerate) {
+        destroyGpuFieldGenerator(&gpuGenerator);
+    }
+    if (lodEnabled) {
+        destroyLodPyramid(&lodPyramid);
+    }
+    if (playPath) {
+        frameCache.stop();
+        destroyPlaybackTextures(&playbackTextures);
+        std::cout << "Playback: " << missedFrames << " frames weren't loaded in time" << std::endl;
+    }
+    for (size_t i = 0; i < colormaps.size(); ++i) {
+        destroyColormap(&colormaps[i]);
+    }
+    destroyValueRange(&valueRange);
+    if (showStats) {
+        destroyFrameStats(&frameStats);
+    }
+    shaderWatcher.stop();
+    if (sharedName) {
+        closeSharedFieldRing(&sharedRing);
+    }
+    if (listenPort > 0) {
+        std::cout << "Ingest: " << frameIngest.droppedFrames() << " frames dropped" << std::endl;
+        frameIngest.stop();
+    }
+    if (reloading) {
+        glDeleteProgram(finishProgramBuild(&reloadBuild));
+    }
+    if (display.program) {
+        glDeleteProgram(display.program);
+    }
+    if (loadedField.data) {
+        closeMappedField(&loadedField);
+    }
 
     glfwTerminate();
-    return 0;
+    return exitCode;
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "offscreen_target.h"
+
+#include <iostream>
+#include <memory>
+
+#include "export_pipeline.h"
+#include "image_writer.h"
+
+
+bool createOffscreenTarget(OffscreenTarget* target, int width, int height, ExportPipeline* pipeline) {
+    target->pipeline = pipeline;
+    target->width = width;
+    target->height = height;
+    target->next = 0;
+    target->failures = 0;
+
+    glGenTextures(1, &target->colorTexture);
+    glBindTexture(GL_TEXTURE_2D, target->colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &target->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->colorTexture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(OFFSCREEN_READBACK_SLOTS, target->packBuffer);
+    for (int i = 0; i < OFFSCREEN_READBACK_SLOTS; ++i) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, target->packBuffer[i]);
+        // Written by the GPU, read back by us
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+        target->fence[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer is incomplete (status 0x" << std::hex << status << std::dec << ")" << std::endl;
+        destroyOffscreenTarget(target);
+        return false;
+    }
+    return true;
+}
+
+
+void bindOffscreenTarget(OffscreenTarget* target) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glViewport(0, 0, target->width, target->height);
+}
+
+
+// Wait for the copy into a slot, then encode its image or pass it to the pipeline
+static void writeSlot(OffscreenTarget* target, int slot) {
+    if (target->path[slot].empty()) {
+        return;
+    }
+    // The first wait flushes, so the fence is guaranteed to reach the GPU
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(target->fence[slot], flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+        flags = 0;
+    }
+    glDeleteSync(target->fence[slot]);
+    target->fence[slot] = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, target->packBuffer[slot]);
+    GLsizeiptr bytes = (GLsizeiptr)target->width * target->height * 4;
+    const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (!pixels) {
+        std::cerr << "Failed to map the readback of " << target->path[slot] << std::endl;
+        ++target->failures;
+    } else if (target->pipeline) {
+        // Copy the pixels out so the buffer can take the next readback right away
+        std::unique_ptr<ExportImage> image = target->pipeline->acquire();
+        image->path = target->path[slot];
+        image->width = target->width;
+        image->height = target->height;
+        image->pixels.assign(pixels, pixels + bytes);
+        target->pipeline->submit(std::move(image));
+    } else {
+        // OpenGL's first row is the bottom of the image
+        std::vector<unsigned char> encoded;
+        encodeImage(imageFileTypeForPath(target->path[slot]), pixels, target->width, target->height,
+                    target->width * 4, true, &encoded);
+        if (!writeImageFile(target->path[slot].c_str(), encoded)) {
+            ++target->failures;
+        }
+    }
+    if (pixels) {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    target->path[slot].clear();
+}
+
+
+void queueOffscreenReadback(OffscreenTarget* target, const std::string& path) {
+    int slot = target->next;
+    target->next = (slot + 1) % OFFSCREEN_READBACK_SLOTS;
+    // The image this slot held was queued a whole image ago, so it is usually ready
+    writeSlot(target, slot);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, target->packBuffer[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // With a pack buffer bound the last argument is an offset into it, and the call doesn't wait
+    glReadPixels(0, 0, target->width, target->height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    target->fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    target->path[slot] = path;
+}
+
+
+bool finishOffscreenReadbacks(OffscreenTarget* target) {
+    // Oldest first, so the files appear in the order they were queued
+    for (int i = 0; i < OFFSCREEN_READBACK_SLOTS; ++i) {
+        writeSlot(target, (target->next + i) % OFFSCREEN_READBACK_SLOTS);
+    }
+    return target->failures == 0;
+}
+
+
+void destroyOffscreenTarget(OffscreenTarget* target) {
+    for (int i = 0; i < OFFSCREEN_READBACK_SLOTS; ++i) {
+        if (target->fence[i]) {
+            glDeleteSync(target->fence[i]);
+            target->fence[i] = 0;
+        }
+        target->path[i].clear();
+    }
+    glDeleteBuffers(OFFSCREEN_READBACK_SLOTS, target->packBuffer);
+    glDeleteFramebuffers(1, &target->framebuffer);
+    glDeleteTextures(1, &target->colorTexture);
+}
@@ -0,0 +1,52 @@
+/*
+    Rendering into an offscreen framebuffer and saving the result, for batch jobs without a
+    visible window.
+
+    The heatmap is drawn into an RGBA8 texture attached to a framebuffer object. glReadPixels
+    then copies it into a pixel pack buffer (PBO) instead of client memory, so it returns
+    right away and the copy runs on the GPU. There are two PBOs: while the GPU renders and
+    copies one image, the previous one is mapped on the CPU and either encoded right there or
+    handed to an ExportPipeline, which encodes and writes it on other threads.
+*/
+
+#ifndef OFFSCREEN_TARGET_H
+#define OFFSCREEN_TARGET_H
+
+#include <GL/glew.h>
+#include <string>
+
+class ExportPipeline;
+
+// Readbacks in flight
+const int OFFSCREEN_READBACK_SLOTS = 2;
+
+struct OffscreenTarget {
+    GLuint framebuffer;
+    GLuint colorTexture;                            // RGBA8, width x height
+    GLuint packBuffer[OFFSCREEN_READBACK_SLOTS];
+    GLsync fence[OFFSCREEN_READBACK_SLOTS];         // Signalled once the copy into the slot is done
+    std::string path[OFFSCREEN_READBACK_SLOTS];     // Where the image in the slot goes; empty if none
+    int width;
+    int height;
+    int next;                                       // Slot for the next readback
+    int failures;                                   // Images that couldn't be written
+    ExportPipeline* pipeline;                       // Encodes the images if set, otherwise done inline
+};
+
+// With a pipeline, images are copied out of the pack buffers and encoded on its threads
+bool createOffscreenTarget(OffscreenTarget* target, int width, int height, ExportPipeline* pipeline = 0);
+
+// Draw into the target from now on (also sets the viewport to its size)
+void bindOffscreenTarget(OffscreenTarget* target);
+
+// Start copying what was drawn into the target and save it to path (.png or .exr) once it
+// has arrived. If both slots are busy, the older image is handed on first.
+void queueOffscreenReadback(OffscreenTarget* target, const std::string& path);
+
+// Hand on every image still in flight. Without a pipeline this also writes them and returns
+// false if any image failed; with one, ExportPipeline::finish reports the failures.
+bool finishOffscreenReadbacks(OffscreenTarget* target);
+
+void destroyOffscreenTarget(OffscreenTarget* target);
+
+#endif
@@ -0,0 +1,19 @@
+#version 330 core
+
+// Vertex shader for the instanced panels (see heatmap_panels.h).
+// Every instance is one panel: four vertices as a triangle strip, corners from gl_VertexID.
+
+// Where this panel goes: xy scales the [-1, 1] quad, zw moves it (one value per instance)
+layout(location = 0) in vec4 panelTransform;
+
+out vec2 TexCoord;  // Pass this to the fragment shader
+flat out float Layer; // Which layer of the array texture holds this panel
+
+void main()
+{
+    // (0, 0), (1, 0), (0, 1), (1, 1)
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    gl_Position = vec4((corner * 2.0 - 1.0) * panelTransform.xy + panelTransform.zw, 0.0, 1.0);
+    TexCoord = corner;
+    Layer = float(gl_InstanceID);
+}
@@ -0,0 +1,100 @@
+#include "playback.h"
+
+#include <cmath>
+
+
+bool createPlaybackTextures(PlaybackTextures* textures, const TextureStream* stream, int count) {
+    textures->clock = 0;
+    textures->slotTexture.clear();
+    for (int i = 0; i < count; ++i) {
+        textures->slotTexture.push_back(createFieldTexture(stream->width, stream->height, stream->format, stream->levels));
+    }
+    textures->slotFrame.assign(count, -1);
+    textures->slotLastUsed.assign(count, 0);
+    return count > 0;
+}
+
+
+GLuint findPlaybackTexture(PlaybackTextures* textures, int frame) {
+    for (size_t i = 0; i < textures->slotFrame.size(); ++i) {
+        if (textures->slotFrame[i] == frame) {
+            textures->slotLastUsed[i] = ++textures->clock;
+            return textures->slotTexture[i];
+        }
+    }
+    return 0;
+}
+
+
+GLuint uploadPlaybackTexture(PlaybackTextures* textures, TextureStream* stream, int frame, const float* data,
+                             ThreadPool* pool) {
+    // The ring is a handful of textures: a linear search for the oldest one is plenty
+    size_t oldest = 0;
+    for (size_t i = 1; i < textures->slotFrame.size(); ++i) {
+        if (textures->slotLastUsed[i] < textures->slotLastUsed[oldest]) {
+            oldest = i;
+        }
+    }
+    // The slot gives up its old frame first, so a failed upload leaves it empty, not stale
+    textures->slotFrame[oldest] = -1;
+    if (!uploadTextureStreamTo(stream, textures->slotTexture[oldest], data, pool)) {
+        return 0;
+    }
+    textures->slotFrame[oldest] = frame;
+    textures->slotLastUsed[oldest] = ++textures->clock;
+    return textures->slotTexture[oldest];
+}
+
+
+void destroyPlaybackTextures(PlaybackTextures* textures) {
+    if (!textures->slotTexture.empty()) {
+        glDeleteTextures((GLsizei)textures->slotTexture.size(), textures->slotTexture.data());
+    }
+    textures->slotTexture.clear();
+    textures->slotFrame.clear();
+    textures->slotLastUsed.clear();
+}
+
+
+void initPlaybackClock(PlaybackClock* clock, int frameCount, double fps) {
+    clock->frameCount = frameCount;
+    clock->fps = fps;
+    clock->position = 0.0;
+    clock->direction = 1;
+    clock->speed = 1;
+    clock->paused = false;
+}
+
+
+int advancePlaybackClock(PlaybackClock* clock, double seconds) {
+    if (!clock->paused) {
+        clock->position += seconds * clock->fps * clock->speed * clock->direction;
+        // Wrap around at both ends
+        clock->position = std::fmod(clock->position, (double)clock->frameCount);
+        if (clock->position < 0.0) {
+            clock->position += clock->frameCount;
+        }
+    }
+    int frame = (int)clock->position;
+    return frame < clock->frameCount ? frame : clock->frameCount - 1;
+}
+
+
+void stepPlaybackClock(PlaybackClock* clock, int steps) {
+    int frame = ((int)clock->position + steps) % clock->frameCount;
+    if (frame < 0) {
+        frame += clock->frameCount;
+    }
+    // The middle of the frame, so rounding never lands on a neighbour
+    clock->position = frame + 0.5;
+}
+
+
+double playbackSecondsToNextFrame(const PlaybackClock* clock) {
+    if (clock->paused) {
+        return -1.0;
+    }
+    double fraction = clock->position - std::floor(clock->position);
+    double framesLeft = clock->direction > 0 ? 1.0 - fraction : fraction;
+    return framesLeft / (clock->fps * clock->speed);
+}
@@ -0,0 +1,66 @@
+/*
+    Playing back a recorded sequence of fields.
+
+    The frames come out of a FrameCache (frame_cache.h) in RAM. The newest few that were
+    shown stay on the GPU in a small ring of textures, reused least recently used first like
+    the tile pool in tiled_heatmap.h, so stepping back and forth over the last frames while
+    scrubbing binds a texture instead of uploading the frame again.
+
+    The playhead runs on wall-clock time at fps frames per second times the speed, in either
+    direction and wrapping around at the ends. A frame that isn't loaded yet when it is due is
+    skipped, and the previous one stays on screen: playback keeps time instead of stuttering
+    when the disk can't keep up.
+*/
+
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include <GL/glew.h>
+#include <vector>
+
+#include "texture_stream.h"
+
+class ThreadPool;
+
+struct PlaybackTextures {
+    std::vector<GLuint> slotTexture;        // The ring of textures, all the size of the stream's
+    std::vector<int> slotFrame;             // Frame stored in each slot, -1 if empty
+    std::vector<unsigned> slotLastUsed;     // When each slot was last shown
+    unsigned clock;
+};
+
+// Create count (at least one) textures with the size, format and mipmap levels of stream's texture
+bool createPlaybackTextures(PlaybackTextures* textures, const TextureStream* stream, int count);
+
+// The texture holding frame, or 0 if it isn't on the GPU
+GLuint findPlaybackTexture(PlaybackTextures* textures, int frame);
+
+// Upload frame through the stream's pixel buffers into the least recently used texture and
+// return that texture, or 0 if the pixel buffer couldn't be mapped. Its mipmap levels (if any)
+// are left to the caller.
+GLuint uploadPlaybackTexture(PlaybackTextures* textures, TextureStream* stream, int frame, const float* data,
+                             ThreadPool* pool);
+
+void destroyPlaybackTextures(PlaybackTextures* textures);
+
+struct PlaybackClock {
+    int frameCount;
+    double fps;             // Frames per second at 1x
+    double position;        // In frames; the frame shown is its integer part
+    int direction;          // +1 forward, -1 backward
+    int speed;              // 1, 2, 4, ...
+    bool paused;
+};
+
+void initPlaybackClock(PlaybackClock* clock, int frameCount, double fps);
+
+// Move the playhead on by seconds of wall-clock time (nothing while paused) and return the frame it is on
+int advancePlaybackClock(PlaybackClock* clock, double seconds);
+
+// Jump steps frames (negative goes back) from the current one, e.g. for the arrow keys
+void stepPlaybackClock(PlaybackClock* clock, int steps);
+
+// Seconds until the playhead reaches the next frame, or a negative number while paused
+double playbackSecondsToNextFrame(const PlaybackClock* clock);
+
+#endif
@@ -0,0 +1,141 @@
+#include "rgtc_encoder.h"
+#include "cpu_dispatch.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+// With red0 > red1 a BC4 block has eight levels: index 0 is red0, index 1 is red1 and
+// index i >= 2 is ((8 - i) * red0 + (i - 1) * red1) / 7. The encoder only uses this mode.
+// Counting the levels in steps k from red1 (k = 0) up to red0 (k = 7) gives the index:
+static const uint8_t STEP_INDEX[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+
+// Squared and largest error of one row of blocks
+struct BlockRowError {
+    double squared;
+    float max;
+};
+
+
+size_t rgtcBlockBytes(int width, int height) {
+    return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * 8;
+}
+
+
+// Encode the blocks of rows [4 * blockY, 4 * blockY + 4). Texels past the edge of the field
+// repeat the last row or column. The loops over the 16 texels of a block vectorize, so this
+// is built per instruction set (see cpu_dispatch.h).
+HEATMAP_TARGET_CLONES
+static void encodeBlockRow(const float* src, int width, int height, int blockY, uint8_t* dst, BlockRowError* error) {
+    int blocksX = (width + 3) / 4;
+    const float* rows[4];
+    for (int y = 0; y < 4; ++y) {
+        int row = blockY * 4 + y < height ? blockY * 4 + y : height - 1;
+        rows[y] = src + (size_t)row * width;
+    }
+    for (int blockX = 0; blockX < blocksX; ++blockX) {
+        float v[16];
+        for (int y = 0; y < 4; ++y) {
+            for (int x = 0; x < 4; ++x) {
+                int column = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+                float value = rows[y][column];
+                // NaN fails both comparisons and becomes 0, the endpoints below must be integers
+                v[y * 4 + x] = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+            }
+        }
+        float lo = v[0], hi = v[0];
+        for (int i = 1; i < 16; ++i) {
+            lo = v[i] < lo ? v[i] : lo;
+            hi = v[i] > hi ? v[i] : hi;
+        }
+
+        // Endpoints just outside the block's range, so every value lies between two levels.
+        // A flat block still needs red0 > red1 to stay in the eight-level mode.
+        int red1 = (int)std::floor(lo * 255.0f);
+        int red0 = (int)std::ceil(hi * 255.0f);
+        if (red0 == red1) {
+            if (red0 < 255) {
+                ++red0;
+            } else {
+                --red1;
+            }
+        }
+        float scale = 7.0f / (float)(red0 - red1);
+        int steps[16];
+        for (int i = 0; i < 16; ++i) {
+            int k = (int)((v[i] * 255.0f - (float)red1) * scale + 0.5f);
+            steps[i] = k < 0 ? 0 : (k > 7 ? 7 : k);
+        }
+
+        uint64_t bits = 0;
+        for (int i = 0; i < 16; ++i) {
+            bits |= (uint64_t)STEP_INDEX[steps[i]] << (3 * i);
+        }
+        uint8_t* block = dst + (size_t)blockX * 8;
+        block[0] = (uint8_t)red0;
+        block[1] = (uint8_t)red1;
+        for (int i = 0; i < 6; ++i) {
+            block[2 + i] = (uint8_t)(bits >> (8 * i));
+        }
+
+        if (error) {
+            // What the GPU decodes: the level of the step, as a fraction of 255
+            for (int i = 0; i < 16; ++i) {
+                float decoded = ((float)(steps[i] * red0 + (7 - steps[i]) * red1) / 7.0f) / 255.0f;
+                float difference = std::fabs(decoded - v[i]);
+                error->squared += (double)difference * difference;
+                error->max = difference > error->max ? difference : error->max;
+            }
+        }
+    }
+}
+
+
+// Rows of blocks are independent; with errors, every row of blocks sums its own so the
+// total doesn't depend on how the rows were split between the threads
+static void encodeBlocks(const float* src, int width, int height, uint8_t* dst, std::vector<BlockRowError>* errors,
+                         ThreadPool* pool) {
+    int blocksY = (height + 3) / 4;
+    size_t rowBytes = (size_t)((width + 3) / 4) * 8;
+    if (errors) {
+        BlockRowError none = { 0.0, 0.0f };
+        errors->assign(blocksY, none);
+    }
+    auto encodeRows = [&](int begin, int end) {
+        for (int blockY = begin; blockY < end; ++blockY) {
+            encodeBlockRow(src, width, height, blockY, dst + blockY * rowBytes, errors ? &(*errors)[blockY] : NULL);
+        }
+    };
+    if (pool && pool->threadCount() > 1) {
+        int grain = blocksY / (int)(pool->threadCount() * 4);
+        pool->parallelFor(0, blocksY, grain > 0 ? grain : 1, encodeRows);
+    } else {
+        encodeRows(0, blocksY);
+    }
+}
+
+
+void encodeRgtcBlocks(const float* src, int width, int height, void* blocks, ThreadPool* pool) {
+    encodeBlocks(src, width, height, (uint8_t*)blocks, NULL, pool);
+}
+
+
+void measureRgtcQuality(const float* src, int width, int height, RgtcQuality* quality, ThreadPool* pool) {
+    std::vector<uint8_t> blocks(rgtcBlockBytes(width, height));
+    std::vector<BlockRowError> errors;
+    encodeBlocks(src, width, height, blocks.data(), &errors, pool);
+
+    // Partial blocks at the edges repeat their last texels, which count like any other
+    double squared = 0.0;
+    quality->maxError = 0.0f;
+    for (size_t i = 0; i < errors.size(); ++i) {
+        squared += errors[i].squared;
+        quality->maxError = errors[i].max > quality->maxError ? errors[i].max : quality->maxError;
+    }
+    double blockTexels = (double)((width + 3) / 4 * 4) * (double)((height + 3) / 4 * 4);
+    double meanSquared = squared / blockTexels;
+    quality->rmsError = std::sqrt(meanSquared);
+    quality->psnr = meanSquared > 0.0 ? 10.0 * std::log10(1.0 / meanSquared) : std::numeric_limits<double>::infinity();
+}
@@ -0,0 +1,39 @@
+/*
+    Block compression of scalar fields into BC4 (RGTC1), the single-channel format every GPU
+    since GL 3.0 samples directly.
+
+    BC4 stores every 4x4 block of texels in 8 bytes: two 8-bit endpoints and a 3-bit index per
+    texel that picks one of eight values between them. That is half a byte per texel, 8x less
+    than r32f and 2x less than r8, both in video memory and in the bandwidth the fragment
+    shader reads. Smooth fields hardly suffer; fields with sharp detail inside a block lose
+    the levels between its minimum and maximum. Like r8 and r16, BC4 holds values in [0, 1].
+
+    The encoder runs on the CPU, on all cores. It picks the block's minimum and maximum as
+    endpoints, which is fast enough to encode fields while streaming them. Its quality is
+    measured the same way: measureRgtcQuality shows whether a dataset is fine with it.
+*/
+
+#ifndef RGTC_ENCODER_H
+#define RGTC_ENCODER_H
+
+#include <cstddef>
+
+class ThreadPool;
+
+// Bytes of the BC4 blocks of a width x height field: 8 per block, partial blocks at the edges included
+size_t rgtcBlockBytes(int width, int height);
+
+struct RgtcQuality {
+    double psnr;            // In dB, peak 1.0 (infinite if nothing was lost)
+    double rmsError;
+    float maxError;         // Largest difference of a texel, after clamping to [0, 1]
+};
+
+// Encode a width x height field into blocks (rgtcBlockBytes of them), one row of blocks
+// after the other, first row at the bottom. Values are clamped to [0, 1].
+void encodeRgtcBlocks(const float* src, int width, int height, void* blocks, ThreadPool* pool = 0);
+
+// Encode the field and compare what the GPU will decode with the values clamped to [0, 1]
+void measureRgtcQuality(const float* src, int width, int height, RgtcQuality* quality, ThreadPool* pool = 0);
+
+#endif
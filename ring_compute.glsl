@@ -0,0 +1,31 @@
+#version 430
+
+// Each work group fills a 16x16 block of the heatmap texture
+layout(local_size_x = 16, local_size_y = 16) in;
+
+// Image format of the heatmap texture, defined by the application (r32f, r16f, r16 or r8)
+#ifndef FIELD_FORMAT
+#define FIELD_FORMAT r32f
+#endif
+
+// The heatmap texture, written directly without going through host memory
+layout(FIELD_FORMAT, binding = 0) uniform writeonly image2D field;
+
+uniform float scale;   // Frequency of the rings
+uniform vec2 center;   // Center of the rings in normalized [0, 1] coordinates
+uniform float phase;   // Shifts the rings outwards over time
+uniform float amplitude; // value = offset + amplitude * sin(...)
+uniform float offset;
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(field);
+    // The last work groups can hang over the edge of the texture
+    if (texel.x >= size.x || texel.y >= size.y) {
+        return;
+    }
+    // Same formula as the CPU generator: sin(distance from center), scaled and offset
+    vec2 position = vec2(texel) / vec2(size);
+    float value = sin(scale * distance(position, center) - phase);
+    imageStore(field, texel, vec4(offset + amplitude * value));
+}
@@ -0,0 +1,20 @@
+#version 330 core
+
+// Fallback for drivers without compute shaders: a fullscreen triangle is drawn into a framebuffer
+// that has the heatmap texture attached, so each fragment is exactly one texel.
+
+uniform vec2 fieldSize; // Size of the heatmap texture in texels
+uniform float scale;    // Frequency of the rings
+uniform vec2 center;    // Center of the rings in normalized [0, 1] coordinates
+uniform float phase;    // Shifts the rings outwards over time
+uniform float amplitude; // value = offset + amplitude * sin(...)
+uniform float offset;
+
+out vec4 fieldValue;    // Only the red channel ends up in the texture
+
+void main() {
+    // gl_FragCoord is the texel center, e.g. (0.5, 0.5) for the first texel
+    vec2 position = (gl_FragCoord.xy - 0.5) / fieldSize;
+    float value = sin(scale * distance(position, center) - phase);
+    fieldValue = vec4(offset + amplitude * value);
+}
@@ -0,0 +1,351 @@
+#include "shader.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>      // For reading files, help us to read our shaders from separate files
+#include <sstream>      // For working with file streams, help us to read our shaders from separate files
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <stdint.h>
+
+#include <sys/stat.h>
+
+
+// Function to read shader code from a file
+std::string readShaderFile (const char* filePath) {
+    std::ifstream shaderFile;   // Declare an input file stream
+    shaderFile.open(filePath);   // Open the file using the filePath
+
+    // If we couldn't open the shaderFile, output the error to standard error stream 
+    if (!shaderFile.is_open()) {
+        std::cerr << "Failed to open shader file: " << filePath << std::endl;
+    }
+
+    // Takes the entire content of the shaderFile and streams it into the string stream object.
+    std::stringstream shaderStream;
+    shaderStream << shaderFile.rdbuf(); 
+    shaderFile.close(); 
+
+    // Convert stream content to string and return it
+    return shaderStream.str();  
+}
+
+
+// Function to add lines to a shader source after its #version directive
+// (nothing except comments may come before #version, so we can't simply prepend them)
+std::string injectShaderDefines(const std::string& source, const char* defines) {
+    if (!defines || !*defines) {
+        return source;
+    }
+    size_t versionPos = source.find("#version");
+    size_t insertPos = 0;
+    if (versionPos != std::string::npos) {
+        size_t lineEnd = source.find('\n', versionPos);
+        insertPos = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+    }
+    std::string result = source.substr(0, insertPos);
+    if (!result.empty() && result[result.size() - 1] != '\n') {
+        result += '\n';
+    }
+    result += defines;
+    result += '\n';
+    result += source.substr(insertPos);
+    return result;
+}
+
+
+// Function to compile a shader from a file
+// GLuint is a type defined in OpenGL. It is used to represent various OpenGL objects, such as shaders, textures, buffers, and programs. 
+// GL_VERTEX_SHADER or GL_FRAGMENT_SHADER is specified by the type parameter.
+GLuint compileShaderFromFile(GLenum type, const char* filePath, const char* defines) {
+    std::string shaderCode = readShaderFile(filePath);  // Read the shader code from the file as a string
+    shaderCode = injectShaderDefines(shaderCode, defines); // Add the caller's #defines, if any
+    const char* shaderSource = shaderCode.c_str();      // Covert the string to C-style string
+
+    GLuint shader = glCreateShader(type);                // Tells OpenGL to create a new shader with certain type (vertex or fragment)
+    glShaderSource(shader, 1, &shaderSource, NULL);      // Pass the actual shader code to OpenGL, so it knows what code to compile
+    glCompileShader(shader);                             // Compile the shader
+
+    // Check whether the shader is comiles correctly.
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, NULL, infoLog); // Get error message from OpenGL
+        std::cerr << "Error compiling shader from file: " << filePath << "\n" << infoLog << std::endl;
+    }
+    return shader;  // return the compiled shader obejct
+}
+
+
+// ---------------------------------------------------------------------------------------------
+// Program binary cache
+//
+// Linked programs are saved with glGetProgramBinary, keyed by a hash of their sources and of
+// the driver identification strings, so a driver update never loads a stale binary. The next
+// start loads the binary with glProgramBinary and skips compiling and linking altogether.
+// ---------------------------------------------------------------------------------------------
+
+static bool shaderCacheResolved = false;
+static std::string shaderCacheDirectory;
+
+
+void setShaderCacheDirectory(const char* directory) {
+    shaderCacheDirectory = directory ? directory : "";
+    shaderCacheResolved = true;
+}
+
+
+// $HEATMAP_SHADER_CACHE, else $XDG_CACHE_HOME/heatmap-opengl, else ~/.cache/heatmap-opengl
+static const std::string& cacheDirectory() {
+    if (!shaderCacheResolved) {
+        const char* explicitDirectory = getenv("HEATMAP_SHADER_CACHE");
+        const char* xdgCache = getenv("XDG_CACHE_HOME");
+        const char* home = getenv("HOME");
+        if (explicitDirectory) {
+            shaderCacheDirectory = explicitDirectory;
+        } else if (xdgCache && *xdgCache) {
+            shaderCacheDirectory = std::string(xdgCache) + "/heatmap-opengl";
+        } else if (home && *home) {
+            shaderCacheDirectory = std::string(home) + "/.cache/heatmap-opengl";
+        }
+        shaderCacheResolved = true;
+    }
+    return shaderCacheDirectory;
+}
+
+
+// Create a directory and all of its parents, like mkdir -p
+static void makeDirectories(const std::string& path) {
+    for (size_t pos = 1; pos <= path.size(); ++pos) {
+        if (pos == path.size() || path[pos] == '/') {
+            mkdir(path.substr(0, pos).c_str(), 0755);
+        }
+    }
+}
+
+
+// 64-bit FNV-1a, good enough to tell shader sources apart
+static uint64_t hashBytes(uint64_t hash, const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+static bool programBinariesSupported() {
+    if (!(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)) {
+        return false;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+
+// Cache file for a program made of the given stages, or "" if the cache is unavailable
+static std::string programCachePath(const GLenum* types, const std::string* sources, int count) {
+    const std::string& directory = cacheDirectory();
+    if (directory.empty() || !programBinariesSupported()) {
+        return "";
+    }
+    uint64_t hash = 14695981039346656037ULL;
+    const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (int i = 0; i < 3; ++i) {
+        const char* text = (const char*)glGetString(driverStrings[i]);
+        if (text) {
+            hash = hashBytes(hash, text, strlen(text));
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        hash = hashBytes(hash, (const char*)&types[i], sizeof(types[i]));
+        hash = hashBytes(hash, sources[i].data(), sources[i].size());
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)hash);
+    return directory + name;
+}
+
+
+// Try to load a cached binary into program. Returns false if there is none or the driver rejects it.
+static bool loadProgramBinary(GLuint program, const std::string& path) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    GLenum format;
+    if (!file.read((char*)&format, sizeof(format))) {
+        return false;
+    }
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) {
+        return false;
+    }
+    glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+}
+
+
+static void saveProgramBinary(GLuint program, const std::string& path) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+    // Write to a temporary file first so a concurrent start never reads half a binary
+    makeDirectories(cacheDirectory());
+    std::string temporary = path + ".tmp";
+    std::ofstream file(temporary.c_str(), std::ios::binary);
+    file.write((const char*)&format, sizeof(format));
+    file.write(binary.data(), binary.size());
+    file.close();
+    if (file) {
+        rename(temporary.c_str(), path.c_str());
+    } else {
+        remove(temporary.c_str());
+    }
+}
+
+
+void enableParallelShaderCompile() {
+    // 0xFFFFFFFF lets the driver pick the number of compiler threads
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    } else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+}
+
+
+bool hasParallelShaderCompile() {
+    return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
+
+
+static void beginProgramBuild(ProgramBuild* build, const GLenum* types, const char* const* paths, int count,
+                              const char* defines) {
+    build->shaderCount = 0;
+    build->fromCache = false;
+    build->linked = false;
+    build->name.clear();
+
+    std::string sources[2];
+    for (int i = 0; i < count; ++i) {
+        sources[i] = injectShaderDefines(readShaderFile(paths[i]), defines);
+        build->name += (i ? " + " : "") + std::string(paths[i]);
+    }
+
+    build->program = glCreateProgram();
+    build->cachePath = programCachePath(types, sources, count);
+    if (!build->cachePath.empty() && loadProgramBinary(build->program, build->cachePath)) {
+        build->fromCache = true;
+        return;
+    }
+
+    // With KHR_parallel_shader_compile these calls only queue the work on the driver's
+    // compiler threads; the status queries in finishProgramBuild are what would block.
+    for (int i = 0; i < count; ++i) {
+        const char* source = sources[i].c_str();
+        GLuint shader = glCreateShader(types[i]);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        glAttachShader(build->program, shader);
+        build->shaders[build->shaderCount++] = shader;
+    }
+    if (!build->cachePath.empty()) {
+        glProgramParameteri(build->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(build->program);
+}
+
+
+void beginShaderProgramBuild(ProgramBuild* build, const char* vertexPath, const char* fragmentPath, const char* defines) {
+    const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const char* paths[] = { vertexPath, fragmentPath };
+    beginProgramBuild(build, types, paths, 2, defines);
+}
+
+
+void beginComputeProgramBuild(ProgramBuild* build, const char* computePath, const char* defines) {
+    const GLenum types[] = { GL_COMPUTE_SHADER };
+    const char* paths[] = { computePath };
+    beginProgramBuild(build, types, paths, 1, defines);
+}
+
+
+bool isProgramBuildReady(const ProgramBuild* build) {
+    if (build->fromCache) {
+        return true;
+    }
+    // Without the extension there is no way to ask without blocking, so claim we're done;
+    // finishProgramBuild then waits for the whole compile and link
+    if (!hasParallelShaderCompile()) {
+        return true;
+    }
+    GLint complete = GL_FALSE;
+    glGetProgramiv(build->program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+
+GLuint finishProgramBuild(ProgramBuild* build) {
+    build->linked = true;
+    if (!build->fromCache) {
+        int success;
+        glGetProgramiv(build->program, GL_LINK_STATUS, &success); // Check if linking was successful
+        build->linked = success != 0;
+        if (!success) {
+            // Show whichever stage failed, then the linker's own message
+            char infoLog[512];
+            for (int i = 0; i < build->shaderCount; ++i) {
+                int compiled;
+                glGetShaderiv(build->shaders[i], GL_COMPILE_STATUS, &compiled);
+                if (!compiled) {
+                    glGetShaderInfoLog(build->shaders[i], 512, NULL, infoLog);
+                    std::cerr << "Error compiling shader from file: " << build->name << "\n" << infoLog << std::endl;
+                }
+            }
+            glGetProgramInfoLog(build->program, 512, NULL, infoLog);
+            std::cerr << "Error linking program: " << build->name << "\n" << infoLog << std::endl;
+        } else if (!build->cachePath.empty()) {
+            saveProgramBinary(build->program, build->cachePath);
+        }
+        // We don't need the individual shaders anymore
+        for (int i = 0; i < build->shaderCount; ++i) {
+            glDetachShader(build->program, build->shaders[i]);
+            glDeleteShader(build->shaders[i]);
+        }
+        build->shaderCount = 0;
+    }
+    return build->program;
+}
+
+
+// Function to create a shader program using vertex and fragment shaders from files.
+// A shader program takes both the vertex shader and the fragment shader and links them
+// together into one program that the GPU can use.
+// This is the blocking version of beginShaderProgramBuild + finishProgramBuild.
+GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath, const char* defines) {
+    ProgramBuild build;
+    beginShaderProgramBuild(&build, vertexPath, fragmentPath, defines);
+    return finishProgramBuild(&build);
+}
+
+
+// Function to create a program from a single compute shader (GL 4.3).
+// Compute programs don't draw anything; they are run with glDispatchCompute.
+GLuint createComputeProgram(const char* computePath, const char* defines) {
+    ProgramBuild build;
+    beginComputeProgramBuild(&build, computePath, defines);
+    return finishProgramBuild(&build);
+}
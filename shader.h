@@ -0,0 +1,67 @@
+/*
+    Helpers for building shader programs from GLSL files on disk.
+
+    Linked programs are cached as driver binaries (see setShaderCacheDirectory), so later
+    starts skip compilation. Builds can also be started without waiting for them: with
+    KHR_parallel_shader_compile the driver compiles them on its own threads while we keep
+    going, and several programs compile at the same time. Without the extension the driver
+    may still defer the work, but finishing a build can block for the whole compile.
+*/
+
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <GL/glew.h>
+#include <string>
+
+// Read the whole shader source file into a string
+std::string readShaderFile(const char* filePath);
+
+// Insert extra lines (usually #defines) right after the #version line of a shader source
+std::string injectShaderDefines(const std::string& source, const char* defines);
+
+// Compile one shader stage (GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, ...) from a file.
+// defines, if given, is inserted after the #version line.
+GLuint compileShaderFromFile(GLenum type, const char* filePath, const char* defines = NULL);
+
+// A program that is being compiled and linked, or loaded from the binary cache
+struct ProgramBuild {
+    GLuint program;
+    GLuint shaders[2];
+    int shaderCount;
+    std::string name;       // Source file names, for error messages
+    std::string cachePath;  // Binary cache file, empty when caching is unavailable
+    bool fromCache;         // Loaded from the cache, nothing to compile
+    bool linked;            // Set by finishProgramBuild
+};
+
+// Where program binaries are stored. NULL or "" disables the cache.
+// Default: $HEATMAP_SHADER_CACHE, $XDG_CACHE_HOME/heatmap-opengl or ~/.cache/heatmap-opengl
+void setShaderCacheDirectory(const char* directory);
+
+// Let the driver compile on background threads if it supports KHR_parallel_shader_compile.
+// Call once after the context is created.
+void enableParallelShaderCompile();
+
+// true if isProgramBuildReady can tell whether a build is done without waiting for it
+bool hasParallelShaderCompile();
+
+// Start building a vertex + fragment (or compute) program without waiting for the compiler
+void beginShaderProgramBuild(ProgramBuild* build, const char* vertexPath, const char* fragmentPath,
+                             const char* defines = NULL);
+void beginComputeProgramBuild(ProgramBuild* build, const char* computePath, const char* defines = NULL);
+
+// true once finishProgramBuild would not block. Without KHR_parallel_shader_compile this
+// can't be known and is always true, so finishProgramBuild may block.
+bool isProgramBuildReady(const ProgramBuild* build);
+
+// Wait for the build, report errors and store the binary in the cache. Returns the program.
+GLuint finishProgramBuild(ProgramBuild* build);
+
+// Compile and link a vertex + fragment shader program
+GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath, const char* defines = NULL);
+
+// Compile and link a compute shader program (requires GL 4.3)
+GLuint createComputeProgram(const char* computePath, const char* defines = NULL);
+
+#endif
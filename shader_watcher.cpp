@@ -0,0 +1,159 @@
+#include "shader_watcher.h"
+
+#include <iostream>
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+
+// Split a path into its directory ("." if there is none) and file name
+static void splitPath(const std::string& path, std::string* directory, std::string* name) {
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos) {
+        *directory = ".";
+        *name = path;
+    } else {
+        *directory = slash == 0 ? "/" : path.substr(0, slash);
+        *name = path.substr(slash + 1);
+    }
+}
+
+
+ShaderWatcher::ShaderWatcher() : changed(false), running(false), inotifyFd(-1) {
+    stopPipe[0] = stopPipe[1] = -1;
+}
+
+
+ShaderWatcher::~ShaderWatcher() {
+    stop();
+}
+
+
+bool ShaderWatcher::start(const std::vector<std::string>& watchPaths, const std::function<void()>& callback) {
+    stop();
+    paths = watchPaths;
+    onChange = callback;
+    changed = false;
+    if (pipe(stopPipe) != 0) {
+        std::cerr << "Failed to create the shader watcher pipe" << std::endl;
+        return false;
+    }
+
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        std::cerr << "inotify is unavailable, shader hot reload is disabled" << std::endl;
+        stop();
+        return false;
+    }
+    // Watch the directories rather than the files: a save that replaces the file would
+    // otherwise leave us watching the deleted original
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::string directory, name;
+        splitPath(paths[i], &directory, &name);
+        inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    }
+#endif
+
+    running = true;
+    thread = std::thread(&ShaderWatcher::run, this);
+    return true;
+}
+
+
+void ShaderWatcher::stop() {
+    if (running) {
+        running = false;
+        char wake = 0;
+        if (write(stopPipe[1], &wake, 1) < 0) {
+            // The thread still notices running == false within one polling interval
+        }
+        thread.join();
+    }
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (stopPipe[i] >= 0) {
+            close(stopPipe[i]);
+            stopPipe[i] = -1;
+        }
+    }
+}
+
+
+bool ShaderWatcher::consumeChanges() {
+    return changed.exchange(false);
+}
+
+
+void ShaderWatcher::run() {
+#ifdef __linux__
+    std::vector<std::string> names(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::string directory;
+        splitPath(paths[i], &directory, &names[i]);
+    }
+
+    while (running) {
+        struct pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) <= 0 || (fds[1].revents & POLLIN)) {
+            continue;
+        }
+        // Drain all pending events and look for one of our file names
+        alignas(struct inotify_event) char buffer[4096];
+        bool relevant = false;
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* ptr = buffer; ptr < buffer + length;) {
+                struct inotify_event* event = (struct inotify_event*)ptr;
+                if (event->len > 0) {
+                    for (size_t i = 0; i < names.size(); ++i) {
+                        relevant = relevant || names[i] == event->name;
+                    }
+                }
+                ptr += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (relevant) {
+            changed = true;
+            if (onChange) {
+                onChange();
+            }
+        }
+    }
+#else
+    // No inotify: compare modification times four times per second
+    std::vector<time_t> modified(paths.size(), 0);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        struct stat info;
+        if (stat(paths[i].c_str(), &info) == 0) {
+            modified[i] = info.st_mtime;
+        }
+    }
+    while (running) {
+        struct pollfd fds[1] = { { stopPipe[0], POLLIN, 0 } };
+        poll(fds, 1, 250);
+        bool relevant = false;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            struct stat info;
+            if (stat(paths[i].c_str(), &info) == 0 && info.st_mtime != modified[i]) {
+                modified[i] = info.st_mtime;
+                relevant = true;
+            }
+        }
+        if (relevant) {
+            changed = true;
+            if (onChange) {
+                onChange();
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,49 @@
+/*
+    Watches shader files for changes on a background thread.
+
+    On Linux the watcher uses inotify on the directories of the files, which also catches
+    editors that save by writing a new file and renaming it over the old one. Elsewhere it
+    falls back to checking the modification times a few times per second.
+
+    The watcher only notices changes; recompiling is up to the render loop (see
+    beginShaderProgramBuild), which keeps every GL call on the thread that owns the context.
+*/
+
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ShaderWatcher {
+public:
+    ShaderWatcher();
+    ~ShaderWatcher();
+
+    // Start watching. onChange (optional) runs on the watcher thread after every change,
+    // e.g. to wake up a render loop that is waiting for events.
+    bool start(const std::vector<std::string>& paths, const std::function<void()>& onChange);
+    void stop();
+
+    // true if any watched file changed since the last call
+    bool consumeChanges();
+
+private:
+    ShaderWatcher(const ShaderWatcher&);
+    ShaderWatcher& operator=(const ShaderWatcher&);
+
+    void run();
+
+    std::vector<std::string> paths;
+    std::function<void()> onChange;
+    std::atomic<bool> changed;
+    std::atomic<bool> running;
+    std::thread thread;
+    int inotifyFd;      // Linux only
+    int stopPipe[2];    // Wakes the watcher thread up when stopping
+};
+
+#endif
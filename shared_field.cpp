@@ -0,0 +1,190 @@
+#include "shared_field.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "The shared ring needs lock-free 64-bit atomics, which work across processes"
+#endif
+
+static const size_t SHARED_FIELD_PAGE = 4096;
+
+
+static size_t roundUp(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+
+static void resetRing(SharedFieldRing* ring) {
+    ring->fd = -1;
+    ring->base = NULL;
+    ring->length = 0;
+    ring->header = NULL;
+    ring->slots = NULL;
+    ring->owner = false;
+    ring->writing = 0;
+}
+
+
+bool createSharedFieldRing(SharedFieldRing* ring, const char* name, int width, int height, int slotCount) {
+    resetRing(ring);
+    ring->name = name;
+    if (width <= 0 || height <= 0 || slotCount < 2) {
+        std::cerr << "Invalid shared field ring size" << std::endl;
+        return false;
+    }
+    size_t slotBytes = roundUp((size_t)width * (size_t)height * sizeof(float), SHARED_FIELD_PAGE);
+    size_t dataOffset = roundUp(sizeof(SharedFieldHeader) + slotCount * sizeof(SharedFieldSlot), SHARED_FIELD_PAGE);
+    ring->length = dataOffset + slotBytes * slotCount;
+
+    // Replace a ring left behind by an earlier run
+    shm_unlink(name);
+    ring->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (ring->fd < 0 || ftruncate(ring->fd, (off_t)ring->length) != 0) {
+        std::cerr << "Failed to create shared memory " << name << ": " << strerror(errno) << std::endl;
+        closeSharedFieldRing(ring);
+        return false;
+    }
+    ring->owner = true;
+    ring->base = mmap(NULL, ring->length, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+    if (ring->base == MAP_FAILED) {
+        ring->base = NULL;
+        std::cerr << "Failed to map shared memory " << name << ": " << strerror(errno) << std::endl;
+        closeSharedFieldRing(ring);
+        return false;
+    }
+
+    // The fresh object is all zeros; the atomics are constructed in place
+    ring->header = new (ring->base) SharedFieldHeader();
+    ring->slots = (SharedFieldSlot*)((char*)ring->base + sizeof(SharedFieldHeader));
+    for (int i = 0; i < slotCount; ++i) {
+        new (&ring->slots[i]) SharedFieldSlot();
+        ring->slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    ring->header->slotCount = (uint32_t)slotCount;
+    ring->header->width = (uint32_t)width;
+    ring->header->height = (uint32_t)height;
+    ring->header->slotBytes = slotBytes;
+    ring->header->dataOffset = dataOffset;
+    ring->header->latestFrame.store(0, std::memory_order_relaxed);
+    // The magic goes in last: a viewer that sees it also sees the rest of the header
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(ring->header->magic, "HMS1", 4);
+    return true;
+}
+
+
+bool openSharedFieldRing(SharedFieldRing* ring, const char* name) {
+    resetRing(ring);
+    ring->name = name;
+    ring->fd = shm_open(name, O_RDONLY, 0);
+    struct stat info;
+    if (ring->fd < 0 || fstat(ring->fd, &info) != 0) {
+        std::cerr << "Failed to open shared memory " << name << ": " << strerror(errno) << std::endl;
+        closeSharedFieldRing(ring);
+        return false;
+    }
+    ring->length = (size_t)info.st_size;
+    if (ring->length < sizeof(SharedFieldHeader)) {
+        std::cerr << "Shared memory " << name << " is too small for a field ring" << std::endl;
+        closeSharedFieldRing(ring);
+        return false;
+    }
+    ring->base = mmap(NULL, ring->length, PROT_READ, MAP_SHARED, ring->fd, 0);
+    if (ring->base == MAP_FAILED) {
+        ring->base = NULL;
+        std::cerr << "Failed to map shared memory " << name << ": " << strerror(errno) << std::endl;
+        closeSharedFieldRing(ring);
+        return false;
+    }
+    ring->header = (SharedFieldHeader*)ring->base;
+    ring->slots = (SharedFieldSlot*)((char*)ring->base + sizeof(SharedFieldHeader));
+    const SharedFieldHeader* header = ring->header;
+    // The magic first: the producer writes it last, so once it is there the fence makes the
+    // rest of the header visible
+    bool valid = memcmp(header->magic, "HMS1", 4) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // The header comes from another process, so every size is checked without letting the
+    // products wrap around
+    valid = valid && header->slotCount >= 2 && header->width > 0 && header->height > 0 &&
+            header->slotBytes >= (uint64_t)header->width * header->height * sizeof(float) &&
+            header->dataOffset >= sizeof(SharedFieldHeader) + header->slotCount * sizeof(SharedFieldSlot) &&
+            header->dataOffset <= ring->length &&
+            header->slotBytes <= (ring->length - header->dataOffset) / header->slotCount;
+    if (!valid) {
+        std::cerr << "Shared memory " << name << " is not a field ring" << std::endl;
+        closeSharedFieldRing(ring);
+        return false;
+    }
+    return true;
+}
+
+
+static float* slotData(const SharedFieldRing* ring, uint64_t frame) {
+    size_t slot = (size_t)(frame % ring->header->slotCount);
+    return (float*)((char*)ring->base + ring->header->dataOffset + slot * ring->header->slotBytes);
+}
+
+
+float* beginSharedFieldWrite(SharedFieldRing* ring) {
+    uint64_t frame = ring->header->latestFrame.load(std::memory_order_relaxed) + 1;
+    ring->writing = frame;
+    SharedFieldSlot* slot = &ring->slots[frame % ring->header->slotCount];
+    // Mark the slot as being written before touching its data
+    slot->sequence.store(2 * frame + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return slotData(ring, frame);
+}
+
+
+void endSharedFieldWrite(SharedFieldRing* ring) {
+    uint64_t frame = ring->writing;
+    ring->slots[frame % ring->header->slotCount].sequence.store(2 * frame + 2, std::memory_order_release);
+    ring->header->latestFrame.store(frame, std::memory_order_release);
+}
+
+
+bool readLatestSharedField(SharedFieldRing* ring, uint64_t lastFrame, uint64_t* frame,
+                           const std::function<void(const float*)>& consume) {
+    // A few attempts: each failure means the producer lapped us, so there is a newer frame
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        uint64_t latest = ring->header->latestFrame.load(std::memory_order_acquire);
+        if (latest == 0 || latest == lastFrame) {
+            return false;
+        }
+        const SharedFieldSlot* slot = &ring->slots[latest % ring->header->slotCount];
+        uint64_t before = slot->sequence.load(std::memory_order_acquire);
+        if (before != 2 * latest + 2) {
+            continue; // Already being overwritten
+        }
+        consume(slotData(ring, latest));
+        // The copy has to be done before the sequence is read again
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) == before) {
+            *frame = latest;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void closeSharedFieldRing(SharedFieldRing* ring) {
+    if (ring->base) {
+        munmap(ring->base, ring->length);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    if (ring->owner) {
+        shm_unlink(ring->name.c_str());
+    }
+    resetRing(ring);
+}
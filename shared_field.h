@@ -0,0 +1,77 @@
+/*
+    A ring of fields in POSIX shared memory, for a solver running on the same machine.
+
+    The producer creates the ring (shm_open + mmap) and writes every frame straight into the
+    next slot; the viewer maps the same memory and uploads the newest complete slot through
+    the pixel buffer path. A frame is copied exactly once on its way from the simulation to
+    the GPU: from the slot into the mapped PBO.
+
+    Layout of the shared object:
+
+        SharedFieldHeader                     (64 bytes)
+        SharedFieldSlot x slotCount           (64 bytes each)
+        slot data x slotCount                 (slotBytes each, page aligned, first at dataOffset)
+
+    Slots are reused round robin. Each slot's sequence works like a seqlock: it is odd while
+    the producer writes the slot and 2 * frame + 2 once frame is complete. The viewer checks
+    the sequence before and after copying, so a slot that was overwritten during the copy is
+    detected and copied again from the newest frame. The producer never waits for the viewer.
+*/
+
+#ifndef SHARED_FIELD_H
+#define SHARED_FIELD_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <stdint.h>
+#include <string>
+
+struct SharedFieldHeader {
+    char magic[4];                      // "HMS1"
+    uint32_t slotCount;
+    uint32_t width;
+    uint32_t height;
+    uint64_t slotBytes;                 // Distance between the data of two slots
+    uint64_t dataOffset;                // Byte offset of the first slot's data
+    std::atomic<uint64_t> latestFrame;  // Newest complete frame, 0 before the first one
+    char reserved[24];
+};
+
+struct SharedFieldSlot {
+    std::atomic<uint64_t> sequence;     // Odd while being written, 2 * frame + 2 when complete
+    char reserved[56];
+};
+
+struct SharedFieldRing {
+    int fd;
+    void* base;
+    size_t length;
+    SharedFieldHeader* header;
+    SharedFieldSlot* slots;
+    std::string name;
+    bool owner;                         // Created it: unlinks the name on close
+    uint64_t writing;                   // Producer: frame handed out by beginSharedFieldWrite
+};
+
+// Producer: create (or replace) the shared object name ("/heatmap", say) for width x height fields
+bool createSharedFieldRing(SharedFieldRing* ring, const char* name, int width, int height, int slotCount = 3);
+
+// Viewer: map an existing ring read-only
+bool openSharedFieldRing(SharedFieldRing* ring, const char* name);
+
+// Producer: the slot for the next frame (width * height floats, first row at the bottom).
+// Fill it, then publish it with endSharedFieldWrite.
+float* beginSharedFieldWrite(SharedFieldRing* ring);
+void endSharedFieldWrite(SharedFieldRing* ring);
+
+// Viewer: if a frame newer than lastFrame is complete, pass its data to consume and set
+// *frame. The data points into shared memory and is only valid during the call; consume may
+// be called again with a newer frame if the producer overwrote the slot meanwhile.
+// Returns false if there is no new frame.
+bool readLatestSharedField(SharedFieldRing* ring, uint64_t lastFrame, uint64_t* frame,
+                           const std::function<void(const float*)>& consume);
+
+void closeSharedFieldRing(SharedFieldRing* ring);
+
+#endif
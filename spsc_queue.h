@@ -0,0 +1,57 @@
+/*
+    A lock-free queue for exactly one producer thread and one consumer thread.
+
+    The slots form a ring; the producer only ever writes the head index and the consumer only
+    the tail index, so neither side takes a lock or waits for the other. A push on a full
+    queue or a pop on an empty one fails right away instead of blocking, which leaves the
+    decision what to do (drop, retry later) to the caller.
+*/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer side. Returns false if the queue is full.
+    bool tryPush(const T& item) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead - tail.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots[currentHead & (Capacity - 1)] = item;
+        // Publishes the slot: the consumer sees the item before it sees the new head
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool tryPop(T* item) {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *item = slots[currentTail & (Capacity - 1)];
+        // Hands the slot back to the producer
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+
+    T slots[Capacity];
+    // On separate cache lines, so the two threads don't keep stealing one line from each other
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+#endif
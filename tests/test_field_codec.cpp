@@ -0,0 +1,222 @@
+/*
+    Tests for the field codec (field_codec.h).
+
+    Every quantization with LZ4 and without a codec, on whole frames and on a sequence of
+    delta frames, each time with and without a thread pool:
+      - decoded frames are bit for bit what the encoder said the decoder would reconstruct,
+        and exact floats are bit for bit the input
+      - quantized values stay within half a quantization step of the input in every frame of
+        the sequence, so delta frames against the reconstruction don't drift
+      - corrupt or truncated frames are rejected
+
+    Prints every failed check and exits with 1 if there was one, for ctest.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "../field_codec.h"
+#include "../thread_pool.h"
+
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+
+// Several chunks of rows, the last one shorter than the others
+static const int WIDTH = 1024;
+static const int HEIGHT = 600;
+static const int FRAMES = 5;
+
+
+// Smooth rings that move with the frame, like a simulation would
+static void fillField(std::vector<float>* field, int frame) {
+    field->resize((size_t)WIDTH * HEIGHT);
+    for (int y = 0; y < HEIGHT; ++y) {
+        for (int x = 0; x < WIDTH; ++x) {
+            float dx = (float)(x - WIDTH / 2), dy = (float)(y - HEIGHT / 2);
+            (*field)[(size_t)y * WIDTH + x] = std::sin(0.05f * std::sqrt(dx * dx + dy * dy) - 0.3f * (float)frame);
+        }
+    }
+}
+
+
+// Values whose bit patterns only an exact codec keeps
+static void addSpecialValues(std::vector<float>* field) {
+    (*field)[0] = -0.0f;
+    (*field)[1] = std::numeric_limits<float>::denorm_min();
+    (*field)[2] = std::numeric_limits<float>::infinity();
+    (*field)[3] = -std::numeric_limits<float>::infinity();
+    (*field)[4] = std::numeric_limits<float>::quiet_NaN();
+}
+
+
+static bool sameBits(const std::vector<float>& a, const std::vector<float>& b) {
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+
+static float largestError(const std::vector<float>& a, const std::vector<float>& b) {
+    float largest = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        largest = std::max(largest, std::fabs(a[i] - b[i]));
+    }
+    return largest;
+}
+
+
+static std::string describe(FieldQuantization quantization, FieldCodec codec, ThreadPool* pool) {
+    const char* quantizations[] = { "none", "16", "8" };
+    return std::string("quantization ") + quantizations[quantization] + ", codec " +
+           (codec == FIELD_CODEC_LZ4 ? "lz4" : "none") + (pool ? ", pool" : "");
+}
+
+
+// A sequence of FRAMES frames, the first one whole and the rest as deltas
+static void testSequence(FieldQuantization quantization, FieldCodec codec, ThreadPool* pool) {
+    std::string name = describe(quantization, codec, pool);
+    FieldEncoding encoding = defaultFieldEncoding();
+    encoding.quantization = quantization;
+    encoding.codec = codec;
+    // The delta frames share one range, as a recording does
+    encoding.fixedRange = quantization != FIELD_QUANTIZE_NONE;
+    encoding.rangeMin = -1.0f;
+    encoding.rangeMax = 1.0f;
+    float step = quantization == FIELD_QUANTIZE_16 ? 2.0f / 65535.0f : 2.0f / 255.0f;
+
+    std::vector<float> field, reconstructed((size_t)WIDTH * HEIGHT), decoded((size_t)WIDTH * HEIGHT);
+    std::vector<float> previousReconstructed, previousDecoded;
+    std::vector<unsigned char> bytes;
+    for (int frame = 0; frame < FRAMES; ++frame) {
+        std::string what = name + ", frame " + std::to_string(frame);
+        fillField(&field, frame);
+        if (quantization == FIELD_QUANTIZE_NONE) {
+            addSpecialValues(&field);
+        }
+        const float* reference = frame > 0 ? previousReconstructed.data() : NULL;
+        if (!encodeCompressedField(field.data(), WIDTH, HEIGHT, reference, encoding, &bytes, reconstructed.data(),
+                                   pool)) {
+            check(false, what + ": encodes");
+            return;
+        }
+        CompressedFieldHeader header;
+        check(readCompressedFieldHeader(bytes.data(), bytes.size(), &header) && header.chunkCount > 1 &&
+                  header.delta == (frame > 0 ? 1 : 0),
+              what + ": header");
+        // The decoder only has what it decoded itself
+        bool ok = decodeCompressedField(bytes.data(), bytes.size(), frame > 0 ? previousDecoded.data() : NULL,
+                                        decoded.data(), pool);
+        check(ok, what + ": decodes");
+        if (!ok) {
+            return;
+        }
+        check(sameBits(decoded, reconstructed), what + ": decoded as reconstructed");
+        if (quantization == FIELD_QUANTIZE_NONE) {
+            check(sameBits(decoded, field), what + ": exact");
+        } else {
+            // Rounded to the nearest level (give or take the float rounding of the level
+            // itself), in every frame however long the sequence
+            check(largestError(decoded, field) <= 0.5f * step + 1e-6f, what + ": within half a step");
+        }
+        previousReconstructed = reconstructed;
+        previousDecoded = decoded;
+    }
+    // Decoding in place: the reference may be the output
+    std::vector<float> inPlace = previousDecoded;
+    fillField(&field, FRAMES);
+    if (quantization == FIELD_QUANTIZE_NONE) {
+        addSpecialValues(&field);
+    }
+    encodeCompressedField(field.data(), WIDTH, HEIGHT, previousReconstructed.data(), encoding, &bytes,
+                          reconstructed.data(), pool);
+    check(decodeCompressedField(bytes.data(), bytes.size(), inPlace.data(), inPlace.data(), pool) &&
+              sameBits(inPlace, reconstructed),
+          name + ": delta decoded in place");
+}
+
+
+// Damaged frames have to be rejected, not decoded into garbage or read past their end
+static void testCorruptInput(ThreadPool* pool) {
+    std::vector<float> field, decoded((size_t)WIDTH * HEIGHT);
+    fillField(&field, 0);
+    FieldEncoding encoding = defaultFieldEncoding();
+    std::vector<unsigned char> bytes;
+    check(encodeCompressedField(field.data(), WIDTH, HEIGHT, NULL, encoding, &bytes, NULL, pool), "corrupt: encodes");
+    CompressedFieldHeader header;
+    readCompressedFieldHeader(bytes.data(), bytes.size(), &header);
+    size_t tableOffset = sizeof(header);
+    size_t firstChunk = tableOffset + (size_t)header.chunkCount * 4;
+    uint32_t firstChunkSize;
+    memcpy(&firstChunkSize, &bytes[tableOffset], 4);
+    check(firstChunkSize < (uint32_t)(header.chunkRows * WIDTH * 4), "corrupt: the field compresses");
+
+    std::vector<unsigned char> damaged = bytes;
+    damaged[0] = 'X';
+    check(!decodeCompressedField(damaged.data(), damaged.size(), NULL, decoded.data(), pool), "corrupt: bad magic");
+
+    check(!decodeCompressedField(bytes.data(), sizeof(header) - 1, NULL, decoded.data(), pool),
+          "corrupt: truncated header");
+    check(!decodeCompressedField(bytes.data(), bytes.size() - 1, NULL, decoded.data(), pool),
+          "corrupt: truncated data");
+
+    damaged = bytes;
+    uint32_t chunkSize = firstChunkSize + 1;
+    memcpy(&damaged[tableOffset], &chunkSize, 4);
+    check(!decodeCompressedField(damaged.data(), damaged.size(), NULL, decoded.data(), pool),
+          "corrupt: chunk table doesn't add up");
+
+    damaged = bytes;
+    damaged[tableOffset - 1] ^= 0x80;   // The top byte of dataBytes
+    check(!decodeCompressedField(damaged.data(), damaged.size(), NULL, decoded.data(), pool),
+          "corrupt: dataBytes past the end");
+
+    damaged = bytes;
+    uint32_t hugeWidth = 1u << 31;
+    memcpy(&damaged[4], &hugeWidth, 4);
+    check(!decodeCompressedField(damaged.data(), damaged.size(), NULL, decoded.data(), pool), "corrupt: huge size");
+
+    // Long literal runs that go past the end of the chunk
+    damaged = bytes;
+    memset(&damaged[firstChunk], 0xff, firstChunkSize);
+    check(!decodeCompressedField(damaged.data(), damaged.size(), NULL, decoded.data(), pool),
+          "corrupt: LZ4 chunk overruns");
+
+    std::vector<float> reference = field;
+    encodeCompressedField(field.data(), WIDTH, HEIGHT, reference.data(), encoding, &bytes, NULL, pool);
+    check(!decodeCompressedField(bytes.data(), bytes.size(), NULL, decoded.data(), pool),
+          "corrupt: delta frame without its reference");
+}
+
+
+int main() {
+    ThreadPool pool(4);
+    ThreadPool* pools[] = { NULL, &pool };
+    FieldQuantization quantizations[] = { FIELD_QUANTIZE_NONE, FIELD_QUANTIZE_16, FIELD_QUANTIZE_8 };
+    FieldCodec codecs[] = { FIELD_CODEC_NONE, FIELD_CODEC_LZ4 };
+    for (int p = 0; p < 2; ++p) {
+        for (int q = 0; q < 3; ++q) {
+            for (int c = 0; c < 2; ++c) {
+                testSequence(quantizations[q], codecs[c], pools[p]);
+            }
+        }
+        testCorruptInput(pools[p]);
+    }
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All field codec checks passed" << std::endl;
+    return 0;
+}
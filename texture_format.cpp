@@ -0,0 +1,201 @@
+#include "texture_format.h"
+#include "cpu_dispatch.h"
+#include "rgtc_encoder.h"
+
+#include <cstring>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HEATMAP_HAVE_F16C_PACK 1
+#include <immintrin.h>
+#endif
+
+
+GLenum heatmapInternalFormat(HeatmapFormat format) {
+    switch (format) {
+    case HEATMAP_FORMAT_R16F: return GL_R16F;
+    case HEATMAP_FORMAT_R16: return GL_R16;
+    case HEATMAP_FORMAT_R8: return GL_R8;
+    case HEATMAP_FORMAT_BC4: return GL_COMPRESSED_RED_RGTC1;
+    default: return GL_R32F;
+    }
+}
+
+
+GLenum heatmapPixelType(HeatmapFormat format) {
+    switch (format) {
+    case HEATMAP_FORMAT_R16F: return GL_HALF_FLOAT;
+    case HEATMAP_FORMAT_R16: return GL_UNSIGNED_SHORT;
+    case HEATMAP_FORMAT_R8: return GL_UNSIGNED_BYTE;
+    case HEATMAP_FORMAT_BC4: return GL_UNSIGNED_BYTE;
+    default: return GL_FLOAT;
+    }
+}
+
+
+const char* heatmapImageFormat(HeatmapFormat format) {
+    switch (format) {
+    case HEATMAP_FORMAT_R16F: return "r16f";
+    case HEATMAP_FORMAT_R16: return "r16";
+    case HEATMAP_FORMAT_R8: return "r8";
+    case HEATMAP_FORMAT_BC4: return NULL;
+    default: return "r32f";
+    }
+}
+
+
+bool heatmapFormatIsCompressed(HeatmapFormat format) {
+    return format == HEATMAP_FORMAT_BC4;
+}
+
+
+size_t heatmapBytesPerTexel(HeatmapFormat format) {
+    switch (format) {
+    case HEATMAP_FORMAT_R16F: return 2;
+    case HEATMAP_FORMAT_R16: return 2;
+    case HEATMAP_FORMAT_R8: return 1;
+    case HEATMAP_FORMAT_BC4: return 0;
+    default: return 4;
+    }
+}
+
+
+size_t heatmapFrameBytes(HeatmapFormat format, int width, int height) {
+    if (format == HEATMAP_FORMAT_BC4) {
+        return rgtcBlockBytes(width, height);
+    }
+    return (size_t)width * (size_t)height * heatmapBytesPerTexel(format);
+}
+
+
+const char* heatmapFormatName(HeatmapFormat format) {
+    return format == HEATMAP_FORMAT_BC4 ? "bc4" : heatmapImageFormat(format);
+}
+
+
+bool parseHeatmapFormat(const std::string& name, HeatmapFormat* format) {
+    const HeatmapFormat formats[] = { HEATMAP_FORMAT_R32F, HEATMAP_FORMAT_R16F, HEATMAP_FORMAT_R16, HEATMAP_FORMAT_R8,
+                                      HEATMAP_FORMAT_BC4 };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+        if (name == heatmapFormatName(formats[i])) {
+            *format = formats[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// IEEE 754 single to half precision, rounding to nearest even like the F16C instruction
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponentBits = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    // Infinity stays infinity, NaN stays a (quiet) NaN
+    if (exponentBits == 0xff) {
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    int exponent = (int)exponentBits - 127 + 15;
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7c00); // Too large for half: infinity
+    }
+    if (exponent <= 0) {
+        // Result is a subnormal half (or zero): shift the mantissa including its implicit 1
+        if (exponent < -10) {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            ++half;
+        }
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    // A carry out of the mantissa correctly bumps the exponent (up to infinity)
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return (uint16_t)(sign | half);
+}
+
+
+static void packHalfScalar(const float* src, uint16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = floatToHalf(src[i]);
+    }
+}
+
+
+#ifdef HEATMAP_HAVE_F16C_PACK
+// Eight floats to eight halves per instruction. Only called after the runtime F16C check.
+__attribute__((target("avx,f16c")))
+static void packHalfF16C(const float* src, uint16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(dst + i), half);
+    }
+    packHalfScalar(src + i, dst + i, count - i);
+}
+#endif
+
+
+static void packHalf(const float* src, uint16_t* dst, size_t count) {
+#ifdef HEATMAP_HAVE_F16C_PACK
+    static const bool hasF16C = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    if (hasF16C) {
+        packHalfF16C(src, dst, count);
+        return;
+    }
+#endif
+    packHalfScalar(src, dst, count);
+}
+
+
+// Normalized integer formats store round(clamp(v, 0, 1) * maxValue). The comparisons are
+// written so that NaN fails them and becomes 0; converting it to an integer is undefined.
+// The loops vectorize, so they are built per instruction set (see cpu_dispatch.h).
+HEATMAP_TARGET_CLONES
+static void packUnorm16(const float* src, uint16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        float v = src[i];
+        v = v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+        dst[i] = (uint16_t)(v * 65535.0f + 0.5f);
+    }
+}
+
+
+HEATMAP_TARGET_CLONES
+static void packUnorm8(const float* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        float v = src[i];
+        v = v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+        dst[i] = (uint8_t)(v * 255.0f + 0.5f);
+    }
+}
+
+
+void packHeatmapTexels(const float* src, void* dst, size_t count, HeatmapFormat format) {
+    switch (format) {
+    case HEATMAP_FORMAT_R16F:
+        packHalf(src, (uint16_t*)dst, count);
+        break;
+    case HEATMAP_FORMAT_R16:
+        packUnorm16(src, (uint16_t*)dst, count);
+        break;
+    case HEATMAP_FORMAT_R8:
+        packUnorm8(src, (uint8_t*)dst, count);
+        break;
+    default:
+        memcpy(dst, src, count * sizeof(float));
+        break;
+    }
+}
@@ -0,0 +1,58 @@
+/*
+    Texel formats for the heatmap texture.
+
+    The generator always produces floats. When a dataset doesn't need full float precision,
+    storing it as half floats or 8/16-bit normalized integers halves or quarters both the
+    texture memory and the upload bandwidth. The CPU packs the floats into the chosen format
+    (with F16C when the CPU has it) before they are handed to OpenGL.
+
+    bc4 goes further and block-compresses the field (see rgtc_encoder.h). Compressed textures
+    can only be uploaded whole and can't be written by shaders, so it only suits a single
+    texture filled from the CPU: no panels, tiles, GPU generation or mipmap pyramid.
+*/
+
+#ifndef TEXTURE_FORMAT_H
+#define TEXTURE_FORMAT_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <string>
+
+enum HeatmapFormat {
+    HEATMAP_FORMAT_R32F,    // 32-bit float, exact copy of the generated data
+    HEATMAP_FORMAT_R16F,    // 16-bit half float
+    HEATMAP_FORMAT_R16,     // 16-bit unsigned normalized, values clamped to [0, 1]
+    HEATMAP_FORMAT_R8,      // 8-bit unsigned normalized, values clamped to [0, 1]
+    HEATMAP_FORMAT_BC4      // RGTC1 blocks, half a byte per texel, values clamped to [0, 1]
+};
+
+// Sized internal format passed to glTexStorage2D / glTexImage2D (GL_R32F, GL_R16F, ...,
+// GL_COMPRESSED_RED_RGTC1)
+GLenum heatmapInternalFormat(HeatmapFormat format);
+
+// Pixel type of the packed client data (GL_FLOAT, GL_HALF_FLOAT, ...)
+GLenum heatmapPixelType(HeatmapFormat format);
+
+// Format qualifier for image load/store in GLSL ("r32f", "r16f", ...); NULL for bc4,
+// which image load/store can't write
+const char* heatmapImageFormat(HeatmapFormat format);
+
+// true for bc4: uploads go through glCompressedTexSubImage2D with whole blocks
+bool heatmapFormatIsCompressed(HeatmapFormat format);
+
+// 0 for bc4, which has no whole bytes per texel; heatmapFrameBytes works for every format
+size_t heatmapBytesPerTexel(HeatmapFormat format);
+
+// Bytes of a packed width x height field
+size_t heatmapFrameBytes(HeatmapFormat format, int width, int height);
+
+const char* heatmapFormatName(HeatmapFormat format);
+
+// Parse "r32f", "r16f", "r16", "r8" or "bc4". Returns false for anything else.
+bool parseHeatmapFormat(const std::string& name, HeatmapFormat* format);
+
+// Convert count floats into the packed representation of format. Not for bc4, whose blocks
+// span four rows (see encodeRgtcBlocks).
+void packHeatmapTexels(const float* src, void* dst, size_t count, HeatmapFormat format);
+
+#endif
@@ -0,0 +1,320 @@
+#include "texture_stream.h"
+#include "rgtc_encoder.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+// Block until the GPU has consumed the given ring slot, then forget its fence
+static void waitForSlot(TextureStream* stream, int slot) {
+    if (!stream->fence[slot]) {
+        return;
+    }
+    // Flush on the first wait so the fence is guaranteed to be submitted, then keep waiting.
+    // With three slots this only blocks if the CPU runs more than two frames ahead of the GPU.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(stream->fence[slot], flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+        flags = 0;
+    }
+    glDeleteSync(stream->fence[slot]);
+    stream->fence[slot] = 0;
+}
+
+
+void clearTextureStream(TextureStream* stream) {
+    stream->texture = 0;
+    for (int i = 0; i < TEXTURE_STREAM_RING_SIZE; ++i) {
+        stream->pbo[i] = 0;
+        stream->fence[i] = 0;
+        stream->mapped[i] = NULL;
+    }
+    stream->width = stream->height = 0;
+    stream->format = HEATMAP_FORMAT_R32F;
+    stream->levels = 1;
+    stream->frameBytes = 0;
+    stream->current = 0;
+    stream->persistent = false;
+}
+
+
+GLuint createFieldTexture(int width, int height, HeatmapFormat format, int levels) {
+    // Sized single-channel format when the driver knows about it (GL 3.0),
+    // otherwise let the driver pick the precision like before
+    // (bc4 is only chosen where RGTC is supported, see main)
+    GLenum internalFormat = (GLEW_VERSION_3_0 || GLEW_ARB_texture_rg || heatmapFormatIsCompressed(format))
+                            ? heatmapInternalFormat(format) : GL_RED;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // Allocate the storage once. Immutable storage (GL 4.2) tells the driver the size will
+    // never change, so later uploads don't need to revalidate the texture.
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+        glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+    } else {
+        for (int level = 0; level < levels; ++level) {
+            int levelWidth = width >> level > 0 ? width >> level : 1;
+            int levelHeight = height >> level > 0 ? height >> level : 1;
+            if (heatmapFormatIsCompressed(format)) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, levelWidth, levelHeight, 0,
+                                       (GLsizei)heatmapFrameBytes(format, levelWidth, levelHeight), NULL);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, level, internalFormat, levelWidth, levelHeight, 0, GL_RED,
+                             heatmapPixelType(format), NULL);
+            }
+        }
+    }
+    // Same sampling state as the original one-shot texture,
+    // plus trilinear filtering between the mipmap levels if there are any
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    return texture;
+}
+
+
+bool createTextureStream(TextureStream* stream, int width, int height, HeatmapFormat format, int levels) {
+    // Every slot is empty until it is set up, so a failure halfway leaves nothing undefined to free
+    clearTextureStream(stream);
+    stream->width = width;
+    stream->height = height;
+    stream->format = format;
+    stream->levels = levels;
+    stream->frameBytes = heatmapFrameBytes(format, width, height);
+    stream->current = 0;
+    // Persistent mapping needs both buffer storage (GL 4.4) and fences (GL 3.2)
+    stream->persistent = (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) && (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+
+    stream->texture = createFieldTexture(width, height, format, levels);
+
+    glGenBuffers(TEXTURE_STREAM_RING_SIZE, stream->pbo);
+    for (int i = 0; i < TEXTURE_STREAM_RING_SIZE; ++i) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pbo[i]);
+        if (stream->persistent) {
+            // Coherent mapping: CPU writes become visible to the GPU without explicit flushes
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, stream->frameBytes, NULL, flags);
+            stream->mapped[i] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, stream->frameBytes, flags);
+            if (!stream->mapped[i]) {
+                std::cerr << "Failed to persistently map pixel buffer " << i << std::endl;
+                destroyTextureStream(stream);
+                return false;
+            }
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, stream->frameBytes, NULL, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return true;
+}
+
+
+void* beginTextureStreamUpload(TextureStream* stream) {
+    // Move on to the oldest slot in the ring
+    stream->current = (stream->current + 1) % TEXTURE_STREAM_RING_SIZE;
+    int slot = stream->current;
+
+    if (stream->persistent) {
+        // The GPU may still be copying out of this slot from three uploads ago
+        waitForSlot(stream, slot);
+        return stream->mapped[slot];
+    }
+
+    // Orphan the old storage so mapping never has to wait for a pending copy
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pbo[slot]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, stream->frameBytes, NULL, GL_STREAM_DRAW);
+    void* ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!ptr) {
+        std::cerr << "Failed to map pixel buffer " << slot << std::endl;
+    }
+    return ptr;
+}
+
+
+// Copy the given rectangles of the current PBO (laid out as a full frame) into texture
+static void finishUpload(TextureStream* stream, GLuint texture, const DirtyRect* rects, size_t count) {
+    int slot = stream->current;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pbo[slot]);
+    if (!stream->persistent) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    // With a PBO bound, the last argument is a byte offset into the buffer instead of a pointer
+    // Rows of 8 and 16-bit texels are not padded to 4 bytes, so relax the unpack alignment.
+    // The row length is the full field width, so a rectangle is read in place out of the frame.
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (heatmapFormatIsCompressed(stream->format)) {
+        // Blocks can only be copied whole; uploads of compressed fields always cover the texture
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stream->width, stream->height,
+                                  heatmapInternalFormat(stream->format), (GLsizei)stream->frameBytes, (void*)0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (stream->persistent) {
+            stream->fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        return;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stream->width);
+    size_t bytesPerTexel = heatmapBytesPerTexel(stream->format);
+    for (size_t i = 0; i < count; ++i) {
+        const DirtyRect& rect = rects[i];
+        size_t offset = ((size_t)rect.y * stream->width + rect.x) * bytesPerTexel;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, GL_RED,
+                        heatmapPixelType(stream->format), (void*)offset);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (stream->persistent) {
+        // Remember when the GPU is done reading, so we don't overwrite the slot too early
+        stream->fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+
+void endTextureStreamUpload(TextureStream* stream) {
+    DirtyRect all = { 0, 0, stream->width, stream->height };
+    finishUpload(stream, stream->texture, &all, 1);
+}
+
+
+bool uploadTextureStreamTo(TextureStream* stream, GLuint texture, const float* data, ThreadPool* pool) {
+    unsigned char* dst = (unsigned char*)beginTextureStreamUpload(stream);
+    if (!dst) {
+        // Nothing was mapped, so there is nothing to unmap or copy: the texture keeps its last field
+        return false;
+    }
+    if (heatmapFormatIsCompressed(stream->format)) {
+        encodeRgtcBlocks(data, stream->width, stream->height, dst, pool);
+    } else if (pool && pool->threadCount() > 1) {
+        // Bands of rows, a few per worker
+        size_t rowTexels = (size_t)stream->width;
+        size_t rowBytes = rowTexels * heatmapBytesPerTexel(stream->format);
+        int grain = stream->height / (int)(pool->threadCount() * 4);
+        pool->parallelFor(0, stream->height, grain > 0 ? grain : 1, [&](int rowBegin, int rowEnd) {
+            packHeatmapTexels(data + rowBegin * rowTexels, dst + rowBegin * rowBytes,
+                              (rowEnd - rowBegin) * rowTexels, stream->format);
+        });
+    } else {
+        packHeatmapTexels(data, dst, (size_t)stream->width * (size_t)stream->height, stream->format);
+    }
+    DirtyRect all = { 0, 0, stream->width, stream->height };
+    finishUpload(stream, texture, &all, 1);
+    return true;
+}
+
+
+bool uploadTextureStream(TextureStream* stream, const float* data, ThreadPool* pool) {
+    return uploadTextureStreamTo(stream, stream->texture, data, pool);
+}
+
+
+// true if the rectangles overlap or share an edge
+static bool rectsTouch(const DirtyRect& a, const DirtyRect& b) {
+    return a.x <= b.x + b.width && b.x <= a.x + a.width && a.y <= b.y + b.height && b.y <= a.y + a.height;
+}
+
+
+void coalesceDirtyRects(std::vector<DirtyRect>* rects, int width, int height) {
+    // Clip to the field and drop what is left empty
+    std::vector<DirtyRect> clipped;
+    for (size_t i = 0; i < rects->size(); ++i) {
+        DirtyRect rect = (*rects)[i];
+        int right = std::min(rect.x + rect.width, width);
+        int top = std::min(rect.y + rect.height, height);
+        rect.x = std::max(rect.x, 0);
+        rect.y = std::max(rect.y, 0);
+        rect.width = right - rect.x;
+        rect.height = top - rect.y;
+        if (rect.width > 0 && rect.height > 0) {
+            clipped.push_back(rect);
+        }
+    }
+
+    // Replace touching pairs by their bounding box. A merged box can reach rectangles that
+    // neither part touched, so start over after every merge; the lists here are short.
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < clipped.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < clipped.size() && !merged; ++j) {
+                if (!rectsTouch(clipped[i], clipped[j])) {
+                    continue;
+                }
+                DirtyRect& a = clipped[i];
+                const DirtyRect& b = clipped[j];
+                int right = std::max(a.x + a.width, b.x + b.width);
+                int top = std::max(a.y + a.height, b.y + b.height);
+                a.x = std::min(a.x, b.x);
+                a.y = std::min(a.y, b.y);
+                a.width = right - a.x;
+                a.height = top - a.y;
+                clipped.erase(clipped.begin() + j);
+                merged = true;
+            }
+        }
+    }
+    rects->swap(clipped);
+}
+
+
+bool updateTextureStreamRects(TextureStream* stream, const float* data, std::vector<DirtyRect> rects,
+                              ThreadPool* pool) {
+    coalesceDirtyRects(&rects, stream->width, stream->height);
+    if (rects.empty()) {
+        return true;
+    }
+    if (heatmapFormatIsCompressed(stream->format)) {
+        // Compressed textures take whole frames only
+        return uploadTextureStreamTo(stream, stream->texture, data, pool);
+    }
+    unsigned char* dst = (unsigned char*)beginTextureStreamUpload(stream);
+    if (!dst) {
+        return false;
+    }
+    // Pack the rows of every rectangle into the place they have in a full frame
+    size_t bytesPerTexel = heatmapBytesPerTexel(stream->format);
+    for (size_t i = 0; i < rects.size(); ++i) {
+        const DirtyRect& rect = rects[i];
+        auto packRows = [&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; ++y) {
+                size_t offset = (size_t)y * stream->width + rect.x;
+                packHeatmapTexels(data + offset, dst + offset * bytesPerTexel, rect.width, stream->format);
+            }
+        };
+        if (pool && pool->threadCount() > 1 && rect.height > 1) {
+            int grain = rect.height / (int)(pool->threadCount() * 4);
+            pool->parallelFor(rect.y, rect.y + rect.height, grain > 0 ? grain : 1, packRows);
+        } else {
+            packRows(rect.y, rect.y + rect.height);
+        }
+    }
+    finishUpload(stream, stream->texture, rects.data(), rects.size());
+    return true;
+}
+
+
+void destroyTextureStream(TextureStream* stream) {
+    for (int i = 0; i < TEXTURE_STREAM_RING_SIZE; ++i) {
+        waitForSlot(stream, i);
+        if (stream->mapped[i]) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pbo[i]);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            stream->mapped[i] = NULL;
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(TEXTURE_STREAM_RING_SIZE, stream->pbo);
+    glDeleteTextures(1, &stream->texture);
+    // Names of 0 are ignored by the deletes, so destroying the stream again does nothing
+    for (int i = 0; i < TEXTURE_STREAM_RING_SIZE; ++i) {
+        stream->pbo[i] = 0;
+    }
+    stream->texture = 0;
+}
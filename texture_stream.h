@@ -0,0 +1,100 @@
+/*
+    Streaming uploads for the heatmap texture.
+
+    The texture storage is allocated exactly once. New scalar fields are written into one of
+    a ring of pixel buffer objects (PBOs) and copied into the texture with glTexSubImage2D,
+    which reads from the bound PBO instead of client memory. Because the copy is queued on the
+    GPU, the CPU can already fill the next PBO while the previous frame is still being drawn.
+
+    When GL 4.4 / ARB_buffer_storage is available, every PBO is mapped once with persistent and
+    coherent flags and a fence per slot tells us when the GPU has finished reading it.
+    Otherwise we fall back to orphaning the buffer with glBufferData(NULL) before each map,
+    which lets the driver hand us fresh memory instead of waiting for the old contents.
+*/
+
+#ifndef TEXTURE_STREAM_H
+#define TEXTURE_STREAM_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+#include "texture_format.h"
+
+class ThreadPool;
+
+// Number of pixel buffer objects the uploads rotate through
+const int TEXTURE_STREAM_RING_SIZE = 3;
+
+struct TextureStream {
+    GLuint texture;                                 // The texture the shader samples from
+    GLuint pbo[TEXTURE_STREAM_RING_SIZE];           // Ring of pixel unpack buffers
+    GLsync fence[TEXTURE_STREAM_RING_SIZE];         // Signalled once the GPU finished reading a slot
+    void* mapped[TEXTURE_STREAM_RING_SIZE];         // Persistent pointers (only used with buffer storage)
+    int width;
+    int height;
+    HeatmapFormat format;                           // Texel format of the texture and the PBO contents
+    int levels;                                     // Mipmap levels; uploads only write level 0
+    size_t frameBytes;                              // Size of one full field in bytes
+    int current;                                    // Slot handed out by the last beginTextureStreamUpload
+    bool persistent;                                // true when the PBOs are persistently mapped
+};
+
+// A rectangle of texels that changed since the last upload
+struct DirtyRect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// The state of a stream that was never created: every name 0 and nothing mapped, which
+// destroyTextureStream accepts. createTextureStream starts from it as well.
+void clearTextureStream(TextureStream* stream);
+
+// Allocate a width x height texture with immutable storage (where available) and the
+// sampling state the display shader expects. createTextureStream uses it for its texture.
+GLuint createFieldTexture(int width, int height, HeatmapFormat format, int levels = 1);
+
+// Allocate the texture and the PBO ring. Returns false if the buffers could not be created;
+// whatever was allocated is freed again and every name is 0.
+// With levels > 1 the texture gets a mipmap chain sampled with trilinear filtering;
+// the caller fills the lower levels (see lod_pyramid.h).
+bool createTextureStream(TextureStream* stream, int width, int height,
+                         HeatmapFormat format = HEATMAP_FORMAT_R32F, int levels = 1);
+
+// Returns a pointer to width * height texels in the stream's format (packed, no row padding;
+// for bc4 the rows of blocks, see rgtc_encoder.h) that the caller fills with the next field. The pointer is only valid until
+// endTextureStreamUpload is called. NULL if the buffer couldn't be mapped: then skip
+// endTextureStreamUpload, and the texture keeps its last field.
+void* beginTextureStreamUpload(TextureStream* stream);
+
+// Queue the copy from the current PBO into the texture.
+void endTextureStreamUpload(TextureStream* stream);
+
+// Convenience wrapper: pack a complete float field from client memory into the stream's
+// format while copying it through the PBO ring. With a pool, the rows are copied in parallel,
+// which also overlaps the page faults when data is a memory-mapped file.
+// Returns false (and leaves the texture as it was) if the pixel buffer couldn't be mapped.
+bool uploadTextureStream(TextureStream* stream, const float* data, ThreadPool* pool = 0);
+
+// The same, but into another texture of the stream's size and format (see createFieldTexture),
+// so one ring of pixel buffers can feed several textures
+bool uploadTextureStreamTo(TextureStream* stream, GLuint texture, const float* data, ThreadPool* pool = 0);
+
+// Clip the rectangles to the field and merge the ones that overlap or touch, until no two of
+// them do. Every texel is then uploaded at most once per update.
+void coalesceDirtyRects(std::vector<DirtyRect>* rects, int width, int height);
+
+// Upload only the dirty rectangles of a complete float field in client memory. The rectangles
+// are coalesced first; then only their texels are packed into the PBO (at the same place they
+// have in a full frame) and copied with one glTexSubImage2D each, using GL_UNPACK_ROW_LENGTH
+// to step over the rest of every row. The texels outside the rectangles keep their contents.
+// Compressed streams upload the whole field instead. false if nothing could be uploaded.
+bool updateTextureStreamRects(TextureStream* stream, const float* data, std::vector<DirtyRect> rects,
+                              ThreadPool* pool = 0);
+
+// Release the texture, the PBOs and any pending fences, and set their names to 0.
+void destroyTextureStream(TextureStream* stream);
+
+#endif
@@ -0,0 +1,86 @@
+#include "thread_pool.h"
+
+
+ThreadPool::ThreadPool(unsigned threadCount) : stopping(false) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (threadCount == 0) {
+        threadCount = 1; // hardware_concurrency is allowed to return 0 when it can't tell
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(task);
+    }
+    wake.notify_one();
+}
+
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& fn) {
+    if (end <= begin) {
+        return;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    // Count outstanding chunks; the last one to finish wakes up the caller
+    std::mutex doneMutex;
+    std::condition_variable doneSignal;
+    int remaining = (end - begin + grain - 1) / grain;
+
+    for (int chunkBegin = begin; chunkBegin < end; chunkBegin += grain) {
+        int chunkEnd = chunkBegin + grain < end ? chunkBegin + grain : end;
+        submit([&, chunkBegin, chunkEnd]() {
+            fn(chunkBegin, chunkEnd);
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (--remaining == 0) {
+                doneSignal.notify_one();
+            }
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    while (remaining > 0) {
+        doneSignal.wait(lock);
+    }
+}
+
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping && tasks.empty()) {
+                wake.wait(lock);
+            }
+            // Drain the queue before exiting so nobody waits on a task that never runs
+            if (tasks.empty()) {
+                return;
+            }
+            task = tasks.front();
+            tasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,46 @@
+/*
+    A small fixed-size thread pool.
+
+    Worker threads are started once and sleep on a condition variable until tasks arrive,
+    so splitting work across cores doesn't pay for thread creation every time.
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // threadCount == 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    // Queue a task to run on one of the workers
+    void submit(std::function<void()> task);
+
+    // Split [begin, end) into chunks of at most grain items, run fn(chunkBegin, chunkEnd)
+    // for every chunk on the workers and wait until all of them are finished.
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& fn);
+
+    unsigned threadCount() const { return (unsigned)workers.size(); }
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()> > tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+};
+
+#endif
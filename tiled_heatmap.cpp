@@ -0,0 +1,265 @@
+#include "tiled_heatmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+
+bool createTiledHeatmap(TiledHeatmap* heatmap, int fieldWidth, int fieldHeight, int tileSize,
+                        size_t vramBudgetBytes, HeatmapFormat format, const TileSource& source) {
+    if (tileSize < 3) {
+        std::cerr << "Tiles need at least 3x3 texels, one on each side is border" << std::endl;
+        return false;
+    }
+    int tileStep = tileSize - 2;
+    heatmap->fieldWidth = fieldWidth;
+    heatmap->fieldHeight = fieldHeight;
+    heatmap->tileSize = tileSize;
+    heatmap->tileStep = tileStep;
+    heatmap->tilesX = (fieldWidth + tileStep - 1) / tileStep;
+    heatmap->tilesY = (fieldHeight + tileStep - 1) / tileStep;
+    heatmap->format = format;
+    heatmap->source = source;
+    heatmap->frame = 0;
+    heatmap->maxUploadsPerFrame = 8;
+    heatmap->warnedBudget = false;
+
+    // As many resident tiles as fit in the budget, but never more than the field has
+    size_t tileBytes = (size_t)tileSize * (size_t)tileSize * heatmapBytesPerTexel(format);
+    size_t slotCount = vramBudgetBytes / tileBytes;
+    size_t tileCount = (size_t)heatmap->tilesX * (size_t)heatmap->tilesY;
+    slotCount = std::min(slotCount, tileCount);
+    if (slotCount == 0) {
+        std::cerr << "VRAM budget is smaller than a single " << tileSize << "x" << tileSize << " tile" << std::endl;
+        return false;
+    }
+
+    heatmap->slotTexture.resize(slotCount);
+    heatmap->slotTile.assign(slotCount, -1);
+    heatmap->slotLastUsed.assign(slotCount, 0);
+    heatmap->scratch.resize((size_t)tileSize * (size_t)tileSize);
+    heatmap->packed.resize(tileBytes);
+
+    glGenTextures((GLsizei)slotCount, heatmap->slotTexture.data());
+    for (size_t i = 0; i < slotCount; ++i) {
+        glBindTexture(GL_TEXTURE_2D, heatmap->slotTexture[i]);
+        if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+            glTexStorage2D(GL_TEXTURE_2D, 1, heatmapInternalFormat(format), tileSize, tileSize);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, 0, heatmapInternalFormat(format), tileSize, tileSize, 0,
+                         GL_RED, heatmapPixelType(format), NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    std::cout << "Tiled heatmap: " << heatmap->tilesX << "x" << heatmap->tilesY << " tiles of "
+              << tileSize << "x" << tileSize << ", " << slotCount << " resident ("
+              << (slotCount * tileBytes) / (1024 * 1024) << " MB)" << std::endl;
+    return true;
+}
+
+
+// Fetch one tile and its border from the source and copy them into the texture of the given slot
+static void uploadTile(TiledHeatmap* heatmap, long long tile, int slot) {
+    int size = heatmap->tileSize;
+    int tileX = (int)(tile % heatmap->tilesX);
+    int tileY = (int)(tile / heatmap->tilesX);
+    // Texel (0, 0) of the texture is the border texel below and left of the tile's first one
+    int originX = tileX * heatmap->tileStep - 1;
+    int originY = tileY * heatmap->tileStep - 1;
+    // The border has no neighbour at the edges of the field, and the tiles on the right and
+    // top edge hang over its end: only fetch what exists
+    int x0 = std::max(0, originX), x1 = std::min(heatmap->fieldWidth, originX + size);
+    int y0 = std::max(0, originY), y1 = std::min(heatmap->fieldHeight, originY + size);
+    int left = x0 - originX, right = x1 - originX;
+    int bottom = y0 - originY, top = y1 - originY;
+
+    float* data = heatmap->scratch.data();
+    heatmap->source(x0, y0, x1 - x0, y1 - y0, data + (size_t)bottom * size + left, size);
+
+    // Repeat the outermost columns and rows into the rest, as clamping would inside one texture
+    for (int y = bottom; y < top; ++y) {
+        float* row = data + (size_t)y * size;
+        for (int x = 0; x < left; ++x) {
+            row[x] = row[left];
+        }
+        for (int x = right; x < size; ++x) {
+            row[x] = row[right - 1];
+        }
+    }
+    for (int y = 0; y < bottom; ++y) {
+        memcpy(data + (size_t)y * size, data + (size_t)bottom * size, size * sizeof(float));
+    }
+    for (int y = top; y < size; ++y) {
+        memcpy(data + (size_t)y * size, data + (size_t)(top - 1) * size, size * sizeof(float));
+    }
+
+    packHeatmapTexels(data, heatmap->packed.data(), (size_t)size * (size_t)size, heatmap->format);
+    glBindTexture(GL_TEXTURE_2D, heatmap->slotTexture[slot]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RED, heatmapPixelType(heatmap->format),
+                    heatmap->packed.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // Forget whatever tile lived in this slot before
+    if (heatmap->slotTile[slot] >= 0) {
+        heatmap->tileSlot.erase(heatmap->slotTile[slot]);
+    }
+    heatmap->slotTile[slot] = tile;
+    heatmap->tileSlot[tile] = slot;
+}
+
+
+// Slot to reuse for a new tile: an empty one, otherwise the least recently used one that is
+// not visible this frame. Returns -1 if every slot is needed for the current view.
+static int findFreeSlot(TiledHeatmap* heatmap) {
+    int best = -1;
+    for (size_t i = 0; i < heatmap->slotTile.size(); ++i) {
+        if (heatmap->slotTile[i] < 0) {
+            return (int)i;
+        }
+        if (heatmap->slotLastUsed[i] == heatmap->frame) {
+            continue;
+        }
+        if (best < 0 || heatmap->slotLastUsed[i] < heatmap->slotLastUsed[best]) {
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+
+// Range of tiles covered by the view, clamped to the field (empty if the view misses it)
+static void tileRange(const TiledHeatmap* heatmap, const TextureRect& view, int* firstX, int* lastX, int* firstY,
+                      int* lastY) {
+    float tilesPerU = (float)heatmap->fieldWidth / (float)heatmap->tileStep;
+    float tilesPerV = (float)heatmap->fieldHeight / (float)heatmap->tileStep;
+    *firstX = std::max(0, (int)std::floor(view.u0 * tilesPerU));
+    *lastX = std::min(heatmap->tilesX - 1, (int)std::floor(view.u1 * tilesPerU));
+    *firstY = std::max(0, (int)std::floor(view.v0 * tilesPerV));
+    *lastY = std::min(heatmap->tilesY - 1, (int)std::floor(view.v1 * tilesPerV));
+}
+
+
+int countTilesInView(const TiledHeatmap* heatmap, const TextureRect& view) {
+    int firstX, lastX, firstY, lastY;
+    tileRange(heatmap, view, &firstX, &lastX, &firstY, &lastY);
+    return std::max(0, lastX - firstX + 1) * std::max(0, lastY - firstY + 1);
+}
+
+
+int updateTiledHeatmap(TiledHeatmap* heatmap, const TextureRect& view) {
+    ++heatmap->frame;
+
+    int firstX, lastX, firstY, lastY;
+    tileRange(heatmap, view, &firstX, &lastX, &firstY, &lastY);
+    float tilesPerU = (float)heatmap->fieldWidth / (float)heatmap->tileStep;
+    float tilesPerV = (float)heatmap->fieldHeight / (float)heatmap->tileStep;
+
+    heatmap->visibleTiles.clear();
+    std::vector<long long> missing;
+    for (int y = firstY; y <= lastY; ++y) {
+        for (int x = firstX; x <= lastX; ++x) {
+            long long tile = (long long)y * heatmap->tilesX + x;
+            heatmap->visibleTiles.push_back(tile);
+            std::unordered_map<long long, int>::iterator it = heatmap->tileSlot.find(tile);
+            if (it != heatmap->tileSlot.end()) {
+                heatmap->slotLastUsed[it->second] = heatmap->frame;
+            } else {
+                missing.push_back(tile);
+            }
+        }
+    }
+
+    // Load the tiles closest to the center of the view first
+    float centerX = (view.u0 + view.u1) * 0.5f * tilesPerU - 0.5f;
+    float centerY = (view.v0 + view.v1) * 0.5f * tilesPerV - 0.5f;
+    int tilesX = heatmap->tilesX;
+    std::sort(missing.begin(), missing.end(), [=](long long a, long long b) {
+        float ax = (float)(a % tilesX) - centerX, ay = (float)(a / tilesX) - centerY;
+        float bx = (float)(b % tilesX) - centerX, by = (float)(b / tilesX) - centerY;
+        return ax * ax + ay * ay < bx * bx + by * by;
+    });
+
+    int uploads = std::min((int)missing.size(), heatmap->maxUploadsPerFrame);
+    for (int i = 0; i < uploads; ++i) {
+        int slot = findFreeSlot(heatmap);
+        if (slot < 0) {
+            if (!heatmap->warnedBudget) {
+                std::cerr << "The current view needs more tiles than the VRAM budget allows" << std::endl;
+                heatmap->warnedBudget = true;
+            }
+            return 0; // Waiting won't make room
+        }
+        uploadTile(heatmap, missing[i], slot);
+        heatmap->slotLastUsed[slot] = heatmap->frame;
+    }
+    return (int)missing.size() - uploads;
+}
+
+
+// Map a normalized field coordinate to normalized device coordinates for the current view
+static float fieldToNdc(float t, float viewMin, float viewMax) {
+    return (t - viewMin) / (viewMax - viewMin) * 2.0f - 1.0f;
+}
+
+
+void drawTiledHeatmap(TiledHeatmap* heatmap, const TextureRect& view, GLint quadTransformLocation,
+                      GLint texCoordTransformLocation, int framebufferWidth, int framebufferHeight) {
+    // Clip the padding of the edge tiles: only the field itself may be drawn
+    float left = (fieldToNdc(0.0f, view.u0, view.u1) + 1.0f) * 0.5f * framebufferWidth;
+    float right = (fieldToNdc(1.0f, view.u0, view.u1) + 1.0f) * 0.5f * framebufferWidth;
+    float bottom = (fieldToNdc(0.0f, view.v0, view.v1) + 1.0f) * 0.5f * framebufferHeight;
+    float top = (fieldToNdc(1.0f, view.v0, view.v1) + 1.0f) * 0.5f * framebufferHeight;
+    int scissorX = std::max(0, (int)std::floor(left));
+    int scissorY = std::max(0, (int)std::floor(bottom));
+    int scissorRight = std::min(framebufferWidth, (int)std::ceil(right));
+    int scissorTop = std::min(framebufferHeight, (int)std::ceil(top));
+    if (scissorRight <= scissorX || scissorTop <= scissorY) {
+        return;
+    }
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(scissorX, scissorY, scissorRight - scissorX, scissorTop - scissorY);
+
+    // Every tile samples its texture inside the border: texel centres land where the field's
+    // would, and at a tile edge the border texel blends in the neighbour's first texel
+    float size = (float)heatmap->tileSize;
+    glUniform4f(texCoordTransformLocation, (size - 2.0f) / size, (size - 2.0f) / size, 1.0f / size, 1.0f / size);
+
+    float tileU = (float)heatmap->tileStep / (float)heatmap->fieldWidth;
+    float tileV = (float)heatmap->tileStep / (float)heatmap->fieldHeight;
+    for (size_t i = 0; i < heatmap->visibleTiles.size(); ++i) {
+        long long tile = heatmap->visibleTiles[i];
+        std::unordered_map<long long, int>::iterator it = heatmap->tileSlot.find(tile);
+        if (it == heatmap->tileSlot.end()) {
+            continue; // Not uploaded yet
+        }
+        // Stretch the [-1, 1] quad over the tile's part of the screen
+        float u = (float)(tile % heatmap->tilesX) * tileU;
+        float v = (float)(tile / heatmap->tilesX) * tileV;
+        float x0 = fieldToNdc(u, view.u0, view.u1), x1 = fieldToNdc(u + tileU, view.u0, view.u1);
+        float y0 = fieldToNdc(v, view.v0, view.v1), y1 = fieldToNdc(v + tileV, view.v0, view.v1);
+        glUniform4f(quadTransformLocation, (x1 - x0) * 0.5f, (y1 - y0) * 0.5f, (x1 + x0) * 0.5f, (y1 + y0) * 0.5f);
+
+        glBindTexture(GL_TEXTURE_2D, heatmap->slotTexture[it->second]);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+}
+
+
+void destroyTiledHeatmap(TiledHeatmap* heatmap) {
+    if (!heatmap->slotTexture.empty()) {
+        glDeleteTextures((GLsizei)heatmap->slotTexture.size(), heatmap->slotTexture.data());
+    }
+    heatmap->slotTexture.clear();
+    heatmap->slotTile.clear();
+    heatmap->slotLastUsed.clear();
+    heatmap->tileSlot.clear();
+    heatmap->scratch.reset();
+}
@@ -0,0 +1,88 @@
+/*
+    Tiled heatmap for fields larger than GL_MAX_TEXTURE_SIZE.
+
+    The field is split into square tiles of tileSize texels. Each tile texture also holds a
+    1-texel border copied from its neighbours, so linear filtering blends across tile edges
+    exactly as it would inside one big texture; a tile therefore covers tileSize - 2 texels
+    of the field, and its texture coordinates skip the border. Only a fixed pool of tile textures
+    exists on the GPU (sized from a VRAM budget); every frame the tiles that intersect the
+    visible part of the field are made resident, evicting the least recently used ones, and
+    each resident tile is drawn with the regular heatmap shader as its own quad.
+
+    Tile contents come from a TileSource callback, so the same code serves procedural fields
+    and fields loaded from disk. Uploads are capped per frame to keep frame times flat while
+    panning; tiles that are not resident yet are simply skipped until they arrive.
+
+    The pool is plain 2D textures rather than one array texture so tiles go through the same
+    sampler2D path of fragment_shader.glsl as a single texture; only panels switch it to an
+    array (HEATMAP_PANEL_DEFINES). Each tile is one draw call, which is fine for the few dozen
+    a window shows.
+
+    Limitation: tiles exist only at full resolution, there are no coarser levels. Below one
+    texel per pixel the view needs more and more tiles, so zooming out stops as soon as the
+    visible tiles would not fit into the pool (see tiledHeatmapCapacity); the whole of a field
+    larger than the pool can't be seen at once.
+*/
+
+#ifndef TILED_HEATMAP_H
+#define TILED_HEATMAP_H
+
+#include <GL/glew.h>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "field_buffer_pool.h"
+#include "texture_format.h"
+#include "view_transform.h"
+
+// Fill a width x height rectangle of the field starting at texel (originX, originY);
+// rows in out are stride floats apart
+typedef std::function<void(int originX, int originY, int width, int height, float* out, int stride)> TileSource;
+
+struct TiledHeatmap {
+    int fieldWidth;
+    int fieldHeight;
+    int tileSize;                           // Texels per tile texture, including the border
+    int tileStep;                           // Field texels per tile: tileSize - 2
+    int tilesX;                             // Number of tile columns and rows
+    int tilesY;
+    HeatmapFormat format;
+    TileSource source;
+
+    std::vector<GLuint> slotTexture;        // Fixed pool of resident tile textures
+    std::vector<long long> slotTile;        // Tile stored in each slot, -1 if empty
+    std::vector<unsigned> slotLastUsed;     // Frame in which each slot was last visible
+    std::unordered_map<long long, int> tileSlot; // Resident tiles -> slot
+    std::vector<long long> visibleTiles;    // Tiles intersecting the view this frame
+
+    unsigned frame;
+    int maxUploadsPerFrame;
+    bool warnedBudget;                      // Printed that the view needs more tiles than the budget
+    FieldBuffer scratch;                    // One tile of floats from the source
+    std::vector<unsigned char> packed;      // The same tile in the texture's format
+};
+
+// Create the tile pool. The number of resident tiles is vramBudgetBytes / bytes per tile;
+// tileSize has to be at least 3 to leave room for the border.
+bool createTiledHeatmap(TiledHeatmap* heatmap, int fieldWidth, int fieldHeight, int tileSize,
+                        size_t vramBudgetBytes, HeatmapFormat format, const TileSource& source);
+
+// Number of tiles that intersect view, and how many fit into the pool at once
+int countTilesInView(const TiledHeatmap* heatmap, const TextureRect& view);
+inline int tiledHeatmapCapacity(const TiledHeatmap* heatmap) { return (int)heatmap->slotTexture.size(); }
+
+// Find the tiles that intersect view, and upload up to maxUploadsPerFrame missing ones.
+// Returns the number of visible tiles that are still waiting for a later frame.
+int updateTiledHeatmap(TiledHeatmap* heatmap, const TextureRect& view);
+
+// Draw the resident visible tiles with the currently bound program and quad.
+// quadTransformLocation and texCoordTransformLocation are the vec4 (scale.xy, offset.zw)
+// uniforms of vertex_shader.glsl. framebufferWidth/Height are used to scissor away the
+// padding of the edge tiles.
+void drawTiledHeatmap(TiledHeatmap* heatmap, const TextureRect& view, GLint quadTransformLocation,
+                      GLint texCoordTransformLocation, int framebufferWidth, int framebufferHeight);
+
+void destroyTiledHeatmap(TiledHeatmap* heatmap);
+
+#endif
@@ -0,0 +1,140 @@
+#include "value_range.h"
+#include "shader.h"
+
+#include <iostream>
+
+
+static int reducedSize(int size) {
+    return (size + VALUE_RANGE_BLOCK - 1) / VALUE_RANGE_BLOCK;
+}
+
+
+// Allocate a texture for (min, max) pairs, sampled with texelFetch only
+static GLuint createRangeTexture(int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width, height, 0, GL_RG, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    return texture;
+}
+
+
+void clearValueRange(ValueRange* range) {
+    range->program = 0;
+    range->framebuffer = 0;
+    for (int i = 0; i < 2; ++i) {
+        range->pingPong[i] = 0;
+        range->pingPongWidth[i] = range->pingPongHeight[i] = 0;
+    }
+    range->fixedTexture = 0;
+    range->result = 0;
+    clearFullscreenTriangle(&range->triangle);
+    range->sourceSizeLocation = range->firstPassLocation = -1;
+}
+
+
+bool createValueRange(ValueRange* range, int width, int height) {
+    clearValueRange(range);
+
+    range->program = createShaderProgram("fullscreen_triangle.glsl", "value_range.glsl");
+    int success;
+    glGetProgramiv(range->program, GL_LINK_STATUS, &success);
+    if (!success) {
+        std::cerr << "Failed to build the value range reduction" << std::endl;
+        glDeleteProgram(range->program);
+        range->program = 0;
+    } else {
+        range->sourceSizeLocation = glGetUniformLocation(range->program, "sourceSize");
+        range->firstPassLocation = glGetUniformLocation(range->program, "firstPass");
+
+        // The first pass writes into pingPong[0], the second into pingPong[1], the third into
+        // pingPong[0] again and so on; each pass needs less room than the one two before it
+        range->pingPongWidth[0] = reducedSize(width);
+        range->pingPongHeight[0] = reducedSize(height);
+        range->pingPongWidth[1] = reducedSize(range->pingPongWidth[0]);
+        range->pingPongHeight[1] = reducedSize(range->pingPongHeight[0]);
+        for (int i = 0; i < 2; ++i) {
+            range->pingPong[i] = createRangeTexture(range->pingPongWidth[i], range->pingPongHeight[i]);
+        }
+        glGenFramebuffers(1, &range->framebuffer);
+        createFullscreenTriangle(&range->triangle);
+    }
+
+    // Without the program the display falls back to the fixed range
+    range->fixedTexture = createRangeTexture(1, 1);
+    setFixedValueRange(range, 0.0f, 1.0f);
+    return range->program != 0;
+}
+
+
+void reduceValueRange(ValueRange* range, GLuint texture, int width, int height) {
+    if (!range->program) {
+        return;
+    }
+    // Remember the state we are about to change
+    GLint previousProgram;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    GLint previousViewport[4];
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    glUseProgram(range->program);
+    glUniform1i(glGetUniformLocation(range->program, "sourceTexture"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER, range->framebuffer);
+
+    GLuint source = texture;
+    int sourceWidth = width, sourceHeight = height;
+    for (int pass = 0; pass == 0 || sourceWidth > 1 || sourceHeight > 1; ++pass) {
+        GLuint destination = range->pingPong[pass % 2];
+        int destinationWidth = reducedSize(sourceWidth), destinationHeight = reducedSize(sourceHeight);
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, destination, 0);
+        glViewport(0, 0, destinationWidth, destinationHeight);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glUniform2i(range->sourceSizeLocation, sourceWidth, sourceHeight);
+        glUniform1i(range->firstPassLocation, pass == 0 ? 1 : 0);
+        drawFullscreenTriangle(&range->triangle);
+
+        source = destination;
+        sourceWidth = destinationWidth;
+        sourceHeight = destinationHeight;
+    }
+    range->result = source;
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    glUseProgram(previousProgram);
+}
+
+
+void setFixedValueRange(ValueRange* range, float minValue, float maxValue) {
+    float texel[2] = { minValue, maxValue };
+    glBindTexture(GL_TEXTURE_2D, range->fixedTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RG, GL_FLOAT, texel);
+    range->result = range->fixedTexture;
+}
+
+
+void destroyValueRange(ValueRange* range) {
+    if (range->framebuffer) {
+        glDeleteFramebuffers(1, &range->framebuffer);
+        range->framebuffer = 0;
+    }
+    destroyFullscreenTriangle(&range->triangle);
+    for (int i = 0; i < 2; ++i) {
+        if (range->pingPong[i]) {
+            glDeleteTextures(1, &range->pingPong[i]);
+            range->pingPong[i] = 0;
+        }
+    }
+    glDeleteTextures(1, &range->fixedTexture);
+    range->fixedTexture = 0;
+    if (range->program) {
+        glDeleteProgram(range->program);
+        range->program = 0;
+    }
+}
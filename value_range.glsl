@@ -0,0 +1,31 @@
+#version 330 core
+
+// One pass of the min/max reduction (see value_range.h).
+// Every fragment covers a block of 8x8 source texels and writes their minimum to red and
+// their maximum to green. The blocks at the right and top edge may be cut off.
+
+uniform sampler2D sourceTexture;
+uniform ivec2 sourceSize;   // Size of the source in texels (may be smaller than the texture)
+uniform int firstPass;      // 1: the source is the field itself, its value is in red
+                            // 0: the source holds (min, max) pairs from the previous pass
+
+out vec4 valueRange;
+
+void main() {
+    ivec2 first = ivec2(gl_FragCoord.xy) * 8;
+    ivec2 last = min(first + 8, sourceSize);
+
+    float minValue = 3.4e38;
+    float maxValue = -3.4e38;
+    for (int y = first.y; y < last.y; ++y) {
+        for (int x = first.x; x < last.x; ++x) {
+            vec2 value = texelFetch(sourceTexture, ivec2(x, y), 0).rg;
+            if (firstPass == 1) {
+                value.g = value.r;
+            }
+            minValue = min(minValue, value.r);
+            maxValue = max(maxValue, value.g);
+        }
+    }
+    valueRange = vec4(minValue, maxValue, 0.0, 1.0);
+}
@@ -0,0 +1,52 @@
+/*
+    Finds the minimum and maximum of the heatmap on the GPU, so raw data can be displayed
+    without knowing its range and without scanning it on the CPU.
+
+    value_range.glsl reduces blocks of 8x8 texels to their (min, max) pair in one fullscreen
+    pass, and the passes ping-pong between two RG32F textures until a single texel is left:
+    a 16384x16384 field takes five passes. The fragment shader reads that texel with
+    texelFetch, so the result never travels back to the CPU and nothing stalls on it.
+
+    Where the field isn't in one texture (tiles, panels) a fixed range is used instead.
+*/
+
+#ifndef VALUE_RANGE_H
+#define VALUE_RANGE_H
+
+#include <GL/glew.h>
+
+#include "fullscreen_triangle.h"
+
+// Source texels reduced by one fragment, per dimension
+const int VALUE_RANGE_BLOCK = 8;
+
+struct ValueRange {
+    GLuint program;
+    GLuint framebuffer;
+    GLuint pingPong[2];         // RG32F, sized for the first and the second pass
+    int pingPongWidth[2];
+    int pingPongHeight[2];
+    GLuint fixedTexture;        // 1x1 RG32F holding the range set by setFixedValueRange
+    GLuint result;              // Texture whose texel (0, 0) holds (min, max)
+    FullscreenTriangle triangle;
+    GLint sourceSizeLocation;
+    GLint firstPassLocation;
+};
+
+// The state of a reduction that was never created: every name 0, which destroyValueRange
+// accepts. createValueRange starts from it as well.
+void clearValueRange(ValueRange* range);
+
+// Build the reduction for fields of up to width x height texels
+bool createValueRange(ValueRange* range, int width, int height);
+
+// Reduce level 0 of texture (single-channel, width x height) to its min and max.
+// Afterwards range->result holds them; it stays valid until the next call.
+void reduceValueRange(ValueRange* range, GLuint texture, int width, int height);
+
+// Use a known range instead; range->result then points at the fixed texture
+void setFixedValueRange(ValueRange* range, float minValue, float maxValue);
+
+void destroyValueRange(ValueRange* range);
+
+#endif
@@ -1,17 +1,24 @@
-#version 120
+#version 330 core
 
 // each vertex has its own set of attribute data
 // attributes are used to pass data from the application (C++ code) to the vertex shader
-attribute vec2 aPos;       // Position of each vertex
-attribute vec2 aTexCoord;  // Texture coordinates of each vertex
+// the fixed locations let the vertex array object in main.cpp be set up once for every program
+layout(location = 0) in vec2 aPos;       // Position of each vertex
+layout(location = 1) in vec2 aTexCoord;  // Texture coordinates of each vertex
 
-// each vertex has its own varying value
-// varying is used to pass data from the vertex shader to the fragment shader
+// each vertex has its own output value
+// outputs are passed from the vertex shader to the fragment shader
 // when passed to the fragment shader, OpenGL will interpolate these coordinates across the entire surface of the shape
-varying vec2 TexCoord;     // Pass this to the fragment shader
+out vec2 TexCoord;         // Pass this to the fragment shader
+
+// Places the quad on the screen: xy scales the position, zw offsets it.
+// (1, 1, 0, 0) covers the whole window; tiles use it to draw themselves where they belong.
+uniform vec4 quadTransform;
+// The same for the texture coordinates, so a tile can skip the border texels around its content
+uniform vec4 texCoordTransform = vec4(1.0, 1.0, 0.0, 0.0);
 
 void main()
 {
-    gl_Position = vec4(aPos, 0.0, 1.0); // Position on the screen
-    TexCoord = aTexCoord;               // Pass texture coordinates to the fragment shader
+    gl_Position = vec4(aPos * quadTransform.xy + quadTransform.zw, 0.0, 1.0); // Position on the screen
+    TexCoord = aTexCoord * texCoordTransform.xy + texCoordTransform.zw; // Pass texture coordinates to the fragment shader
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "view_transform.h"
+
+
+void resetViewTransform(ViewTransform* view) {
+    view->centerU = 0.5f;
+    view->centerV = 0.5f;
+    view->zoom = 1.0f;
+}
+
+
+// The default view is centered on the field, so only its size matters
+TextureRect viewTransformRect(const ViewTransform& view, const TextureRect& defaultView) {
+    float halfU = 0.5f * (defaultView.u1 - defaultView.u0) / view.zoom;
+    float halfV = 0.5f * (defaultView.v1 - defaultView.v0) / view.zoom;
+    TextureRect rect = { view.centerU - halfU, view.centerV - halfV, view.centerU + halfU, view.centerV + halfV };
+    return rect;
+}
+
+
+static float clampUnit(float t) {
+    return t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+}
+
+
+void zoomViewTransform(ViewTransform* view, const TextureRect& defaultView, float factor, float x, float y,
+                       float minZoom, float maxZoom) {
+    // The field point under (x, y) stays there
+    TextureRect before = viewTransformRect(*view, defaultView);
+    float pointU = before.u0 + x * (before.u1 - before.u0);
+    float pointV = before.v0 + y * (before.v1 - before.v0);
+
+    float zoom = view->zoom * factor;
+    view->zoom = zoom < minZoom ? minZoom : (zoom > maxZoom ? maxZoom : zoom);
+    float width = (defaultView.u1 - defaultView.u0) / view->zoom;
+    float height = (defaultView.v1 - defaultView.v0) / view->zoom;
+    view->centerU = clampUnit(pointU + (0.5f - x) * width);
+    view->centerV = clampUnit(pointV + (0.5f - y) * height);
+}
+
+
+void panViewTransform(ViewTransform* view, const TextureRect& defaultView, float dx, float dy) {
+    TextureRect rect = viewTransformRect(*view, defaultView);
+    view->centerU = clampUnit(view->centerU - dx * (rect.u1 - rect.u0));
+    view->centerV = clampUnit(view->centerV - dy * (rect.v1 - rect.v0));
+}
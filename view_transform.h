@@ -0,0 +1,46 @@
+/*
+    Pan and zoom.
+
+    What the window shows is a rectangle of the field in normalized texture coordinates.
+    Untouched, it is the default view of the backend: the whole field stretched over the
+    window for a single texture, one texel per pixel around the center for tiles. Zooming
+    scales the rectangle around the point under the cursor and panning moves it, so the
+    field sticks to the mouse while dragging.
+
+    Everything whose cost grows with the visible texels works off this one rectangle: the
+    display shader samples only it (uView in fullscreen_triangle.glsl), tiles make only the
+    tiles under it resident (tiled_heatmap.h), and the mipmap pyramid of a changing field
+    rebuilds only the levels and texels it shows (lod_pyramid.h).
+*/
+
+#ifndef VIEW_TRANSFORM_H
+#define VIEW_TRANSFORM_H
+
+// Visible part of the field in normalized texture coordinates ([0, 1] covers the whole field)
+struct TextureRect {
+    float u0, v0;
+    float u1, v1;
+};
+
+struct ViewTransform {
+    float centerU;          // Field point in the middle of the window
+    float centerV;
+    float zoom;             // Magnification relative to the default view, 1 = default
+};
+
+// Back to the default view
+void resetViewTransform(ViewTransform* view);
+
+// The part of the field on screen, for the backend's default view
+TextureRect viewTransformRect(const ViewTransform& view, const TextureRect& defaultView);
+
+// Zoom by factor around the window point (x, y), both in [0, 1] from the bottom left.
+// The zoom stays within [minZoom, maxZoom].
+void zoomViewTransform(ViewTransform* view, const TextureRect& defaultView, float factor, float x, float y,
+                       float minZoom, float maxZoom);
+
+// Move the field by (dx, dy) window sizes, e.g. the mouse movement while dragging.
+// The middle of the window never leaves the field.
+void panViewTransform(ViewTransform* view, const TextureRect& defaultView, float dx, float dy);
+
+#endif